@@ -0,0 +1,24 @@
+/*
+ * Controller_Coeffs.h holds the wheel speed controllers Main.c passes to
+ * Controller_Init, numerator (b) and denominator (a) in powers of z^-1,
+ * as the defaults of the kp_, num_ and den_ runtime parameters (Params.h).
+ * These are the hand fit from before User/sys_id.py.
+ * To redesign for a robot:
+ *
+ *      python3 User/sys_id.py fit <recording> --header Application/Controller_Coeffs.h
+ */
+#ifndef CONTROLLER_COEFFS_H
+#define CONTROLLER_COEFFS_H
+
+#define CONTROLLER_ORDER	1
+#define CONTROLLER_PERIOD_MS	10		// [ms]
+
+#define KP_L		0.1875335
+#define NUM_LEFT	{ 0.187533508705, 0.124897316798 }
+#define DEN_LEFT	{ 1.000000000000, -1.000000000000 }
+
+#define KP_R		0.1728258
+#define NUM_RIGHT	{ 0.172825818795, 0.130440286735 }
+#define DEN_RIGHT	{ 1.000000000000, -1.000000000000 }
+
+#endif
@@ -0,0 +1,47 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Gripper.h"
+
+void Gripper_Move(uint8_t position, float speed) {
+	Servo_Move(position, speed);
+
+	mf_servo.active = true;
+	mf_servo.duration = SERVO_UPDATE_PERIOD;
+	mf_servo.last_trigger_time = GetTime();
+}
+
+bool Gripper_Task() {
+	if(Servo_Step(mf_servo.duration/1000.0)) {
+		return true;
+	}
+
+	// Grip settled, let the host carry on
+	struct __attribute__((__packed__)) { char event; uint8_t position; } data =
+	{
+			.event = 'S',
+			.position = Servo_Position()
+	};
+	usb_send_msg("ccB", 'G', &data, sizeof(data));
+	return false;
+}
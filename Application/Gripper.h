@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Gripper.h/c runs gripper moves for the command handlers and the trajectory
+ * queue. Gripper_Move starts a ramp in ServoPWM and schedules mf_servo,
+ * Gripper_Task steps it from the main loop and tells the host once the grip
+ * has settled:
+ *      "ccB"       'G', 'S', position [%]
+ */
+#ifndef GRIPPER_H
+#define GRIPPER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../Driver/include_driver.h"
+#include "application_defines.h"
+
+/**
+ * Function Gripper_Move starts a gripper ramp to position [%] at speed [%/s] (0 for default). A 'G' event
+ * is sent once the grip settles.
+ */
+void Gripper_Move(uint8_t position, float speed);
+
+/**
+ * Function Gripper_Task advances the ramp by one mf_servo period. Returns true while the servo is moving or
+ * settling, sends the 'G' event and returns false once it has settled.
+ */
+bool Gripper_Task();
+
+#endif
@@ -0,0 +1,168 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include "Link_Bench.h"
+
+#define LINK_FORMAT_LEN		8		// "ccH" + up to 3 digits + 's' + '\0'
+
+typedef struct __attribute__((__packed__)) {
+	char tag;
+	uint16_t number;
+	uint8_t fill[LINK_BENCH_MAX_SIZE - LINK_BENCH_MIN_SIZE];
+} t_LinkPacket;
+
+static t_LinkPacket packet;
+static char format[LINK_FORMAT_LEN];
+static uint8_t packet_size;
+static uint16_t packets_left;
+static uint16_t packets_sent;
+static uint32_t start_ms;
+static bool bulk_path;
+static bool running;
+
+/*
+ * Builds the "ccH<n>s" format for n filler bytes
+ */
+static void Build_Format(uint8_t fill) {
+	uint8_t i = 0;
+	format[i++] = 'c';
+	format[i++] = 'c';
+	format[i++] = 'H';
+	if(fill > 0) {
+		if(fill >= 100) format[i++] = '0' + fill / 100;
+		if(fill >= 10) format[i++] = '0' + (fill / 10) % 10;
+		format[i++] = '0' + fill % 10;
+		format[i++] = 's';
+	}
+	format[i] = '\0';
+}
+
+/*
+ * Bytes a message with this format and size takes in the send buffer
+ */
+static uint8_t Message_Bytes(uint8_t size) {
+	return 1 + strlen(format) + 1 + 1 + size;
+}
+
+/**
+ * Function Link_Bench_Ping answers a ping with the sequence number and the robot time
+ */
+void Link_Bench_Ping(uint16_t sequence) {
+	struct __attribute__((__packed__)) { char tag; uint16_t sequence; uint32_t time; } data;
+	data.tag = 'P';
+	data.sequence = sequence;
+	data.time = GetMilli();
+
+	usb_send_msg("ccHI", 'u', &data, sizeof(data));
+}
+
+/**
+ * Function Link_Bench_Start begins a stream of count packets of size data bytes. Returns false if the size
+ * is out of range for the chosen path.
+ */
+bool Link_Bench_Start(uint16_t count, uint8_t size, bool bulk) {
+	if(size < LINK_BENCH_MIN_SIZE || size > LINK_BENCH_MAX_SIZE) {
+		return false;
+	}
+
+	Build_Format(size - LINK_BENCH_MIN_SIZE);
+
+	// A ring buffer packet has to fit in the ring buffer
+	if(!bulk && Message_Bytes(size) > RB_LENGTH_C - 1) {
+		return false;
+	}
+
+	for(uint8_t i = 0; i < size - LINK_BENCH_MIN_SIZE; i++) {
+		packet.fill[i] = i;
+	}
+	packet.tag = 'D';
+	packet_size = size;
+	packets_left = count;
+	packets_sent = 0;
+	bulk_path = bulk;
+	start_ms = GetMilli();
+	running = true;
+
+	return true;
+}
+
+/**
+ * Function Link_Bench_Abort ends a running stream, the end report is still sent
+ */
+void Link_Bench_Abort() {
+	packets_left = 0;
+}
+
+/**
+ * Function Link_Bench_Task sends as many packets as the send path takes. Returns true while the stream,
+ * including its end report, is still going.
+ */
+bool Link_Bench_Task() {
+	if(!running) {
+		return false;
+	}
+
+	if(bulk_path) {
+		// Blocks until the host takes it, so one packet per pass keeps the loop going
+		if(packets_left > 0) {
+			packet.number = packets_sent;
+			if(usb_send_msg_bulk(format, 'u', &packet, packet_size)) {
+				packets_sent++;
+				packets_left--;
+			}
+			else {
+				// Host stopped reading
+				packets_left = 0;
+			}
+			return true;
+		}
+	}
+	else {
+		// Fill whatever room the send buffer has
+		while(packets_left > 0 && usb_out_msg_length() + Message_Bytes(packet_size) <= RB_LENGTH_C - 1) {
+			packet.number = packets_sent;
+			usb_send_msg(format, 'u', &packet, packet_size);
+			packets_sent++;
+			packets_left--;
+		}
+		if(packets_left > 0) {
+			return true;
+		}
+	}
+
+	// End report once there is room behind the last packet
+	struct __attribute__((__packed__)) { char tag; uint16_t sent; uint32_t time; } data;
+	if(usb_out_msg_length() + 1 + sizeof("ccHI") + 1 + sizeof(data) > RB_LENGTH_C - 1) {
+		return true;
+	}
+
+	data.tag = 'E';
+	data.sent = packets_sent;
+	data.time = GetMilli() - start_ms;
+	usb_send_msg("ccHI", 'u', &data, sizeof(data));
+
+	running = false;
+	return false;
+}
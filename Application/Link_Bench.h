@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Link_Bench.h/c measures the USB link. The 'u' command either answers a
+ * ping straight away or starts a stream of numbered packets sent as fast as
+ * the loop allows, so the host can work out round trip time, sustained
+ * bandwidth and drops (see User/link_bench.py).
+ *
+ * 'u' payload {char action, uint16 count, uint8 size}:
+ *      'P' ping, count is the host's sequence number
+ *      'S' stream count packets of size data bytes through the send buffer,
+ *          the path all telemetry takes
+ *      'B' the same with usb_send_msg_bulk, the raw link capacity
+ *      'A' abort a stream
+ *
+ * Replies, all sent as 'u':
+ *      "ccHI"      'P', sequence, time [ms]
+ *      "ccH<n>s"   'D', packet number, n filler bytes (size = 3 + n)
+ *      "ccHI"      'E', packets sent, stream time [ms]
+ */
+#ifndef LINK_BENCH_H
+#define LINK_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../Driver/include_driver.h"
+
+#define LINK_BENCH_MIN_SIZE		3		// tag and packet number
+#define LINK_BENCH_MAX_SIZE		64		// bulk packets, ring packets are limited by RB_LENGTH_C
+
+/**
+ * Function Link_Bench_Ping answers a ping with the sequence number and the robot time
+ */
+void Link_Bench_Ping(uint16_t sequence);
+
+/**
+ * Function Link_Bench_Start begins a stream of count packets of size data bytes. Returns false if the size
+ * is out of range for the chosen path.
+ */
+bool Link_Bench_Start(uint16_t count, uint8_t size, bool bulk);
+
+/**
+ * Function Link_Bench_Abort ends a running stream, the end report is still sent
+ */
+void Link_Bench_Abort();
+
+/**
+ * Function Link_Bench_Task sends as many packets as the send path takes. Returns true while the stream,
+ * including its end report, is still going.
+ */
+bool Link_Bench_Task();
+
+#endif
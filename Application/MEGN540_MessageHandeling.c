@@ -30,6 +30,13 @@
 
 #include "MEGN540_MessageHandeling.h"
 
+// Set whenever a flag's action is due, see MSG_FLAG_Any_Executed
+static bool flag_executed = false;
+
+#ifdef CONFIG_TELEOP
+// Set while 'j' commands own the drive, cleared by Reset_Drive_Flags
+static bool teleop = false;
+#endif
 
 static inline void MSG_FLAG_Init(MSG_FLAG_t* p_flag)
 {
@@ -40,6 +47,34 @@ static inline void MSG_FLAG_Init(MSG_FLAG_t* p_flag)
 }
 
 
+/*
+ * Sets up the wheel motion profiles for a distance move. The acceleration is
+ * scaled by each wheel's share of the move so both wheels ramp, cruise and
+ * brake over the same time and an arc keeps its shape. Returns the longer
+ * wheel's planned time [ms].
+ */
+static float Start_Distance_Profiles(float distance_left, float distance_right,
+		float velocity_left, float velocity_right)
+{
+	float abs_left = (distance_left < 0) ? -distance_left : distance_left;
+	float abs_right = (distance_right < 0) ? -distance_right : distance_right;
+	float longest = (abs_left > abs_right) ? abs_left : abs_right;
+
+	if(longest <= 0) {
+		longest = 1;
+	}
+
+	Motion_Profile_Init(&mp_LeftMotor, distance_left, velocity_left, params.dist_accel * abs_left/longest,
+			params.dist_creep, ctr_LeftMotor.update_period);
+	Motion_Profile_Init(&mp_RightMotor, distance_right, velocity_right, params.dist_accel * abs_right/longest,
+			params.dist_creep, ctr_RightMotor.update_period);
+
+	float duration_left = Motion_Profile_Duration(&mp_LeftMotor, ctr_LeftMotor.update_period);
+	float duration_right = Motion_Profile_Duration(&mp_RightMotor, ctr_RightMotor.update_period);
+	return (duration_left > duration_right) ? duration_left : duration_right;
+}
+
+
 /**
  * Function MSG_FLAG_Execute indicates if the action associated with the message flag should be executed
  * in the main loop both because its active and because its time.
@@ -54,6 +89,7 @@ bool MSG_FLAG_Execute( MSG_FLAG_t* p_flag)
 
 		if((float)delta_time.millisec >= p_flag->duration)
 		{
+			flag_executed = true;
 			return true;
 		}
 	}
@@ -62,6 +98,16 @@ bool MSG_FLAG_Execute( MSG_FLAG_t* p_flag)
 }
 
 
+/**
+ * Function MSG_FLAG_Any_Executed returns true if any flag's action was due since the last call.
+ */
+bool MSG_FLAG_Any_Executed()
+{
+	bool executed = flag_executed;
+	flag_executed = false;
+	return executed;
+}
+
 /**
  * Function Message_Handling_Init initializes the message handling and all associated state flags and data to their default
  * conditions.
@@ -80,7 +126,38 @@ void Message_Handling_Init()
 	MSG_FLAG_Init( &mf_sys_data );
 	MSG_FLAG_Init( &mf_motor_dist_control );
 	MSG_FLAG_Init( &mf_motor_stop );
+#ifdef CONFIG_IR
 	MSG_FLAG_Init( &mf_ir_proximity );
+#endif
+#ifdef CONFIG_OA
+	MSG_FLAG_Init( &mf_obj_avoidance );
+#endif
+#ifdef CONFIG_TRAJECTORY
+	MSG_FLAG_Init( &mf_trajectory );
+#endif
+#ifdef CONFIG_SERVO
+	MSG_FLAG_Init( &mf_servo );
+#endif
+#ifdef CONFIG_IDLE
+	MSG_FLAG_Init( &mf_duty_cycle );
+#endif
+#ifdef CONFIG_PROFILER
+	MSG_FLAG_Init( &mf_profiler_dump );
+#endif
+#ifdef CONFIG_TRACE
+	MSG_FLAG_Init( &mf_trace_snapshot );
+#endif
+#ifdef CONFIG_LINK_BENCH
+	MSG_FLAG_Init( &mf_link_bench );
+#endif
+#ifdef CONFIG_TELEMETRY
+	MSG_FLAG_Init( &mf_telemetry );
+	Telemetry_Init();
+#endif
+#ifdef CONFIG_PARAMS
+	MSG_FLAG_Init( &mf_params_save );
+	MSG_FLAG_Init( &mf_params_dump );
+#endif
 }
 
 /**
@@ -97,6 +174,12 @@ void Message_Handling_Task()
 	// Get Your command designator without removal so if their are not enough bytes yet, the command persists
 	char command = usb_msg_peek();
 
+	// Log complete commands, a partial one is seen again on a later pass
+	if( usb_msg_length() >= MEGN540_Message_Len(command) )
+	{
+		Trace_Write(TRACE_COMMAND, command);
+	}
+
 	// process command
 	switch( command )
 	{
@@ -107,7 +190,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build a meaningful structure to put your data in. Here we want two floats.
-			struct __attribute__((__packed__)) { float v1; float v2; } data;
+			t_Msg_Multiply data;
 
 			// Copy the bytes from the usb receive buffer into our structure so we can use the information
 			usb_msg_read_into( &data, sizeof(data) );
@@ -127,7 +210,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float v1; float v2; } data;
+			t_Msg_Divide data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -157,7 +240,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float v1; float v2; } data;
+			t_Msg_Add data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -175,7 +258,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float v1; float v2; } data;
+			t_Msg_Subtract data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -211,6 +294,15 @@ void Message_Handling_Task()
 			} else if (action == 0x02){
 				mf_loop_timer.active = true;
 				mf_loop_timer.duration = -1;
+#ifdef CONFIG_IDLE
+			} else if (action == 0x03){
+				mf_duty_cycle.active = true;
+				mf_duty_cycle.duration = -1;
+			} else if (action == 0x04){
+				Idle_Enable(true);
+			} else if (action == 0x05){
+				Idle_Enable(false);
+#endif
 			} else {
 				char bad_input = '?';
 				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
@@ -225,7 +317,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { char action; float duration; } data;
+			t_Msg_TimeRepeat data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -242,6 +334,15 @@ void Message_Handling_Task()
 				mf_loop_timer.active = true;
 				// Convert duration from s to ms
 				mf_loop_timer.duration = data.duration * 1000;
+#ifdef CONFIG_IDLE
+			} else if (data.action == 0x03 && data.duration > 0.0){
+				mf_duty_cycle.active = true;
+				// Convert duration from s to ms
+				mf_duty_cycle.duration = data.duration * 1000;
+				// Start the first window now
+				mf_duty_cycle.last_trigger_time = GetTime();
+				Idle_Get_Stats();
+#endif
 			} else {
 				char bad_input = '?';
 				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
@@ -249,6 +350,20 @@ void Message_Handling_Task()
 		}
 		break;
 
+	case 'c':	// Clock sync ping
+		if( usb_msg_length() >= MEGN540_Message_Len('c') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// The sequence number comes back with the robot's time so the host can match it to its send time
+			struct __attribute__((__packed__)) { uint8_t sequence; uint32_t time; } data;
+			data.sequence = usb_msg_get();
+			data.time = GetTimeMicros();
+			usb_send_msg("cBI", command, &data, sizeof(data));
+		}
+		break;
+
 	case 'e':
 		if( usb_msg_length() >= MEGN540_Message_Len('e') )
 		{
@@ -267,7 +382,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float duration; } data;
+			t_Msg_EncodersRepeat data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -302,7 +417,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float duration; } data;
+			t_Msg_BatteryRepeat data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -326,7 +441,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { int left; int right; } data;
+			t_Msg_Pwm data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -376,7 +491,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { int left; int right; float duration; } data;
+			t_Msg_PwmTimed data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -471,7 +586,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float duration; } data;
+			t_Msg_StatusRepeat data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -514,7 +629,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float linear; float angular; } data;
+			t_Msg_Distance data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -556,9 +671,9 @@ void Message_Handling_Task()
 					}
 
 					/// Move car around circle
-					if(data.linear < MIN_TURN_ARC) {
+					if(data.linear < params.min_turn_arc) {
 						// Just spin
-						float d = (HALF_WHEEL_BASE * data.angular)/2;
+						float d = (params.wheel_base * data.angular)/4;
 						if(data.angular > 0) {
 							// Spin left
 							distance_left = -1 * d;
@@ -570,8 +685,8 @@ void Message_Handling_Task()
 							distance_right = -1 * d;
 						}
 
-						velocity_left = DutyCycle_to_Velocity_Left(SPIN_DUTYCYLE);
-						velocity_right = DutyCycle_to_Velocity_Right(SPIN_DUTYCYLE);
+						velocity_left = DutyCycle_to_Velocity_Left(params.spin_dutycycle);
+						velocity_right = DutyCycle_to_Velocity_Right(params.spin_dutycycle);
 					}
 					else {
 						// Determine distance and velocity to travel on left and right
@@ -580,11 +695,11 @@ void Message_Handling_Task()
 							distance_left = data.linear;
 							// Arc length of outer track based on radius of turn & given angle
 							float r = (data.linear/data.angular);
-							distance_right = data.angular * (r + WHEEL_BASE);
+							distance_right = data.angular * (r + params.wheel_base);
 
 							// Set velocities
-							velocity_left = TURN_VELOCITY;
-							float dt = distance_left/TURN_VELOCITY;
+							velocity_left = params.turn_velocity;
+							float dt = distance_left/params.turn_velocity;
 							velocity_right = distance_right/dt;
 						}
 						else { // Turn right
@@ -594,11 +709,11 @@ void Message_Handling_Task()
 							distance_right = data.linear;
 							// Arc length of outer track based on radius of turn & given angle
 							float r = (data.linear/data.angular);
-							distance_left = data.angular * (r + WHEEL_BASE);
+							distance_left = data.angular * (r + params.wheel_base);
 
 							// Set velocities
-							velocity_right = TURN_VELOCITY;
-							float dt = distance_right/TURN_VELOCITY;
+							velocity_right = params.turn_velocity;
+							float dt = distance_right/params.turn_velocity;
 							velocity_left = distance_left/dt;
 						}
 					}
@@ -611,10 +726,15 @@ void Message_Handling_Task()
 				Controller_Set_Target_Velocity(&ctr_LeftMotor, velocity_left);
 				Controller_Set_Target_Velocity(&ctr_RightMotor, velocity_right);
 				Zero_Encoders();
+				float planned = Start_Distance_Profiles(distance_left, distance_right, velocity_left, velocity_right);
 
 				// Set flags
 				mf_motor_dist_control.active = true;
 				mf_motor_dist_control.duration = ctr_LeftMotor.update_period;
+				// Give up if a wheel stalls short of its target
+				mf_motor_stop.active = true;
+				mf_motor_stop.duration = planned * DIST_TIMEOUT_SCALE + DIST_TIMEOUT_MS;
+				mf_motor_stop.last_trigger_time = GetTime();
 			}
 			else if(bat_val < 3.0) // Battery Low
 			{
@@ -658,7 +778,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float linear; float angular; float duration; } data;
+			t_Msg_DistanceTimed data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -700,9 +820,9 @@ void Message_Handling_Task()
 					}
 
 					/// Move car around circle
-					if(data.linear < MIN_TURN_ARC) {
+					if(data.linear < params.min_turn_arc) {
 						// Just spin
-						float d = (HALF_WHEEL_BASE * data.angular)/2;
+						float d = (params.wheel_base * data.angular)/4;
 						if(data.angular > 0) {
 							// Spin left
 							distance_left = -1 * d;
@@ -714,8 +834,8 @@ void Message_Handling_Task()
 							distance_right = -1 * d;
 						}
 
-						velocity_left = DutyCycle_to_Velocity_Left(SPIN_DUTYCYLE);
-						velocity_right = DutyCycle_to_Velocity_Right(SPIN_DUTYCYLE);
+						velocity_left = DutyCycle_to_Velocity_Left(params.spin_dutycycle);
+						velocity_right = DutyCycle_to_Velocity_Right(params.spin_dutycycle);
 					}
 					else {
 						// Determine distance and velocity to travel on left and right
@@ -724,11 +844,11 @@ void Message_Handling_Task()
 							distance_left = data.linear;
 							// Arc length of outer track based on radius of turn & given angle
 							float r = (data.linear/data.angular);
-							distance_right = data.angular * (r + WHEEL_BASE);
+							distance_right = data.angular * (r + params.wheel_base);
 
 							// Set velocities
-							velocity_left = TURN_VELOCITY;
-							float dt = distance_left/TURN_VELOCITY;
+							velocity_left = params.turn_velocity;
+							float dt = distance_left/params.turn_velocity;
 							velocity_right = distance_right/dt;
 						}
 						else { // Turn right
@@ -738,11 +858,11 @@ void Message_Handling_Task()
 							distance_right = data.linear;
 							// Arc length of outer track based on radius of turn & given angle
 							float r = (data.linear/data.angular);
-							distance_left = data.angular * (r + WHEEL_BASE);
+							distance_left = data.angular * (r + params.wheel_base);
 
 							// Set velocities
-							velocity_right = TURN_VELOCITY;
-							float dt = distance_right/TURN_VELOCITY;
+							velocity_right = params.turn_velocity;
+							float dt = distance_right/params.turn_velocity;
 							velocity_left = distance_left/dt;
 						}
 					}
@@ -755,6 +875,7 @@ void Message_Handling_Task()
 				Controller_Set_Target_Velocity(&ctr_LeftMotor, velocity_left);
 				Controller_Set_Target_Velocity(&ctr_RightMotor, velocity_right);
 				Zero_Encoders();
+				Start_Distance_Profiles(distance_left, distance_right, velocity_left, velocity_right);
 
 				// Set flags
 				mf_motor_dist_control.active = true;
@@ -806,7 +927,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float velocity; float angular; } data;
+			t_Msg_Velocity data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -844,11 +965,11 @@ void Message_Handling_Task()
 					if(data.angular > 0) { // Turn left
 						// Set velocities
 						velocity_left = data.velocity;
-						velocity_right = data.velocity + WHEEL_BASE * data.angular;
+						velocity_right = data.velocity + params.wheel_base * data.angular;
 					}
 					else { // Turn right
 						// Set velocities
-						velocity_left = data.velocity + WHEEL_BASE * data.angular;
+						velocity_left = data.velocity + params.wheel_base * data.angular;
 						velocity_right = data.velocity;
 					}
 				}
@@ -904,7 +1025,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float velocity; float angular; float duration; } data;
+			t_Msg_VelocityTimed data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -942,11 +1063,11 @@ void Message_Handling_Task()
 					if(data.angular > 0) { // Turn left
 						// Set velocities
 						velocity_left = data.velocity;
-						velocity_right = data.velocity + WHEEL_BASE * data.angular;
+						velocity_right = data.velocity + params.wheel_base * data.angular;
 					}
 					else { // Turn right
 						// Set velocities
-						velocity_left = data.velocity + WHEEL_BASE * data.angular;
+						velocity_left = data.velocity + params.wheel_base * data.angular;
 						velocity_right = data.velocity;
 					}
 				}
@@ -992,6 +1113,56 @@ void Message_Handling_Task()
 		}
 		break;
 
+#ifdef CONFIG_TELEOP
+	case 'j':	// Teleop velocity
+		if( usb_msg_length() >= MEGN540_Message_Len('j') )
+		{
+			// Remove char byte
+			usb_msg_get();
+
+			t_Msg_Teleop data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			// Sent many times a second, so no reply unless the battery says no
+			if(Battery_Voltage() < 4.75)
+			{
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, 1);
+				break;
+			}
+
+			// Only the first command of a session resets the drive, later ones just retarget
+			if(!teleop || !mf_motor_vel_control.active)
+			{
+				Reset_Drive_Flags();
+				Zero_Encoders();
+				Controller_Set_Target_Position(&ctr_LeftMotor, 0);
+				Controller_Set_Target_Position(&ctr_RightMotor, 0);
+
+				mf_motor_vel_control.active = true;
+				mf_motor_vel_control.duration = ctr_LeftMotor.update_period;
+				teleop = true;
+			}
+
+			// Same wheel split as 'V'
+			if(data.angular > 0) {
+				Controller_Set_Target_Velocity(&ctr_LeftMotor, data.linear);
+				Controller_Set_Target_Velocity(&ctr_RightMotor, data.linear + params.wheel_base * data.angular);
+			}
+			else {
+				Controller_Set_Target_Velocity(&ctr_LeftMotor, data.linear + params.wheel_base * data.angular);
+				Controller_Set_Target_Velocity(&ctr_RightMotor, data.linear);
+			}
+
+			// Watchdog: the robot stops unless the next command arrives in time
+			mf_motor_stop.active = true;
+			mf_motor_stop.duration = params.teleop_timeout_ms;
+			mf_motor_stop.last_trigger_time = GetTime();
+		}
+		break;
+#endif
+
+#ifdef CONFIG_IR
 	case 'i':	// Send IR distances
 		if( usb_msg_length() >= MEGN540_Message_Len('i') )
 		{
@@ -1010,7 +1181,7 @@ void Message_Handling_Task()
 			usb_msg_get();
 
 			// Build structure to put data in
-			struct __attribute__((__packed__)) { float duration; } data;
+			t_Msg_IrRepeat data;
 
 			// Copy the bytes from the usb receive buffer into structure
 			usb_msg_read_into( &data, sizeof(data) );
@@ -1025,8 +1196,10 @@ void Message_Handling_Task()
 			}
 		}
 		break;
+#endif
 
-	case 'G':	// Send IR distances
+#ifdef CONFIG_SERVO
+	case 'G':	// Open/close the gripper
 		if( usb_msg_length() >= MEGN540_Message_Len('G') )
 		{
 			// Remove first byte
@@ -1039,13 +1212,11 @@ void Message_Handling_Task()
 			if(command == 'O')
 			{
 				// Open the gripper
-//				void Open_Servo();
-				Servo_PWM_Init(OPEN);
+				Gripper_Move(SERVO_OPEN_POS, 0);
 			}
 			else if (command == 'C') {
 				// Close the gripper
-//				void Close_Servo();
-				Servo_PWM_Init(CLOSE);
+				Gripper_Move(SERVO_CLOSED_POS, 0);
 			}
 			else {
 				// Unrecognized command..
@@ -1055,6 +1226,29 @@ void Message_Handling_Task()
 		}
 		break;
 
+	case 'g':	// Move the gripper to a position
+		if( usb_msg_length() >= MEGN540_Message_Len('g') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Position [%] (0 open, 100 closed) and speed [%/s] (0 for default)
+			t_Msg_GripperMove data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			if(data.position <= SERVO_CLOSED_POS && data.speed >= 0)
+			{
+				Gripper_Move(data.position, data.speed);
+			}
+			else {
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_OA
   case 'O':	// Object Avoidance
     if( usb_msg_length() >= MEGN540_Message_Len('O') )
     {
@@ -1062,7 +1256,7 @@ void Message_Handling_Task()
 		usb_msg_get();
 
 		// Build structure to put data in
-		struct __attribute__((__packed__)) { float duration; } data;
+		t_Msg_Avoid data;
 
 		// Copy the bytes from the usb receive buffer into structure
 		usb_msg_read_into( &data, sizeof(data) );
@@ -1110,6 +1304,332 @@ void Message_Handling_Task()
 		}
     }
     break;
+#endif
+
+#ifdef CONFIG_PROFILER
+	case 'h':	// Task profiler
+		if( usb_msg_length() >= MEGN540_Message_Len('h') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// 0x00 dump, 0x01 dump and clear, 0x02 clear
+			char action = usb_msg_get();
+
+			if(action == 0x00 || action == 0x01) {
+				Profiler_Dump_Start(action == 0x01);
+				mf_profiler_dump.active = true;
+				mf_profiler_dump.duration = 0;
+			}
+			else if(action == 0x02) {
+				Profiler_Init();
+			}
+			else {
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_TRACE
+	case 'l':	// Flight recorder
+		if( usb_msg_length() >= MEGN540_Message_Len('l') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// 0x00 dump, 0x01 dump EEPROM snapshot, 0x02 clear, 0x03 take a snapshot
+			char action = usb_msg_get();
+			bool ok = true;
+
+			if(action == 0x00 || action == 0x01) {
+				ok = Trace_Dump(action == 0x01);
+			}
+			else if(action == 0x02) {
+				Trace_Init();
+			}
+			else if(action == 0x03) {
+				ok = Trace_Snapshot_Start();
+				mf_trace_snapshot.active = ok;
+				mf_trace_snapshot.duration = 0;
+			}
+			else {
+				ok = false;
+			}
+
+			if(!ok) {
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_LINK_BENCH
+	case 'u':	// USB link benchmark
+		if( usb_msg_length() >= MEGN540_Message_Len('u') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Action, count (or ping sequence number) and packet size
+			t_Msg_LinkBench data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			bool ok = true;
+
+			if(data.action == 'P') {
+				Link_Bench_Ping(data.count);
+			}
+			else if(data.action == 'S' || data.action == 'B') {
+				ok = Link_Bench_Start(data.count, data.size, data.action == 'B');
+				mf_link_bench.active = ok;
+				mf_link_bench.duration = 0;
+			}
+			else if(data.action == 'A') {
+				Link_Bench_Abort();
+			}
+			else {
+				ok = false;
+			}
+
+			if(!ok) {
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_TELEMETRY
+	case 'Y':	// Telemetry subscription
+		if( usb_msg_length() >= MEGN540_Message_Len('Y') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Channel (TELEM_ALL for every one) and period [s], 0 unsubscribes
+			t_Msg_TelemetrySubscribe data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			if(Telemetry_Subscribe(data.channel, data.period))
+			{
+				// Ticks until the last channel is unsubscribed
+				mf_telemetry.active = true;
+				mf_telemetry.duration = TELEM_TICK_MS;
+			}
+			else
+			{
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_TELEMETRY
+	case 'y':	// Telemetry encoding
+		if( usb_msg_length() >= MEGN540_Message_Len('y') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// 0 plain, 1 delta, and the keyframe interval (0 for the default)
+			t_Msg_TelemetryEncoding data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			if(data.encoding <= 1)
+			{
+				Telemetry_Set_Encoding(data.encoding == 1, data.interval);
+			}
+			else
+			{
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_STACK
+	case 'm':	// RAM and stack high-water mark
+		if( usb_msg_length() >= MEGN540_Message_Len('m') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			Stack_Stats_t stats = Stack_Get_Stats();
+			usb_send_msg("cHHHH", command, &stats, sizeof(stats));
+		}
+		break;
+#endif
+
+#ifdef CONFIG_PARAMS
+	case 'k':	// Read runtime parameters
+		if( usb_msg_length() >= MEGN540_Message_Len('k') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// First id and how many, 0 for the rest
+			t_Msg_ParamGet data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			if(Params_Dump_Start(data.first, data.count))
+			{
+				mf_params_dump.active = true;
+				mf_params_dump.duration = 0;
+			}
+			else
+			{
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+
+	case 'K':	// Set runtime parameters
+		if( usb_msg_length() >= MEGN540_Message_Len('K') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Count, then the ids and their values
+			t_Msg_ParamSet data;
+			usb_msg_read_into( &data, sizeof(data) );
+
+			if(data.count <= PARAMS_CHUNK)
+			{
+				struct __attribute__((__packed__)) { uint8_t applied; uint8_t rejected; } reply;
+				reply.rejected = Params_Set(&data);
+				reply.applied = (reply.rejected == PARAMS_NO_ID) ? data.count : 0;
+				usb_send_msg("cBB", command, &reply, sizeof(reply));
+			}
+			else
+			{
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+
+	case 'n':	// Save, load or reset the runtime parameters
+		if( usb_msg_length() >= MEGN540_Message_Len('n') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// 0x00 save to EEPROM, 0x01 load from EEPROM, 0x02 defaults
+			char action = usb_msg_get();
+			struct __attribute__((__packed__)) { char action; uint8_t ok; } reply = { action, 1 };
+
+			if(action == 0x00) {
+				// Replies once the save is written
+				Params_Save_Start();
+				mf_params_save.active = true;
+				mf_params_save.duration = 0;
+			}
+			else if(action == 0x01) {
+				reply.ok = Params_Load();
+				usb_send_msg("ccB", command, &reply, sizeof(reply));
+			}
+			else if(action == 0x02) {
+				Params_Defaults();
+				usb_send_msg("ccB", command, &reply, sizeof(reply));
+			}
+			else {
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
+
+#ifdef CONFIG_TRAJECTORY
+	case 'W':	// Queue a trajectory segment
+		if( usb_msg_length() >= MEGN540_Message_Len('W') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Segment type followed by its three parameters
+			t_TrajSegment data;
+
+			// Copy the bytes from the usb receive buffer into structure
+			usb_msg_read_into( &data, sizeof(data) );
+
+			// Sends its own 'F' event on failure
+			Trajectory_Add(&data);
+		}
+		break;
+
+	case 'w':	// Trajectory control
+		if( usb_msg_length() >= MEGN540_Message_Len('w') )
+		{
+			// Remove first byte
+			usb_msg_get();
+
+			// Grab action from buffer (G: go, C: clear/abort, R: report)
+			char action;
+			usb_msg_read_into( &action, sizeof(action) );
+
+			if(action == 'G')
+			{
+				float bat_val = Battery_Voltage();
+
+				// Check power levels
+				if(bat_val >= 4.75)
+				{
+					// Reset all motor control related flags
+					Reset_Drive_Flags();
+
+					if(Trajectory_Start())
+					{
+						mf_trajectory.active = true;
+						mf_trajectory.duration = ctr_LeftMotor.update_period;
+						mf_trajectory.last_trigger_time = GetTime();
+					}
+					else {
+						// Nothing queued
+						char bad_input = '?';
+						usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+					}
+				}
+				else
+				{
+					// Create struct for message
+					struct {char let[7]; float volts; } data =
+					{
+							.let = {'B', 'A', 'T', ' ', 'L', 'O', 'W'},
+							.volts = bat_val
+					};
+					// Send bat-low message
+					usb_send_msg("ccccccccf", '!', &data, sizeof(data));
+				}
+			}
+			else if(action == 'C')
+			{
+				mf_trajectory.active = false;
+				Trajectory_Abort();
+			}
+			else if(action == 'R')
+			{
+				struct __attribute__((__packed__)) { char event; uint8_t count; } data =
+				{
+						.event = 'R',
+						.count = Trajectory_Length()
+				};
+				usb_send_msg("ccB", command, &data, sizeof(data));
+			}
+			else {
+				// Unrecognized command..
+				char bad_input = '?';
+				usb_send_msg("cc", command, &bad_input, sizeof(bad_input));
+			}
+		}
+		break;
+#endif
 
 	default:
 		// Clear input buffer
@@ -1127,11 +1647,19 @@ void Message_Handling_Task()
  * Function Reset_Drive_Flags reset all motor control related flags and parameters
  */
 void Reset_Drive_Flags() {
+#ifdef CONFIG_OA
 	mf_obj_avoidance.active = false;
+#endif
 	mf_motor_dist_control.active = false;
 	mf_motor_vel_control.active = false;
 	mf_motor_stop.active = false;
 	mf_timed_pwm.active = false;
+#ifdef CONFIG_TRAJECTORY
+	mf_trajectory.active = false;
+#endif
+#ifdef CONFIG_TELEOP
+	teleop = false;
+#endif
 
 	// Turn off red LED
 	Set_LED(RED, false);
@@ -1140,48 +1668,14 @@ void Reset_Drive_Flags() {
 
 
 /**
- * Function MEGN540_Message_Len returns the number of bytes associated with a command string per the
- * class documentation;
+ * Function MEGN540_Message_Len returns the number of bytes associated with a command string per
+ * Application/protocol.def;
  * @param cmd
  * @return Size of expected string. Returns 0 if unreconized.
  */
 uint8_t MEGN540_Message_Len( char cmd )
 {
-	switch(cmd)
-	{
-		case '~': return	1; break;
-		case '*': return	9; break;
-		case '/': return	9; break;
-		case '+': return	9; break;
-		case '-': return	9; break;
-		case 't': return	2; break;
-		case 'T': return	6; break;
-		case 'e': return	1; break;
-		case 'E': return	5; break;
-		case 'b': return	1; break;
-		case 'B': return	5; break;
-		//        case 'a': return	1; break;
-		//        case 'A': return 	5; break;
-		//        case 'w': return	1; break;
-		//        case 'W': return 	5; break;
-		//        case 'm': return	1; break;
-		//        case 'M': return	5; break;
-		case 'p': return	5; break;
-		case 'P': return	9; break;
-		case 's': return 	1; break;
-		case 'S': return 	1; break;
-		case 'q': return	1; break;
-		case 'Q': return 	5; break;
-		case 'd': return 	9; break;
-		case 'D': return	13; break;
-		case 'v': return	9; break;
-		case 'V': return	13; break;
-		case 'i': return	1; break;
-		case 'I': return	5; break;
-		case 'G': return	2; break;
-		case 'O': return	5; break;
-		default:  return	0; break;
-	}
+	return MEGN540_Protocol_Len(cmd);
 }
 
 /**
@@ -38,13 +38,16 @@
 #include "../Driver/include_driver.h"
 #include "application_defines.h"
 #include "Obstacle_Avoidance.h"
+#include "Trajectory.h"
+#include "Profiler.h"
+#include "Link_Bench.h"
+#include "Gripper.h"
+#include "Telemetry.h"
+#include "Params.h"
+#include "MEGN540_Protocol.h"
 
 #include <math.h>
 
-#define TURN_VELOCITY	0.1
-#define MIN_TURN_ARC	0.04
-#define SPIN_DUTYCYLE	25
-
 /**
  * Function MSG_FLAG_Execute indicates if the action associated with the message flag should be executed
  * in the main loop both because its active and because its time.
@@ -52,6 +55,11 @@
  */
 bool MSG_FLAG_Execute( MSG_FLAG_t* );
 
+/**
+ * Function MSG_FLAG_Any_Executed returns true if any flag's action was due since the last call.
+ */
+bool MSG_FLAG_Any_Executed();
+
 /**
  * Function Message_Handling_Init initializes the message handling and all associated state flags and data to their default
  * conditions.
@@ -71,8 +79,8 @@ void Message_Handling_Task();
 void Reset_Drive_Flags();
 
 /**
- * Function MEGN540_Message_Len returns the number of bytes associated with a command string per the
- * class documentation;
+ * Function MEGN540_Message_Len returns the number of bytes associated with a command string per
+ * Application/protocol.def;
  * @param cmd
  * @return Size of expected string. Returns 0 if unrecognized.
  */
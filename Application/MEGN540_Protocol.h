@@ -0,0 +1,451 @@
+/*
+ * MEGN540_Protocol.h, generated by User/protocol_gen.py from
+ * Application/protocol.def. Do not edit: change the schema and run
+ *
+ *      python3 User/protocol_gen.py
+ *
+ * t_Msg_<Name> is a command's payload, the bytes after its char, ready for
+ * usb_msg_read_into. t_Telem_<Name> and TELEM_FMT_<NAME> are a telemetry
+ * channel's data and format in a plain 'Y' frame. t_Params is the runtime
+ * parameter table, see Params.h.
+ */
+#ifndef MEGN540_PROTOCOL_H
+#define MEGN540_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+ * Command payloads
+ */
+// '*' multiply
+typedef struct __attribute__((__packed__)) {
+	float v1;
+	float v2;
+} t_Msg_Multiply;
+_Static_assert(sizeof(t_Msg_Multiply) == 8, "'*' payload is 8 bytes");
+
+// '/' divide
+typedef struct __attribute__((__packed__)) {
+	float v1;
+	float v2;
+} t_Msg_Divide;
+_Static_assert(sizeof(t_Msg_Divide) == 8, "'/' payload is 8 bytes");
+
+// '+' add
+typedef struct __attribute__((__packed__)) {
+	float v1;
+	float v2;
+} t_Msg_Add;
+_Static_assert(sizeof(t_Msg_Add) == 8, "'+' payload is 8 bytes");
+
+// '-' subtract
+typedef struct __attribute__((__packed__)) {
+	float v1;
+	float v2;
+} t_Msg_Subtract;
+_Static_assert(sizeof(t_Msg_Subtract) == 8, "'-' payload is 8 bytes");
+
+// 't' time
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_Time;
+_Static_assert(sizeof(t_Msg_Time) == 1, "'t' payload is 1 bytes");
+
+// 'T' time_repeat
+typedef struct __attribute__((__packed__)) {
+	char action;
+	float duration;
+} t_Msg_TimeRepeat;
+_Static_assert(sizeof(t_Msg_TimeRepeat) == 5, "'T' payload is 5 bytes");
+
+// 'c' clock_sync
+typedef struct __attribute__((__packed__)) {
+	uint8_t sequence;
+} t_Msg_ClockSync;
+_Static_assert(sizeof(t_Msg_ClockSync) == 1, "'c' payload is 1 bytes");
+
+// 'E' encoders_repeat
+typedef struct __attribute__((__packed__)) {
+	float duration;
+} t_Msg_EncodersRepeat;
+_Static_assert(sizeof(t_Msg_EncodersRepeat) == 4, "'E' payload is 4 bytes");
+
+// 'B' battery_repeat
+typedef struct __attribute__((__packed__)) {
+	float duration;
+} t_Msg_BatteryRepeat;
+_Static_assert(sizeof(t_Msg_BatteryRepeat) == 4, "'B' payload is 4 bytes");
+
+// 'Q' status_repeat
+typedef struct __attribute__((__packed__)) {
+	float duration;
+} t_Msg_StatusRepeat;
+_Static_assert(sizeof(t_Msg_StatusRepeat) == 4, "'Q' payload is 4 bytes");
+
+// 'p' pwm
+typedef struct __attribute__((__packed__)) {
+	int16_t left;
+	int16_t right;
+} t_Msg_Pwm;
+_Static_assert(sizeof(t_Msg_Pwm) == 4, "'p' payload is 4 bytes");
+
+// 'P' pwm_timed
+typedef struct __attribute__((__packed__)) {
+	int16_t left;
+	int16_t right;
+	float duration;
+} t_Msg_PwmTimed;
+_Static_assert(sizeof(t_Msg_PwmTimed) == 8, "'P' payload is 8 bytes");
+
+// 'd' distance
+typedef struct __attribute__((__packed__)) {
+	float linear;
+	float angular;
+} t_Msg_Distance;
+_Static_assert(sizeof(t_Msg_Distance) == 8, "'d' payload is 8 bytes");
+
+// 'D' distance_timed
+typedef struct __attribute__((__packed__)) {
+	float linear;
+	float angular;
+	float duration;
+} t_Msg_DistanceTimed;
+_Static_assert(sizeof(t_Msg_DistanceTimed) == 12, "'D' payload is 12 bytes");
+
+// 'v' velocity
+typedef struct __attribute__((__packed__)) {
+	float velocity;
+	float angular;
+} t_Msg_Velocity;
+_Static_assert(sizeof(t_Msg_Velocity) == 8, "'v' payload is 8 bytes");
+
+// 'V' velocity_timed
+typedef struct __attribute__((__packed__)) {
+	float velocity;
+	float angular;
+	float duration;
+} t_Msg_VelocityTimed;
+_Static_assert(sizeof(t_Msg_VelocityTimed) == 12, "'V' payload is 12 bytes");
+
+// 'j' teleop
+typedef struct __attribute__((__packed__)) {
+	float linear;
+	float angular;
+} t_Msg_Teleop;
+_Static_assert(sizeof(t_Msg_Teleop) == 8, "'j' payload is 8 bytes");
+
+// 'I' ir_repeat
+typedef struct __attribute__((__packed__)) {
+	float duration;
+} t_Msg_IrRepeat;
+_Static_assert(sizeof(t_Msg_IrRepeat) == 4, "'I' payload is 4 bytes");
+
+// 'G' gripper
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_Gripper;
+_Static_assert(sizeof(t_Msg_Gripper) == 1, "'G' payload is 1 bytes");
+
+// 'g' gripper_move
+typedef struct __attribute__((__packed__)) {
+	uint8_t position;
+	float speed;
+} t_Msg_GripperMove;
+_Static_assert(sizeof(t_Msg_GripperMove) == 5, "'g' payload is 5 bytes");
+
+// 'O' avoid
+typedef struct __attribute__((__packed__)) {
+	float duration;
+} t_Msg_Avoid;
+_Static_assert(sizeof(t_Msg_Avoid) == 4, "'O' payload is 4 bytes");
+
+// 'h' profiler
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_Profiler;
+_Static_assert(sizeof(t_Msg_Profiler) == 1, "'h' payload is 1 bytes");
+
+// 'l' trace
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_Trace;
+_Static_assert(sizeof(t_Msg_Trace) == 1, "'l' payload is 1 bytes");
+
+// 'W' trajectory_segment
+typedef struct __attribute__((__packed__)) {
+	char type;
+	float p1;
+	float p2;
+	float p3;
+} t_Msg_TrajectorySegment;
+_Static_assert(sizeof(t_Msg_TrajectorySegment) == 13, "'W' payload is 13 bytes");
+
+// 'w' trajectory_control
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_TrajectoryControl;
+_Static_assert(sizeof(t_Msg_TrajectoryControl) == 1, "'w' payload is 1 bytes");
+
+// 'u' link_bench
+typedef struct __attribute__((__packed__)) {
+	char action;
+	uint16_t count;
+	uint8_t size;
+} t_Msg_LinkBench;
+_Static_assert(sizeof(t_Msg_LinkBench) == 4, "'u' payload is 4 bytes");
+
+// 'Y' telemetry_subscribe
+typedef struct __attribute__((__packed__)) {
+	uint8_t channel;
+	float period;
+} t_Msg_TelemetrySubscribe;
+_Static_assert(sizeof(t_Msg_TelemetrySubscribe) == 5, "'Y' payload is 5 bytes");
+
+// 'y' telemetry_encoding
+typedef struct __attribute__((__packed__)) {
+	uint8_t encoding;
+	uint8_t interval;
+} t_Msg_TelemetryEncoding;
+_Static_assert(sizeof(t_Msg_TelemetryEncoding) == 2, "'y' payload is 2 bytes");
+
+// 'k' param_get
+typedef struct __attribute__((__packed__)) {
+	uint8_t first;
+	uint8_t count;
+} t_Msg_ParamGet;
+_Static_assert(sizeof(t_Msg_ParamGet) == 2, "'k' payload is 2 bytes");
+
+// 'K' param_set
+typedef struct __attribute__((__packed__)) {
+	uint8_t count;
+	uint8_t id[6];
+	uint32_t value[6];
+} t_Msg_ParamSet;
+_Static_assert(sizeof(t_Msg_ParamSet) == 31, "'K' payload is 31 bytes");
+
+// 'n' param_store
+typedef struct __attribute__((__packed__)) {
+	char action;
+} t_Msg_ParamStore;
+_Static_assert(sizeof(t_Msg_ParamStore) == 1, "'n' payload is 1 bytes");
+
+/*
+ * Telemetry channels, in eTelemChannel order
+ */
+#define TELEM_FMT_ENCODERS	"ii"
+typedef struct __attribute__((__packed__)) {
+	int32_t left;
+	int32_t right;
+} t_Telem_Encoders;
+_Static_assert(sizeof(t_Telem_Encoders) == 8, "encoders channel is 8 bytes");
+
+#define TELEM_FMT_BATTERY	"f"
+typedef struct __attribute__((__packed__)) {
+	float volts;
+} t_Telem_Battery;
+_Static_assert(sizeof(t_Telem_Battery) == 4, "battery channel is 4 bytes");
+
+#define TELEM_FMT_PWM	"hh"
+typedef struct __attribute__((__packed__)) {
+	int16_t left;
+	int16_t right;
+} t_Telem_Pwm;
+_Static_assert(sizeof(t_Telem_Pwm) == 4, "pwm channel is 4 bytes");
+
+#define TELEM_FMT_POSE	"fff"
+typedef struct __attribute__((__packed__)) {
+	float x;
+	float y;
+	float heading;
+} t_Telem_Pose;
+_Static_assert(sizeof(t_Telem_Pose) == 12, "pose channel is 12 bytes");
+
+#define TELEM_FMT_IR	"hc"
+typedef struct __attribute__((__packed__)) {
+	int16_t count;
+	char side;
+} t_Telem_Ir;
+_Static_assert(sizeof(t_Telem_Ir) == 3, "ir channel is 3 bytes");
+
+#define TELEM_FMT_CONTROL	"ff"
+typedef struct __attribute__((__packed__)) {
+	float target_left;
+	float target_right;
+} t_Telem_Control;
+_Static_assert(sizeof(t_Telem_Control) == 8, "control channel is 8 bytes");
+
+/*
+ * Function MEGN540_Protocol_Len returns the length of command cmd including its char, 0 if it is
+ * unknown or its feature is off. The table lives in flash, one byte per 7-bit char.
+ */
+static inline uint8_t MEGN540_Protocol_Len(char cmd)
+{
+	static const uint8_t lengths[128] PROGMEM = {
+		['~'] = 1,
+		['*'] = 9,
+		['/'] = 9,
+		['+'] = 9,
+		['-'] = 9,
+		['t'] = 2,
+		['T'] = 6,
+		['c'] = 2,
+		['e'] = 1,
+		['E'] = 5,
+		['b'] = 1,
+		['B'] = 5,
+		['q'] = 1,
+		['Q'] = 5,
+		['p'] = 5,
+		['P'] = 9,
+		['s'] = 1,
+		['S'] = 1,
+		['d'] = 9,
+		['D'] = 13,
+		['v'] = 9,
+		['V'] = 13,
+#ifdef CONFIG_TELEOP
+		['j'] = 9,
+#endif
+#ifdef CONFIG_IR
+		['i'] = 1,
+		['I'] = 5,
+#endif
+#ifdef CONFIG_SERVO
+		['G'] = 2,
+		['g'] = 6,
+#endif
+#ifdef CONFIG_OA
+		['O'] = 5,
+#endif
+#ifdef CONFIG_PROFILER
+		['h'] = 2,
+#endif
+#ifdef CONFIG_TRACE
+		['l'] = 2,
+#endif
+#ifdef CONFIG_TRAJECTORY
+		['W'] = 14,
+		['w'] = 2,
+#endif
+#ifdef CONFIG_LINK_BENCH
+		['u'] = 5,
+#endif
+#ifdef CONFIG_STACK
+		['m'] = 1,
+#endif
+#ifdef CONFIG_TELEMETRY
+		['Y'] = 6,
+		['y'] = 3,
+#endif
+#ifdef CONFIG_PARAMS
+		['k'] = 3,
+		['K'] = 32,
+		['n'] = 2,
+#endif
+	};
+
+	if((uint8_t)cmd >= sizeof(lengths)) {
+		return 0;
+	}
+	return pgm_read_byte(&lengths[(uint8_t)cmd]);
+}
+
+/*
+ * Runtime parameters. An id addresses one value, an array takes an id per
+ * element. The defaults are the constants named in the schema, defined
+ * where PARAMS_DEFAULTS is used.
+ */
+#define PARAMS_COUNT	26
+#define PARAMS_LAYOUT	0xAD86	// changes with the ids, names and types
+
+typedef struct {
+	float wheel_base;	// 0
+	float distance_per_count;	// 1
+	float turn_velocity;	// 2
+	float min_turn_arc;	// 3
+	int16_t spin_dutycycle;	// 4
+	float dist_accel;	// 5
+	float dist_creep;	// 6
+	float oa_turn_velocity;	// 7
+	float oa_angular_velocity;	// 8
+	int16_t oa_drive_duty;	// 9
+	uint16_t oa_hold_timeout;	// 10
+	uint16_t teleop_timeout_ms;	// 11
+	float kp_left;	// 12
+	float num_left[3];	// 13 to 15
+	float den_left[3];	// 16 to 18
+	float kp_right;	// 19
+	float num_right[3];	// 20 to 22
+	float den_right[3];	// 23 to 25
+} t_Params;
+_Static_assert(sizeof(t_Params) <= 255, "t_Params offsets fit a byte");
+
+#define PARAMS_DEFAULTS { \
+	.wheel_base = WHEEL_BASE, \
+	.distance_per_count = DISTANCE_PER_COUNT, \
+	.turn_velocity = TURN_VELOCITY, \
+	.min_turn_arc = MIN_TURN_ARC, \
+	.spin_dutycycle = SPIN_DUTYCYLE, \
+	.dist_accel = DIST_ACCEL, \
+	.dist_creep = DIST_CREEP, \
+	.oa_turn_velocity = OA_TURN_VELOCITY, \
+	.oa_angular_velocity = OA_ANGLR_VELOCITY, \
+	.oa_drive_duty = OA_DRIVE_DC, \
+	.oa_hold_timeout = OA_HOLD_TIMEOUT, \
+	.teleop_timeout_ms = TELEOP_TIMEOUT_MS, \
+	.kp_left = KP_L, \
+	.num_left = NUM_LEFT, \
+	.den_left = DEN_LEFT, \
+	.kp_right = KP_R, \
+	.num_right = NUM_RIGHT, \
+	.den_right = DEN_RIGHT, \
+}
+
+typedef struct { uint8_t offset; char code; } t_Param_Info;
+
+/*
+ * Function MEGN540_Param_Info returns where parameter id lives in t_Params and its struct code ('f',
+ * 'h', 'B', ...), code 0 if there is no such id. The table lives in flash.
+ */
+static inline t_Param_Info MEGN540_Param_Info(uint8_t id)
+{
+	static const t_Param_Info info[PARAMS_COUNT] PROGMEM = {
+		{ offsetof(t_Params, wheel_base), 'f' },	// 0
+		{ offsetof(t_Params, distance_per_count), 'f' },	// 1
+		{ offsetof(t_Params, turn_velocity), 'f' },	// 2
+		{ offsetof(t_Params, min_turn_arc), 'f' },	// 3
+		{ offsetof(t_Params, spin_dutycycle), 'h' },	// 4
+		{ offsetof(t_Params, dist_accel), 'f' },	// 5
+		{ offsetof(t_Params, dist_creep), 'f' },	// 6
+		{ offsetof(t_Params, oa_turn_velocity), 'f' },	// 7
+		{ offsetof(t_Params, oa_angular_velocity), 'f' },	// 8
+		{ offsetof(t_Params, oa_drive_duty), 'h' },	// 9
+		{ offsetof(t_Params, oa_hold_timeout), 'H' },	// 10
+		{ offsetof(t_Params, teleop_timeout_ms), 'H' },	// 11
+		{ offsetof(t_Params, kp_left), 'f' },	// 12
+		{ offsetof(t_Params, num_left[0]), 'f' },	// 13
+		{ offsetof(t_Params, num_left[1]), 'f' },	// 14
+		{ offsetof(t_Params, num_left[2]), 'f' },	// 15
+		{ offsetof(t_Params, den_left[0]), 'f' },	// 16
+		{ offsetof(t_Params, den_left[1]), 'f' },	// 17
+		{ offsetof(t_Params, den_left[2]), 'f' },	// 18
+		{ offsetof(t_Params, kp_right), 'f' },	// 19
+		{ offsetof(t_Params, num_right[0]), 'f' },	// 20
+		{ offsetof(t_Params, num_right[1]), 'f' },	// 21
+		{ offsetof(t_Params, num_right[2]), 'f' },	// 22
+		{ offsetof(t_Params, den_right[0]), 'f' },	// 23
+		{ offsetof(t_Params, den_right[1]), 'f' },	// 24
+		{ offsetof(t_Params, den_right[2]), 'f' },	// 25
+	};
+
+	t_Param_Info param = { 0, 0 };
+	if(id < PARAMS_COUNT) {
+		param.offset = pgm_read_byte(&info[id].offset);
+		param.code = pgm_read_byte(&info[id].code);
+	}
+	return param;
+}
+
+#endif
@@ -31,17 +31,13 @@
 #include "../Driver/include_driver.h"
 #include "MEGN540_MessageHandeling.h"
 #include "Obstacle_Avoidance.h"
+#include "Profiler.h"
 #include "application_defines.h"
+#include "Controller_Coeffs.h"
+#include "Params.h"
 
 #define DEBUG		0
 #define CNTRL_SYS	0
-#define KP_L		0.1875335
-#define KP_R		0.1728258
-
-float num_left[] = {0.187533508705,		0.124897316798}; // b coefficients
-float num_right[] = {0.172825818795,	0.130440286735};
-float den_left[] = {1.000000000000,		-1.000000000000}; // a coefficients
-float den_right[] = {1.000000000000,	-1.000000000000};
 
 void InitializeSystem()
 {
@@ -58,23 +54,44 @@ void InitializeSystem()
 	LED_Init();
 	// Initialize PMW
 	Motor_PWM_Init(0x190); // 400 => 20 kHz
+#ifdef CONFIG_IR
 	// Initialize IR proximity sensor
 	Proxy_Init();
+#endif
+#ifdef CONFIG_SERVO
 	// Configure the servo motor for the gripper
 	Servo_PWM_Init(OPEN);
+#endif
 	// Initialize USB
 	USB_SetupHardware();
 
+	// Start the flight recorder
+	Trace_Init();
+
 	/*
 	 * Initialize application features
 	 */
-	// Initialize the left and right motor controller
-	Controller_Init(&ctr_LeftMotor, KP_L, num_left, den_left, 1, 10); // 10ms => 100 Hz
-	Controller_Init(&ctr_RightMotor, KP_R, num_right, den_right, 1, 10); // 10ms => 100 Hz
+	// Load the runtime parameters, saved or default
+	Params_Init();
+	// Initialize the left and right motor controller, b and a coefficients from the parameters
+	Controller_Init(&ctr_LeftMotor, params.kp_left, params.num_left, params.den_left, CONTROLLER_ORDER,
+			CONTROLLER_PERIOD_MS);
+	Controller_Init(&ctr_RightMotor, params.kp_right, params.num_right, params.den_right, CONTROLLER_ORDER,
+			CONTROLLER_PERIOD_MS);
 	// Initialize message handling
 	Message_Handling_Init();
+#ifdef CONFIG_OA
 	// Initialize obstacle avoidance logic
 	Init_Obstacle_Avoidance();
+#endif
+#ifdef CONFIG_TRAJECTORY
+	// Initialize the trajectory queue
+	Trajectory_Init();
+#endif
+	// Sleep when the main loop is idle
+	Idle_Init();
+	// Clear the task profiler
+	Profiler_Init();
 
 	/*
 	 * Enable Global Interrupts for USB and Timer etc.
@@ -98,7 +115,9 @@ int main(void)
 	float ticksR_new;
 	float time_new;
 	bool first_time = true;
+#ifdef CONFIG_IR
 	bool proxy_first = true;
+#endif
 
 	// Initialize hardware and various features
 	InitializeSystem();
@@ -109,25 +128,46 @@ int main(void)
 
 	while(true)
 	{
+		uint16_t loop_start = Profiler_Start();
+
 		// USB serial comms up-keep
 		USB_Upkeep_Task();
+		Profiler_Record(PROF_USB, loop_start);
+
 		// Manage USB messaging
+		uint16_t msg_start = Profiler_Start();
 		Message_Handling_Task();
+		Profiler_Record(PROF_MESSAGES, msg_start);
 
 		// Reset message handling
 		if(MSG_FLAG_Execute(&mf_restart))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Reinitialize stuff...
 			Message_Handling_Init();
+
+			Profiler_Record(PROF_RESTART, prof_start);
 		}
 
 		// Process battery low
 		if(MSG_FLAG_Execute(&mf_battery_task))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Update battery monitoring
 			bat_val = Battery_Voltage_Task();
 			if((bat_val < 4.75) && (bat_val > 3.0)) // battery low condition
 			{
+				if(!mf_low_battery.active)
+				{
+					// Keep what led up to the trip
+					Trace_Write(TRACE_LOW_BATTERY, (uint8_t)(bat_val * 20));
+#ifdef CONFIG_TRACE
+					mf_trace_snapshot.active = Trace_Snapshot_Start();
+					mf_trace_snapshot.duration = 0;
+#endif
+				}
 				mf_low_battery.active = true;
 				mf_low_battery.duration = 1000;
 			}
@@ -137,11 +177,15 @@ int main(void)
 			}
 
 			mf_battery_task.last_trigger_time = GetTime();
+
+			Profiler_Record(PROF_BATTERY_TASK, prof_start);
 		}
 
 		// Process send-time command
 		if(MSG_FLAG_Execute(&mf_send_time))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Get current time
 			Time_t now = GetTime();
 			float ret_val = ((float)now.millisec + now.microsec/1000.0)/1000.0;
@@ -158,11 +202,15 @@ int main(void)
 				Send_Time_Message('T', 0x00, ret_val);
 				mf_send_time.last_trigger_time = GetTime();
 			}
+
+			Profiler_Record(PROF_SEND_TIME, prof_start);
 		}
 
 		// Process send-float-time command
 		if(MSG_FLAG_Execute(&mf_time_float_send))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			static bool trip = false;
 			static Time_t start_time;
 
@@ -195,11 +243,15 @@ int main(void)
 					trip = false;
 				}
 			}
+
+			Profiler_Record(PROF_TIME_FLOAT_SEND, prof_start);
 		}
 
 		// Process loop-time command
 		if(MSG_FLAG_Execute(&mf_loop_timer))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			static bool trip = false;
 			static Time_t start_time;
 
@@ -227,11 +279,46 @@ int main(void)
 
 				trip = false;
 			}
+
+			Profiler_Record(PROF_LOOP_TIMER, prof_start);
+		}
+
+#ifdef CONFIG_IDLE
+		// Process duty-cycle statistics command
+		if(MSG_FLAG_Execute(&mf_duty_cycle))
+		{
+			uint16_t prof_start = Profiler_Start();
+
+			Idle_Stats_t stats = Idle_Get_Stats();
+			struct __attribute__((__packed__)) { uint8_t action; float utilization; float window; float idle; uint16_t sleeps; } data =
+			{
+					.action = 0x03,
+					.utilization = stats.utilization,
+					.window = stats.window,
+					.idle = stats.idle,
+					.sleeps = stats.sleeps
+			};
+
+			if(mf_duty_cycle.duration < 0)
+			{
+				mf_duty_cycle.active = false;
+				usb_send_msg("cBfffH", 't', &data, sizeof(data));
+			}
+			else
+			{
+				mf_duty_cycle.last_trigger_time = GetTime();
+				usb_send_msg("cBfffH", 'T', &data, sizeof(data));
+			}
+
+			Profiler_Record(PROF_DUTY_CYCLE, prof_start);
 		}
+#endif
 
 		// Process encoder count command
 		if(MSG_FLAG_Execute(&mf_send_encoder))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			struct __attribute__((__packed__)) { float left_enc; float right_enc; } ret_val;
 			ret_val.left_enc = Counts_Left();
 			ret_val.right_enc = Counts_Right();
@@ -246,11 +333,15 @@ int main(void)
 				mf_send_encoder.last_trigger_time = GetTime();
 				usb_send_msg("cff", 'E', &ret_val, sizeof(ret_val));
 			}
+
+			Profiler_Record(PROF_SEND_ENCODER, prof_start);
 		}
 
 		// Process battery monitor command
 		if(MSG_FLAG_Execute(&mf_send_battery))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			float ret_val = Battery_Voltage();
 
 			if(mf_send_battery.duration <= 0)
@@ -263,11 +354,15 @@ int main(void)
 				mf_send_battery.last_trigger_time = GetTime();
 				usb_send_msg("cf", 'B', &ret_val, sizeof(ret_val));
 			}
+
+			Profiler_Record(PROF_SEND_BATTERY, prof_start);
 		}
 
 		// Process battery low
 		if(MSG_FLAG_Execute(&mf_low_battery))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			struct {char let[7]; float volts; } data =
 			{
 					.let = {'B', 'A', 'T', ' ', 'L', 'O', 'W'},
@@ -277,11 +372,15 @@ int main(void)
 			usb_send_msg("ccccccccf", '!', &data, sizeof(data));
 
 			mf_low_battery.last_trigger_time = GetTime();
+
+			Profiler_Record(PROF_LOW_BATTERY, prof_start);
 		}
 
 		// Timed PWM flag
 		if(MSG_FLAG_Execute(&mf_timed_pwm))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Stop PWM
 			Motor_PWM_Left(0);
 			Motor_PWM_Right(0);
@@ -291,11 +390,15 @@ int main(void)
 
 			// Reset flag
 			mf_timed_pwm.active = false;
+
+			Profiler_Record(PROF_TIMED_PWM, prof_start);
 		}
 
 		// Handle system stats flag
 		if(MSG_FLAG_Execute(&mf_sys_data))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Create struct for data to return
 			struct {float time; int16_t PWM_L; int16_t PWM_R; int16_t Encoder_L; int16_t Encoder_R; } data;
 			// Get current time
@@ -318,11 +421,15 @@ int main(void)
 				mf_sys_data.last_trigger_time = GetTime();
 				usb_send_msg( "cfhhhh", 'Q', &data, sizeof(data) );
 			}
+
+			Profiler_Record(PROF_SYS_DATA, prof_start);
 		}
 
 		// Handle Motor Controls Flag
 		if(MSG_FLAG_Execute(&mf_motor_dist_control))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			if(first_time)
 			{
 				ticksL_old = Counts_Left();
@@ -336,15 +443,12 @@ int main(void)
 				float measured_left = ECount_to_Distance(ticksL_new - ticksL_old);
 				float measured_right = ECount_to_Distance(ticksR_new - ticksR_old);
 
+				// Step the motion profiles, encoders were zeroed when the move started
+				float speedL = Motion_Profile_Step(&mp_LeftMotor, (int32_t)ticksL_new);
+				float speedR = Motion_Profile_Step(&mp_RightMotor, (int32_t)ticksR_new);
+
 				// Determine if we are done moving
-				bool doneL = (ctr_LeftMotor.target_pos > 0) ?
-						(measured_left >= ctr_LeftMotor.target_pos)
-						: (measured_left <= ctr_LeftMotor.target_pos);
-				bool doneR = (ctr_RightMotor.target_pos > 0) ?
-						(measured_right >= ctr_RightMotor.target_pos)
-						: (measured_right <= ctr_RightMotor.target_pos);
-
-				if(doneL || doneR)
+				if(Motion_Profile_Done(&mp_LeftMotor) && Motion_Profile_Done(&mp_RightMotor))
 				{
 					Motor_PWM_Left(0);
 					Motor_PWM_Right(0);
@@ -357,7 +461,9 @@ int main(void)
 					Controller_Set_Target_Velocity(&ctr_LeftMotor, 0.0);
 					Controller_Set_Target_Velocity(&ctr_RightMotor, 0.0);
 
+					// Arrived, the stall timeout isn't needed
 					mf_motor_dist_control.active = false;
+					mf_motor_stop.active = false;
 					first_time = true;
 				}
 				else
@@ -373,13 +479,19 @@ int main(void)
 					Controller_Set_Target_Position(&ctr_RightMotor,
 							(ctr_RightMotor.target_pos - measured_right));
 
+					// Follow the profiled speeds
+					Controller_Set_Target_Velocity(&ctr_LeftMotor, speedL);
+					Controller_Set_Target_Velocity(&ctr_RightMotor, speedR);
+
 					if(CNTRL_SYS) {
 						/// Update controller
 						// Correct to keep measurement positive in controller
 						float mL = (measured_left < 0) ? (-1*measured_left) : measured_left;
 						float mR = (measured_right < 0) ? (-1*measured_right) : measured_right;
+						uint16_t ctr_start = Profiler_Start();
 						float new_speedL = Controller_Update(&ctr_LeftMotor, mL, dt);
 						float new_speedR = Controller_Update(&ctr_RightMotor, mR, dt);
+						Profiler_Record(PROF_CONTROLLER, ctr_start);
 						// Determine new PWM with sign for direction
 						pwmL = Velocity_to_DutyCycle_Left(new_speedL);
 						pwmR =  Velocity_to_DutyCycle_Right(new_speedR);
@@ -390,8 +502,9 @@ int main(void)
 						pwmR =  Velocity_to_DutyCycle_Right(ctr_RightMotor.target_vel);
 					}
 
-					pwmL = (ctr_LeftMotor.target_pos > 0) ? pwmL : -1 * pwmL;
-					pwmR = (ctr_RightMotor.target_pos > 0) ? pwmR : -1 * pwmR;
+					// A wheel that has arrived holds still while the other finishes
+					pwmL = (speedL > 0 && pwmL > 0) ? pwmL * mp_LeftMotor.direction : 0;
+					pwmR = (speedR > 0 && pwmR > 0) ? pwmR * mp_RightMotor.direction : 0;
 
 					// Set PWM
 					Motor_PWM_Left(pwmL);
@@ -420,11 +533,15 @@ int main(void)
 					mf_motor_dist_control.last_trigger_time = GetTime();
 				}
 			}
+
+			Profiler_Record(PROF_DIST_CONTROL, prof_start);
 		}
 
 		// Handle Motor Controls Flag
 		if(MSG_FLAG_Execute(&mf_motor_vel_control))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			if(first_time)
 			{
 				ticksL_old = Counts_Left();
@@ -453,8 +570,10 @@ int main(void)
 						ctr_RightMotor.target_vel = -1*ctr_RightMotor.target_vel;
 						ctr_LeftMotor.target_vel = -1*ctr_LeftMotor.target_vel;
 						// Update controller
+						uint16_t ctr_start = Profiler_Start();
 						float new_speedL = Controller_Update(&ctr_LeftMotor, mL, (time_new - time_old));
 						float new_speedR = Controller_Update(&ctr_RightMotor, mR, (time_new - time_old));
+						Profiler_Record(PROF_CONTROLLER, ctr_start);
 						// Determine new PWM with sign for direction
 						pwmL = -1 * Velocity_to_DutyCycle_Left(new_speedL);
 						pwmR = -1 * Velocity_to_DutyCycle_Right(new_speedR);
@@ -476,8 +595,10 @@ int main(void)
 						float mL = (measured_left < 0) ? (-1*measured_left) : measured_left;
 						float mR = (measured_right < 0) ? (-1*measured_right) : measured_right;
 						// Update controller
+						uint16_t ctr_start = Profiler_Start();
 						float new_speedL = Controller_Update(&ctr_LeftMotor, mL, (time_new - time_old));
 						float new_speedR = Controller_Update(&ctr_RightMotor, mR, (time_new - time_old));
+						Profiler_Record(PROF_CONTROLLER, ctr_start);
 						// Determine new PWM with sign for direction
 						pwmL = Velocity_to_DutyCycle_Left(new_speedL);
 						pwmR = Velocity_to_DutyCycle_Right(new_speedR);
@@ -513,11 +634,15 @@ int main(void)
 				time_old = time_new;
 				mf_motor_vel_control.last_trigger_time = GetTime();
 			}
+
+			Profiler_Record(PROF_VEL_CONTROL, prof_start);
 		}
 
 		// Handle Motor Stop Flag
 		if(MSG_FLAG_Execute(&mf_motor_stop))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			// Shut-off PWM
 			Motor_PWM_Left(0);
 			Motor_PWM_Right(0);
@@ -534,21 +659,31 @@ int main(void)
 			// Reset flag
 			mf_motor_stop.active = false;
 			mf_motor_dist_control.active = false;
+			first_time = true;
 			mf_motor_vel_control.active = false;
 			mf_timed_pwm.active = false;
+
+			Profiler_Record(PROF_MOTOR_STOP, prof_start);
 		}
 
+#ifdef CONFIG_IR
 		// Handle IR proximity flag
 		if(MSG_FLAG_Execute(&mf_ir_proximity))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			if(proxy_first) {
 				// Run just one side of the sensor
+				uint16_t ir_start = Profiler_Start();
 				IRRead(LEFT);
+				Profiler_Record(PROF_IR_READ, ir_start);
 				proxy_first = false;
 			}
 			else {
 				// Run right side of distance sensor
+				uint16_t ir_start = Profiler_Start();
 				IRRead(RIGHT);
+				Profiler_Record(PROF_IR_READ, ir_start);
 				// Read distance data and return
 				t_ProximityReturn prox_out = IR_Counts();
 				// Record return values
@@ -571,15 +706,135 @@ int main(void)
 				}
 				proxy_first = true;
 			}
+
+			Profiler_Record(PROF_IR_PROXIMITY, prof_start);
 		}
+#endif
 
+#ifdef CONFIG_OA
 		// Handle Object Avoidance flag
 		if(MSG_FLAG_Execute(&mf_obj_avoidance))
 		{
+			uint16_t prof_start = Profiler_Start();
+
 			if(!Run_OA_Task()) {
 				// Reset timer
 				mf_obj_avoidance.last_trigger_time = GetTime();
 			}
+
+			Profiler_Record(PROF_OBJ_AVOIDANCE, prof_start);
+		}
+#endif
+
+#ifdef CONFIG_TRAJECTORY
+		// Handle trajectory queue flag
+		if(MSG_FLAG_Execute(&mf_trajectory))
+		{
+			uint16_t prof_start = Profiler_Start();
+
+			if(Trajectory_Task()) {
+				// Reset timer
+				mf_trajectory.last_trigger_time = GetTime();
+			}
+			else {
+				// Queue finished
+				mf_trajectory.active = false;
+			}
+
+			Profiler_Record(PROF_TRAJECTORY, prof_start);
+		}
+#endif
+
+#ifdef CONFIG_SERVO
+		// Handle gripper servo ramp
+		if(MSG_FLAG_Execute(&mf_servo))
+		{
+			uint16_t prof_start = Profiler_Start();
+
+			if(Gripper_Task()) {
+				// Reset timer
+				mf_servo.last_trigger_time = GetTime();
+			}
+			else {
+				mf_servo.active = false;
+			}
+
+			Profiler_Record(PROF_SERVO, prof_start);
+		}
+#endif
+
+#ifdef CONFIG_TRACE
+		// Copy the flight recorder to EEPROM
+		if(MSG_FLAG_Execute(&mf_trace_snapshot))
+		{
+			if(!Trace_Snapshot_Task()) {
+				mf_trace_snapshot.active = false;
+			}
+		}
+#endif
+
+#ifdef CONFIG_PROFILER
+		// Send profiler histograms
+		if(MSG_FLAG_Execute(&mf_profiler_dump))
+		{
+			if(!Profiler_Dump_Task()) {
+				mf_profiler_dump.active = false;
+			}
+		}
+#endif
+
+#ifdef CONFIG_TELEMETRY
+		// Send the subscribed telemetry channels
+		if(MSG_FLAG_Execute(&mf_telemetry))
+		{
+			uint16_t prof_start = Profiler_Start();
+
+			mf_telemetry.last_trigger_time = GetTime();
+			if(!Telemetry_Task()) {
+				mf_telemetry.active = false;
+			}
+
+			Profiler_Record(PROF_TELEMETRY, prof_start);
+		}
+#endif
+
+#ifdef CONFIG_LINK_BENCH
+		// Stream USB link benchmark packets
+		if(MSG_FLAG_Execute(&mf_link_bench))
+		{
+			if(!Link_Bench_Task()) {
+				mf_link_bench.active = false;
+			}
+		}
+#endif
+
+#ifdef CONFIG_PARAMS
+		// Save the runtime parameters to EEPROM
+		if(MSG_FLAG_Execute(&mf_params_save))
+		{
+			if(!Params_Save_Task()) {
+				mf_params_save.active = false;
+			}
+		}
+
+		// Send the runtime parameters
+		if(MSG_FLAG_Execute(&mf_params_dump))
+		{
+			if(!Params_Dump_Task()) {
+				mf_params_dump.active = false;
+			}
+		}
+#endif
+
+		Profiler_Record(PROF_LOOP, loop_start);
+
+		// Nothing was due and no USB traffic is waiting, sleep until the next
+		// interrupt. Timer 0 wakes the loop every millisecond, the resolution
+		// flags are scheduled at. The USB buffers move one byte per pass, so
+		// stay awake until they drain.
+		if(!MSG_FLAG_Any_Executed() && usb_msg_length() == 0 && usb_out_msg_length() == 0)
+		{
+			Idle_Sleep();
 		}
 
 
@@ -22,6 +22,8 @@
 */
 
 #include "Obstacle_Avoidance.h"
+#include "Params.h"
+#include "Profiler.h"
 
 static eOAReadState read_state;
 static eOADSM OA_state;
@@ -42,11 +44,13 @@ void Init_Obstacle_Avoidance() {
 bool Run_OA_Task() {
 	// Don't do too much in one loop iteration
 	bool run_again = false;
+	uint16_t prof_start = Profiler_Start();
 	// Run OA task state machine
 	switch(read_state) {
 	case READ_L:
 		// Run read left command
 		IRRead(LEFT);
+		Profiler_Record(PROF_IR_READ, prof_start);
 		// Run task again and update state
 		run_again = true;
 		read_state = READ_R;
@@ -55,6 +59,7 @@ bool Run_OA_Task() {
 	case READ_R:
 		// Run read right command
 		IRRead(RIGHT);
+		Profiler_Record(PROF_IR_READ, prof_start);
 		// Run task again and update state
 		run_again = true;
 		read_state = RUN_DSM;
@@ -83,6 +88,8 @@ bool Run_OA_Task() {
  * current IR reading.
  */
 void Run_State_Machine(t_ProximityReturn ir_Return) {
+	eOADSM last_state = OA_state;
+
 	switch(OA_state) {
 	case INIT:
 	{
@@ -91,22 +98,22 @@ void Run_State_Machine(t_ProximityReturn ir_Return) {
 		// Initialize the movement based on IR reading
 		if(ir_Return.m_nCount == 0) {
 			// Drive straight
-			velocity_left = DutyCycle_to_Velocity_Left(OA_DRIVE_DC);
-			velocity_right = DutyCycle_to_Velocity_Right(OA_DRIVE_DC);
+			velocity_left = DutyCycle_to_Velocity_Left(params.oa_drive_duty);
+			velocity_right = DutyCycle_to_Velocity_Right(params.oa_drive_duty);
 			// Update state
 			OA_state = DRIVE_STRAIGHT;
 		}
 		else if(ir_Return.m_eSide == RIGHT) {
 			// Turn left
-			velocity_left = OA_TURN_VELOCITY;
-			velocity_right = OA_TURN_VELOCITY + WHEEL_BASE * OA_ANGLR_VELOCITY;
+			velocity_left = params.oa_turn_velocity;
+			velocity_right = params.oa_turn_velocity + params.wheel_base * params.oa_angular_velocity;
 			// Update state
 			OA_state = TURN_LEFT;
 		}
 		else {
 			// Turn right
-			velocity_left = OA_TURN_VELOCITY + WHEEL_BASE * OA_ANGLR_VELOCITY;
-			velocity_right = OA_TURN_VELOCITY;
+			velocity_left = params.oa_turn_velocity + params.wheel_base * params.oa_angular_velocity;
+			velocity_right = params.oa_turn_velocity;
 			// Update state
 			OA_state = TURN_RIGHT;
 		}
@@ -133,15 +140,15 @@ void Run_State_Machine(t_ProximityReturn ir_Return) {
 
 			if(ir_Return.m_eSide == RIGHT) {
 				// Turn left
-				velocity_left = OA_TURN_VELOCITY;
-				velocity_right = OA_TURN_VELOCITY + WHEEL_BASE * OA_ANGLR_VELOCITY;
+				velocity_left = params.oa_turn_velocity;
+				velocity_right = params.oa_turn_velocity + params.wheel_base * params.oa_angular_velocity;
 				// Update state
 				OA_state = TURN_LEFT;
 			}
 			else {
 				// Turn right
-				velocity_left = OA_TURN_VELOCITY + WHEEL_BASE * OA_ANGLR_VELOCITY;
-				velocity_right = OA_TURN_VELOCITY;
+				velocity_left = params.oa_turn_velocity + params.wheel_base * params.oa_angular_velocity;
+				velocity_right = params.oa_turn_velocity;
 				// Update state
 				OA_state = TURN_RIGHT;
 			}
@@ -186,12 +193,12 @@ void Run_State_Machine(t_ProximityReturn ir_Return) {
 	case HOLDING:
 		alpha++;
 		// Stop turning?
-		if(alpha >= OA_HOLD_TIMEOUT) {
+		if(alpha >= params.oa_hold_timeout) {
 			// Reset alpha
 			alpha = 0;
 			// Drive straight, Assign target velocity
-			Controller_Set_Target_Velocity(&ctr_LeftMotor, DutyCycle_to_Velocity_Left(OA_DRIVE_DC));
-			Controller_Set_Target_Velocity(&ctr_RightMotor, DutyCycle_to_Velocity_Right(OA_DRIVE_DC));
+			Controller_Set_Target_Velocity(&ctr_LeftMotor, DutyCycle_to_Velocity_Left(params.oa_drive_duty));
+			Controller_Set_Target_Velocity(&ctr_RightMotor, DutyCycle_to_Velocity_Right(params.oa_drive_duty));
 			// Move to drive straight state
 			OA_state = DRIVE_STRAIGHT;
 		}
@@ -202,4 +209,8 @@ void Run_State_Machine(t_ProximityReturn ir_Return) {
 
 		break;
 	}
+
+	if(OA_state != last_state) {
+		Trace_Write(TRACE_OA_STATE, OA_state);
+	}
 }
@@ -34,10 +34,20 @@
 #include "../Driver/include_driver.h"
 #include "application_defines.h"
 
+// Tuning constants, the defaults of the runtime parameters (Params.h). Guarded so
+// host builds (see Host/Makefile) can override them.
+#ifndef OA_TURN_VELOCITY
 #define OA_TURN_VELOCITY	0.07
+#endif
+#ifndef OA_ANGLR_VELOCITY
 #define OA_ANGLR_VELOCITY	1.5
+#endif
+#ifndef OA_DRIVE_DC
 #define OA_DRIVE_DC			30
+#endif
+#ifndef OA_HOLD_TIMEOUT
 #define OA_HOLD_TIMEOUT		4
+#endif
 
 typedef enum
 {
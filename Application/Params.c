@@ -0,0 +1,305 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include <math.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include "Params.h"
+
+typedef struct __attribute__((__packed__)) {
+	uint16_t magic;
+	uint16_t layout;
+	uint16_t crc;
+} t_ParamsHeader;
+
+// The table lives at the start of the EEPROM, the trace snapshot at the end
+#define PARAMS_EEPROM_HEADER	((uint8_t*)0)
+#define PARAMS_EEPROM_TABLE		((uint8_t*)sizeof(t_ParamsHeader))
+
+#define IS_MEMBER(offset, member)	((offset) >= offsetof(t_Params, member) \
+		&& (offset) < offsetof(t_Params, member) + sizeof(params.member))
+
+// Filled by Params_Init, the defaults are in flash
+t_Params params;
+
+// Save progress, in bytes
+static bool saving;
+static uint8_t save_index;
+static uint16_t save_crc;
+
+// Dump progress, in ids
+static uint8_t dump_next;
+static uint8_t dump_end;
+
+/*
+ * Bytes a parameter takes, from its struct code
+ */
+static uint8_t Param_Size(char code) {
+	return (code == 'f' || code == 'i' || code == 'I') ? 4 : (code == 'h' || code == 'H') ? 2 : 1;
+}
+
+static uint16_t Table_CRC() {
+	uint16_t crc = 0xFFFF;
+	for(uint8_t i = 0; i < sizeof(t_Params); i++) {
+		crc = _crc16_update(crc, ((uint8_t*)&params)[i]);
+	}
+	return crc;
+}
+
+/*
+ * Re-initialises a wheel controller with new coefficients, keeping its targets
+ */
+static void Apply_Controller(Controller_t* p_cont, float kp, const float* num, const float* den) {
+	float target_pos = p_cont->target_pos;
+	float target_vel = p_cont->target_vel;
+	Controller_Init(p_cont, kp, num, den, CONTROLLER_ORDER, CONTROLLER_PERIOD_MS);
+	p_cont->target_pos = target_pos;
+	p_cont->target_vel = target_vel;
+}
+
+/*
+ * Pushes the table to the drivers that keep their own copy. A save that is
+ * running starts over so it never writes a mix of old and new values.
+ */
+static void Apply(bool left, bool right) {
+	Set_Distance_Per_Count(params.distance_per_count);
+	if(left) {
+		Apply_Controller(&ctr_LeftMotor, params.kp_left, params.num_left, params.den_left);
+	}
+	if(right) {
+		Apply_Controller(&ctr_RightMotor, params.kp_right, params.num_right, params.den_right);
+	}
+	if(saving) {
+		Params_Save_Start();
+	}
+}
+
+/*
+ * Returns the index of a controller coefficient within its num_ or den_ array, -1 for any other parameter
+ */
+static int8_t Coefficient_Index(uint8_t offset) {
+	static const uint8_t arrays[] = { offsetof(t_Params, num_left), offsetof(t_Params, den_left),
+			offsetof(t_Params, num_right), offsetof(t_Params, den_right) };
+	for(uint8_t i = 0; i < sizeof(arrays); i++) {
+		if(offset >= arrays[i] && offset < arrays[i] + sizeof(params.num_left)) {
+			return (offset - arrays[i]) / sizeof(float);
+		}
+	}
+	return -1;
+}
+
+/*
+ * Is value (4 bytes as sent in 'K') acceptable for the parameter
+ */
+static bool Check(t_Param_Info info, uint32_t value) {
+	if(info.code == 0) {
+		return false;
+	}
+	if(info.code == 'f') {
+		float f;
+		memcpy(&f, &value, sizeof(f));
+		if(!isfinite(f)) {
+			return false;
+		}
+		if(info.offset == offsetof(t_Params, wheel_base) || info.offset == offsetof(t_Params, distance_per_count)) {
+			return f > 0;
+		}
+		// a0 divides every filter output
+		if(info.offset == offsetof(t_Params, den_left) || info.offset == offsetof(t_Params, den_right)) {
+			return f != 0;
+		}
+		// Controller_Init runs CONTROLLER_ORDER, a coefficient past it would be dropped
+		if(Coefficient_Index(info.offset) > CONTROLLER_ORDER) {
+			return f == 0;
+		}
+	}
+	return true;
+}
+
+/**
+ * Function Params_Init loads the table from EEPROM, or the defaults if there is no valid copy, and applies it
+ */
+void Params_Init() {
+	if(!Params_Load()) {
+		Params_Defaults();
+	}
+}
+
+/**
+ * Function Params_Set checks the entries of a 'K' message and applies them only if every one is good. Returns the
+ * first rejected id, or PARAMS_NO_ID if they were applied.
+ */
+uint8_t Params_Set(const t_Msg_ParamSet* p_set) {
+	for(uint8_t i = 0; i < p_set->count; i++) {
+		if(!Check(MEGN540_Param_Info(p_set->id[i]), p_set->value[i])) {
+			return p_set->id[i];
+		}
+	}
+
+	bool left = false;
+	bool right = false;
+	for(uint8_t i = 0; i < p_set->count; i++) {
+		t_Param_Info info = MEGN540_Param_Info(p_set->id[i]);
+		uint32_t value = p_set->value[i];
+		memcpy((uint8_t*)&params + info.offset, &value, Param_Size(info.code));
+
+		left |= IS_MEMBER(info.offset, kp_left) || IS_MEMBER(info.offset, num_left) || IS_MEMBER(info.offset, den_left);
+		right |= IS_MEMBER(info.offset, kp_right) || IS_MEMBER(info.offset, num_right)
+				|| IS_MEMBER(info.offset, den_right);
+	}
+	Apply(left, right);
+
+	return PARAMS_NO_ID;
+}
+
+/**
+ * Function Params_Load reloads the table from EEPROM. Returns false, and keeps the table, if there is no valid copy.
+ */
+bool Params_Load() {
+	t_ParamsHeader header;
+	eeprom_read_block(&header, PARAMS_EEPROM_HEADER, sizeof(header));
+	if(header.magic != PARAMS_MAGIC || header.layout != PARAMS_LAYOUT) {
+		return false;
+	}
+
+	// Check the copy before it replaces the table
+	uint16_t crc = 0xFFFF;
+	for(uint8_t i = 0; i < sizeof(t_Params); i++) {
+		crc = _crc16_update(crc, eeprom_read_byte(PARAMS_EEPROM_TABLE + i));
+	}
+	if(crc != header.crc) {
+		return false;
+	}
+
+	eeprom_read_block(&params, PARAMS_EEPROM_TABLE, sizeof(params));
+	Apply(true, true);
+	return true;
+}
+
+/**
+ * Function Params_Defaults puts the table back to the compiled-in defaults
+ */
+void Params_Defaults() {
+	static const t_Params defaults PROGMEM = PARAMS_DEFAULTS;
+	for(uint8_t i = 0; i < sizeof(t_Params); i++) {
+		((uint8_t*)&params)[i] = pgm_read_byte((const uint8_t*)&defaults + i);
+	}
+	Apply(true, true);
+}
+
+/**
+ * Function Params_Save_Start starts copying the table to EEPROM
+ */
+void Params_Save_Start() {
+	saving = true;
+	save_index = 0;
+	save_crc = Table_CRC();
+}
+
+/**
+ * Function Params_Save_Task writes the next byte of the save once the EEPROM is ready and replies 'n' when it is
+ * done. Returns true while the save is in progress.
+ */
+bool Params_Save_Task() {
+	if(!saving) {
+		return false;
+	}
+
+	if(!eeprom_is_ready()) {
+		return true;
+	}
+
+	if(save_index < sizeof(t_Params)) {
+		eeprom_update_byte(PARAMS_EEPROM_TABLE + save_index, ((uint8_t*)&params)[save_index]);
+		save_index++;
+		return true;
+	}
+
+	// Header last, a torn save fails its CRC at the next load
+	t_ParamsHeader header =
+	{
+			.magic = PARAMS_MAGIC,
+			.layout = PARAMS_LAYOUT,
+			.crc = save_crc
+	};
+	eeprom_update_block(&header, PARAMS_EEPROM_HEADER, sizeof(header));
+	saving = false;
+
+	struct __attribute__((__packed__)) { char action; uint8_t ok; } reply = { 0x00, 1 };
+	usb_send_msg("ccB", 'n', &reply, sizeof(reply));
+	return false;
+}
+
+/**
+ * Function Params_Dump_Start begins sending count parameters from id first (count 0 to the end). Returns false if
+ * first is not a parameter.
+ */
+bool Params_Dump_Start(uint8_t first, uint8_t count) {
+	if(first >= PARAMS_COUNT) {
+		return false;
+	}
+
+	dump_next = first;
+	dump_end = (count == 0 || count > PARAMS_COUNT - first) ? PARAMS_COUNT : first + count;
+	return true;
+}
+
+/**
+ * Function Params_Dump_Task sends the next chunk once the USB send buffer has drained. Returns true while there
+ * are more to send.
+ */
+bool Params_Dump_Task() {
+	if(dump_next >= dump_end) {
+		return false;
+	}
+
+	// One chunk at a time fits in the send buffer
+	if(usb_out_msg_length() != 0) {
+		return true;
+	}
+
+	char format[3 + 2 * PARAMS_CHUNK + 1] = "cH";
+	uint8_t data[2 + 5 * PARAMS_CHUNK];
+	uint8_t format_len = 2;
+	uint8_t data_len = 0;
+
+	uint16_t layout = PARAMS_LAYOUT;
+	memcpy(data, &layout, sizeof(layout));
+	data_len += sizeof(layout);
+
+	for(uint8_t n = 0; n < PARAMS_CHUNK && dump_next < dump_end; n++, dump_next++) {
+		t_Param_Info info = MEGN540_Param_Info(dump_next);
+		format[format_len++] = 'B';
+		format[format_len++] = info.code;
+		data[data_len++] = dump_next;
+		memcpy(&data[data_len], (uint8_t*)&params + info.offset, Param_Size(info.code));
+		data_len += Param_Size(info.code);
+	}
+	format[format_len] = '\0';
+
+	usb_send_msg(format, 'k', data, data_len);
+
+	return dump_next < dump_end;
+}
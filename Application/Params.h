@@ -0,0 +1,137 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Params.h/c is the robot's runtime parameter table: the geometry, motion
+ * limits, obstacle avoidance tuning and wheel controllers that used to be
+ * compile-time constants. The table, its ids and types are generated from
+ * the param entries in protocol.def (t_Params in MEGN540_Protocol.h); the
+ * constants stay as the defaults.
+ *
+ * At boot the table is loaded from the start of the EEPROM if the copy
+ * there is valid: its header has PARAMS_MAGIC, the PARAMS_LAYOUT of this
+ * build and a CRC16 of the table that matches. Anything else (a blank
+ * EEPROM, a build with other parameters, a torn write) boots with the
+ * defaults.
+ *
+ * Commands:
+ *      'k' {uint8 first, uint8 count}  read count parameters from id first
+ *          (count 0 reads to the end). Replies 'k' with up to PARAMS_CHUNK
+ *          entries per message, format "cH" + ("B" + type) per entry:
+ *              'k', PARAMS_LAYOUT, then id and value for each entry
+ *      'K' {uint8 count, uint8 id[6], uint32 value[6]}  sets count
+ *          parameters. Each value is 4 bytes holding the parameter in its
+ *          own type, little endian, zero padded. All of them are checked
+ *          first (known id, finite float, positive wheel base and distance
+ *          per count, non-zero a0) and either all or none are applied.
+ *          Replies 'K' "cBB": number applied, first rejected id or 0xFF
+ *      'n' {char action}  0x00 save to EEPROM, 0x01 load from EEPROM,
+ *          0x02 back to the defaults. Replies 'n' "ccB": action, 1 if it
+ *          worked. The save reply comes once the last byte is written.
+ *
+ * Saves go a byte per main loop pass like the trace snapshot, so the loop
+ * doesn't stall on the EEPROM; a 'K' during a save starts it over. Set
+ * controller coefficients while the robot is stopped: the wheel's
+ * controller is re-initialised, which clears its history. Changes apply
+ * from the next use, a move already planned keeps its profile.
+ *
+ * Built with CONFIG_PARAMS=n the table is a constant holding the defaults
+ * and the commands answer '?'.
+ */
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../Driver/include_driver.h"
+#include "application_defines.h"
+#include "Controller_Coeffs.h"
+#include "MEGN540_Protocol.h"
+#include "Obstacle_Avoidance.h"
+
+#define PARAMS_MAGIC	0x9A7A
+#define PARAMS_CHUNK	6		// entries per 'k' reply and per 'K'
+#define PARAMS_NO_ID	0xFF
+
+_Static_assert(CONTROLLER_ORDER <= 2, "the controller parameters hold 3 coefficients");
+_Static_assert(sizeof(((t_Msg_ParamSet*)0)->id) == PARAMS_CHUNK, "'K' carries PARAMS_CHUNK entries");
+
+#ifdef CONFIG_PARAMS
+
+extern t_Params params;
+
+/**
+ * Function Params_Init loads the table from EEPROM, or the defaults if there is no valid copy, and applies it
+ */
+void Params_Init();
+
+/**
+ * Function Params_Set checks the entries of a 'K' message and applies them only if every one is good. Returns the
+ * first rejected id, or PARAMS_NO_ID if they were applied. count must be at most PARAMS_CHUNK.
+ */
+uint8_t Params_Set(const t_Msg_ParamSet* p_set);
+
+/**
+ * Function Params_Load reloads the table from EEPROM. Returns false, and keeps the table, if there is no valid copy.
+ */
+bool Params_Load();
+
+/**
+ * Function Params_Defaults puts the table back to the compiled-in defaults
+ */
+void Params_Defaults();
+
+/**
+ * Function Params_Save_Start starts copying the table to EEPROM
+ */
+void Params_Save_Start();
+
+/**
+ * Function Params_Save_Task writes the next byte of the save once the EEPROM is ready and replies 'n' when it is
+ * done. Returns true while the save is in progress.
+ */
+bool Params_Save_Task();
+
+/**
+ * Function Params_Dump_Start begins sending count parameters from id first (count 0 to the end). Returns false if
+ * first is not a parameter.
+ */
+bool Params_Dump_Start(uint8_t first, uint8_t count);
+
+/**
+ * Function Params_Dump_Task sends the next chunk once the USB send buffer has drained. Returns true while there
+ * are more to send.
+ */
+bool Params_Dump_Task();
+
+#else
+
+// Built without the parameter store (CONFIG_PARAMS=n), the table is the defaults
+static const t_Params params = PARAMS_DEFAULTS;
+
+static inline void Params_Init() {}
+
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Profiler.h"
+
+typedef struct {
+	uint8_t buckets[PROF_BUCKETS];
+	uint16_t samples;
+	uint16_t min;
+	uint16_t max;
+} t_ProfHistogram;
+
+static t_ProfHistogram histograms[PROF_NUM_TASKS];
+
+// Dump progress
+static uint8_t dump_next;
+static bool dump_reset;
+
+/*
+ * Clears one histogram
+ */
+static void Clear_Histogram(t_ProfHistogram* p_hist) {
+	for(uint8_t i = 0; i < PROF_BUCKETS; i++) {
+		p_hist->buckets[i] = 0;
+	}
+	p_hist->samples = 0;
+	p_hist->min = UINT16_MAX;
+	p_hist->max = 0;
+}
+
+/*
+ * Converts Timer 0 ticks to milliseconds
+ */
+static float Ticks_To_ms(uint32_t ticks) {
+	return ticks * 0.004;
+}
+
+/**
+ * Function Profiler_Init clears all histograms
+ */
+void Profiler_Init() {
+	for(uint8_t i = 0; i < PROF_NUM_TASKS; i++) {
+		Clear_Histogram(&histograms[i]);
+	}
+	dump_next = PROF_NUM_TASKS;
+}
+
+/**
+ * Function Profiler_Record adds the time since start to the task's histogram
+ */
+void Profiler_Record(eProfTask task, uint16_t start) {
+	uint16_t ticks = GetTicks() - start;
+	t_ProfHistogram* p_hist = &histograms[task];
+
+	// log2 bucket
+	uint8_t bucket = 0;
+	for(uint16_t t = ticks >> 1; t != 0 && bucket < PROF_BUCKETS - 1; t >>= 1) {
+		bucket++;
+	}
+
+	// Halve the task's buckets rather than let one wrap
+	if(p_hist->buckets[bucket] == UINT8_MAX) {
+		for(uint8_t i = 0; i < PROF_BUCKETS; i++) {
+			p_hist->buckets[i] >>= 1;
+		}
+	}
+	p_hist->buckets[bucket]++;
+
+	if(p_hist->samples < UINT16_MAX) {
+		p_hist->samples++;
+	}
+	if(ticks < p_hist->min) {
+		p_hist->min = ticks;
+	}
+	if(ticks > p_hist->max) {
+		p_hist->max = ticks;
+	}
+}
+
+/**
+ * Function Profiler_Dump_Start begins sending the histograms. If reset is set they are cleared once sent.
+ */
+void Profiler_Dump_Start(bool reset) {
+	dump_next = 0;
+	dump_reset = reset;
+}
+
+/**
+ * Function Profiler_Dump_Task sends the next task's histogram once the USB send buffer has drained. Returns
+ * true while there are more to send.
+ */
+bool Profiler_Dump_Task() {
+	if(dump_next >= PROF_NUM_TASKS) {
+		return false;
+	}
+
+	// One histogram at a time fits in the send buffer
+	if(usb_out_msg_length() != 0) {
+		return true;
+	}
+
+	t_ProfHistogram* p_hist = &histograms[dump_next];
+
+	// Bucket holding the 99th percentile
+	uint16_t total = 0;
+	for(uint8_t i = 0; i < PROF_BUCKETS; i++) {
+		total += p_hist->buckets[i];
+	}
+	uint16_t above = 0;
+	uint8_t p99 = PROF_BUCKETS - 1;
+	while(p99 > 0 && (uint32_t)(above + p_hist->buckets[p99]) * 100 <= total) {
+		above += p_hist->buckets[p99];
+		p99--;
+	}
+	// The last bucket has no upper edge, use the max
+	uint32_t p99_ticks = (p99 == PROF_BUCKETS - 1) ? p_hist->max : (2UL << p99);
+
+	struct __attribute__((__packed__)) {
+		uint8_t task;
+		uint16_t samples;
+		float min;
+		float max;
+		float p99;
+		uint8_t buckets[PROF_BUCKETS];
+	} data;
+
+	data.task = dump_next;
+	data.samples = p_hist->samples;
+	data.min = (p_hist->samples > 0) ? Ticks_To_ms(p_hist->min) : 0;
+	data.max = Ticks_To_ms(p_hist->max);
+	data.p99 = (p_hist->samples > 0) ? Ticks_To_ms(p99_ticks) : 0;
+	for(uint8_t i = 0; i < PROF_BUCKETS; i++) {
+		data.buckets[i] = p_hist->buckets[i];
+	}
+
+	usb_send_msg("cBHfffBBBBBBBBBBBB", 'h', &data, sizeof(data));
+
+	if(dump_reset) {
+		Clear_Histogram(p_hist);
+	}
+	dump_next++;
+
+	return dump_next < PROF_NUM_TASKS;
+}
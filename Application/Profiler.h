@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Profiler.h/c records how long each main loop task takes. Every sample is
+ * the Timer 0 tick delta (4 us) around the task and goes into a per-task
+ * histogram with log2 buckets:
+ *
+ *      bucket 0: < 2 ticks (8 us), bucket b: [2^b, 2^(b+1)) ticks,
+ *      last bucket: everything from 2^(PROF_BUCKETS-1) ticks (8.2 ms) up
+ *
+ * Buckets are 8 bits; when one fills, every bucket of that task is halved so
+ * the shape of the distribution, and so the percentiles, is kept. Min and
+ * max are exact.
+ *
+ * The 'h' command dumps one message per task, format
+ * "cBHfffBBBBBBBBBBBB":
+ *      'h', task id, samples, min [ms], max [ms], p99 [ms], buckets 0..11
+ *
+ * p99 is the upper edge of the bucket holding the 99th percentile. Samples
+ * saturate at 65535. Task ids follow eProfTask.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../Driver/include_driver.h"
+
+#define PROF_BUCKETS	12
+
+typedef enum
+{
+	PROF_LOOP,				// one pass of the main loop, not counting sleep
+	PROF_USB,				// USB_Upkeep_Task
+	PROF_MESSAGES,			// Message_Handling_Task
+	PROF_RESTART,			// mf_* tasks from here down
+	PROF_BATTERY_TASK,
+	PROF_SEND_TIME,
+	PROF_TIME_FLOAT_SEND,
+	PROF_LOOP_TIMER,
+	PROF_DUTY_CYCLE,
+	PROF_SEND_ENCODER,
+	PROF_SEND_BATTERY,
+	PROF_LOW_BATTERY,
+	PROF_TIMED_PWM,
+	PROF_SYS_DATA,
+	PROF_DIST_CONTROL,
+	PROF_VEL_CONTROL,
+	PROF_MOTOR_STOP,
+	PROF_IR_PROXIMITY,
+	PROF_OBJ_AVOIDANCE,
+	PROF_TRAJECTORY,
+	PROF_SERVO,
+	PROF_TELEMETRY,
+	PROF_IR_READ,			// each IRRead call
+	PROF_CONTROLLER,		// each pair of Controller_Update calls
+	PROF_NUM_TASKS
+} eProfTask;
+
+#ifdef CONFIG_PROFILER
+
+/**
+ * Function Profiler_Init clears all histograms
+ */
+void Profiler_Init();
+
+/**
+ * Function Profiler_Start returns the timestamp to pass to Profiler_Record at the end of the task
+ */
+static inline uint16_t Profiler_Start() {
+	return GetTicks();
+}
+
+/**
+ * Function Profiler_Record adds the time since start to the task's histogram
+ */
+void Profiler_Record(eProfTask task, uint16_t start);
+
+/**
+ * Function Profiler_Dump_Start begins sending the histograms. If reset is set they are cleared once sent.
+ */
+void Profiler_Dump_Start(bool reset);
+
+/**
+ * Function Profiler_Dump_Task sends the next task's histogram once the USB send buffer has drained. Returns
+ * true while there are more to send.
+ */
+bool Profiler_Dump_Task();
+
+#else
+
+// Built without the profiler (CONFIG_PROFILER=n), the timing hooks compile away
+static inline void Profiler_Init() {}
+static inline uint16_t Profiler_Start() { return 0; }
+static inline void Profiler_Record(eProfTask task, uint16_t start) { (void)task; (void)start; }
+
+#endif
+
+#endif
@@ -0,0 +1,409 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "Telemetry.h"
+#include "application_defines.h"
+#include "MEGN540_Protocol.h"
+#include "Params.h"
+
+#define TELEM_FORMAT_LEN	16		// "cBI" + every channel + '\0'
+#define TELEM_DATA_LEN		49		// a delta keyframe with every channel, a plain frame needs 44
+#define TELEM_NUM_VALUES	12		// integer values over all channels in the delta encoding
+#define TELEM_KEYFRAME		0x80	// bitmap flag, values are absolute
+
+typedef struct {
+	uint16_t period;	// ticks, 0 when unsubscribed
+	uint16_t countdown;	// ticks until due
+} t_Subscription;
+
+static t_Subscription subscriptions[TELEM_NUM_CHANNELS];
+static uint8_t pending;		// due but not sent yet
+
+static char format[TELEM_FORMAT_LEN];
+static uint8_t frame[TELEM_DATA_LEN];
+static uint8_t format_len;
+static uint8_t frame_len;
+
+// Odometry for the pose channel
+static float pose_x;
+static float pose_y;
+static float pose_heading;
+static int32_t last_left;
+static int32_t last_right;
+static uint8_t last_zeroed;
+
+#ifdef CONFIG_IR
+static bool ir_right_next;
+#endif
+
+// Delta encoding, the host keeps the same previous values
+static bool delta_encoding;
+static uint8_t keyframe_interval;
+static uint8_t frames_to_key;
+static uint8_t sequence;
+static uint32_t previous_time;
+static int32_t previous[TELEM_NUM_VALUES];
+
+// Where each channel's values start in previous
+static const uint8_t value_offset[TELEM_NUM_CHANNELS] = { 0, 2, 3, 5, 8, 10 };
+
+/*
+ * Appends a channel's format characters and data to the frame
+ */
+static void Append(const char* fields, const void* p_data, uint8_t data_len) {
+	while(*fields) {
+		format[format_len++] = *fields++;
+	}
+	memcpy(&frame[frame_len], p_data, data_len);
+	frame_len += data_len;
+}
+
+static void Pose_Reset() {
+	pose_x = 0;
+	pose_y = 0;
+	pose_heading = 0;
+	last_left = Counts_Left();
+	last_right = Counts_Right();
+	last_zeroed = Encoders_Zeroed();
+}
+
+/*
+ * Dead reckoning from the wheel travel since the last tick, taken as an arc
+ */
+static void Pose_Update() {
+	int32_t left = Counts_Left();
+	int32_t right = Counts_Right();
+
+	// Counts restart at zero after Zero_Encoders ('d' and friends)
+	uint8_t zeroed = Encoders_Zeroed();
+	if(zeroed != last_zeroed) {
+		last_left = 0;
+		last_right = 0;
+		last_zeroed = zeroed;
+	}
+
+	float dist_left = ECount_to_Distance(left - last_left);
+	float dist_right = ECount_to_Distance(right - last_right);
+	last_left = left;
+	last_right = right;
+
+	float dist = (dist_left + dist_right) / 2;
+	float turn = (dist_right - dist_left) / params.wheel_base;
+	float heading = pose_heading + turn / 2;
+
+	pose_x += dist * cos(heading);
+	pose_y += dist * sin(heading);
+	pose_heading += turn;
+	if(pose_heading > M_PI) {
+		pose_heading -= 2 * M_PI;
+	}
+	else if(pose_heading < -M_PI) {
+		pose_heading += 2 * M_PI;
+	}
+}
+
+/*
+ * Appends a zigzag varint: 7 bits a byte, low bits first, the top bit set on all but the last. Zigzag maps
+ * 0, -1, 1, -2 ... to 0, 1, 2, 3 ... so small deltas of either sign take one byte.
+ */
+static void Put_Varint(int32_t value) {
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	while(zigzag >= 0x80) {
+		frame[frame_len++] = (zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	frame[frame_len++] = zigzag;
+}
+
+/*
+ * A channel's values as integers for the delta encoding: counts, mV, duty cycle, mm and mrad, 0 or 1 for the
+ * IR side, mm/s. Returns how many.
+ */
+static uint8_t Channel_Values(uint8_t channel, int32_t* p_values) {
+	switch(channel) {
+	case TELEM_ENCODERS:
+		p_values[0] = Counts_Left();
+		p_values[1] = Counts_Right();
+		return 2;
+	case TELEM_BATTERY:
+		p_values[0] = lround(Battery_Voltage() * 1000);
+		return 1;
+	case TELEM_PWM:
+		p_values[0] = Get_Motor_PWM_Left();
+		p_values[1] = Get_Motor_PWM_Right();
+		return 2;
+	case TELEM_POSE:
+		p_values[0] = lround(pose_x * 1000);
+		p_values[1] = lround(pose_y * 1000);
+		p_values[2] = lround(pose_heading * 1000);
+		return 3;
+#ifdef CONFIG_IR
+	case TELEM_IR: {
+		t_ProximityReturn prox = IR_Counts();
+		p_values[0] = prox.m_nCount;
+		p_values[1] = (prox.m_eSide == LEFT) ? 0 : 1;
+		return 2;
+	}
+#endif
+	case TELEM_CONTROL:
+		p_values[0] = lround(ctr_LeftMotor.target_vel * 1000);
+		p_values[1] = lround(ctr_RightMotor.target_vel * 1000);
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Packs the due channels as varint deltas against the values last sent, or every subscribed channel as
+ * absolute values in a keyframe. The frame is "c<n>s": bitmap (TELEM_KEYFRAME set in a keyframe), sequence
+ * number, time [us] and the values. Returns false, sending nothing, if the send buffer has no room.
+ */
+static bool Send_Delta_Frame(uint8_t channels, uint8_t subscribed) {
+	// Channels not in this frame keep their previous values
+	int32_t values[TELEM_NUM_VALUES];
+	memcpy(values, previous, sizeof(values));
+	bool key = (frames_to_key == 0);
+	uint32_t now = GetTimeMicros();
+
+	// A keyframe carries every channel, so a host can pick up the slow ones that are never due on it
+	if(key) {
+		channels |= subscribed;
+	}
+
+	frame_len = 0;
+	frame[frame_len++] = channels | (key ? TELEM_KEYFRAME : 0);
+	frame[frame_len++] = sequence;
+	Put_Varint(key ? (int32_t)now : (int32_t)(now - previous_time));
+
+	for(uint8_t i = 0; i < TELEM_NUM_CHANNELS; i++) {
+		if(!(channels & (1 << i))) {
+			continue;
+		}
+		int32_t* p_values = &values[value_offset[i]];
+		int32_t* p_previous = &previous[value_offset[i]];
+		uint8_t count = Channel_Values(i, p_values);
+		for(uint8_t j = 0; j < count; j++) {
+			// Wrapping difference, the host adds it back the same way
+			Put_Varint(key ? p_values[j] : (int32_t)((uint32_t)p_values[j] - (uint32_t)p_previous[j]));
+		}
+	}
+
+	format_len = 0;
+	format[format_len++] = 'c';
+	if(frame_len >= 10) format[format_len++] = '0' + frame_len / 10;
+	format[format_len++] = '0' + frame_len % 10;
+	format[format_len++] = 's';
+	format[format_len] = '\0';
+
+	if(usb_out_msg_length() + 1 + format_len + 1 + 1 + frame_len > RB_LENGTH_C - 1) {
+		return false;
+	}
+	usb_send_msg(format, 'Y', frame, frame_len);
+
+	// Only what was sent becomes the reference
+	previous_time = now;
+	memcpy(previous, values, sizeof(previous));
+	sequence++;
+	frames_to_key = key ? keyframe_interval - 1 : frames_to_key - 1;
+
+	return true;
+}
+
+/*
+ * Packs the due channels into one frame. Returns false, sending nothing, if the send buffer has no room.
+ */
+static bool Send_Frame(uint8_t channels, uint8_t subscribed) {
+	if(delta_encoding) {
+		return Send_Delta_Frame(channels, subscribed);
+	}
+
+	struct __attribute__((__packed__)) { uint8_t channels; uint32_t time; } header;
+	header.channels = channels;
+	header.time = GetTimeMicros();
+
+	format_len = 0;
+	frame_len = 0;
+	Append("cBI", &header, sizeof(header));
+
+	if(channels & (1 << TELEM_ENCODERS)) {
+		t_Telem_Encoders counts = { Counts_Left(), Counts_Right() };
+		Append(TELEM_FMT_ENCODERS, &counts, sizeof(counts));
+	}
+	if(channels & (1 << TELEM_BATTERY)) {
+		t_Telem_Battery battery = { Battery_Voltage() };
+		Append(TELEM_FMT_BATTERY, &battery, sizeof(battery));
+	}
+	if(channels & (1 << TELEM_PWM)) {
+		t_Telem_Pwm pwm = { Get_Motor_PWM_Left(), Get_Motor_PWM_Right() };
+		Append(TELEM_FMT_PWM, &pwm, sizeof(pwm));
+	}
+	if(channels & (1 << TELEM_POSE)) {
+		t_Telem_Pose pose = { pose_x, pose_y, pose_heading };
+		Append(TELEM_FMT_POSE, &pose, sizeof(pose));
+	}
+#ifdef CONFIG_IR
+	if(channels & (1 << TELEM_IR)) {
+		t_ProximityReturn prox = IR_Counts();
+		t_Telem_Ir ir;
+		ir.count = prox.m_nCount;
+		ir.side = (prox.m_eSide == LEFT) ? 'L' : 'R';
+		Append(TELEM_FMT_IR, &ir, sizeof(ir));
+	}
+#endif
+	if(channels & (1 << TELEM_CONTROL)) {
+		t_Telem_Control target = { ctr_LeftMotor.target_vel, ctr_RightMotor.target_vel };
+		Append(TELEM_FMT_CONTROL, &target, sizeof(target));
+	}
+	format[format_len] = '\0';
+
+	if(usb_out_msg_length() + 1 + format_len + 1 + frame_len > RB_LENGTH_C - 1) {
+		return false;
+	}
+
+	// The format's 'c' is the command byte, it isn't part of the data
+	usb_send_msg(format, 'Y', frame, frame_len);
+	return true;
+}
+
+/**
+ * Function Telemetry_Init drops every subscription and goes back to plain frames
+ */
+void Telemetry_Init() {
+	memset(subscriptions, 0, sizeof(subscriptions));
+	pending = 0;
+	Telemetry_Set_Encoding(false, 0);
+}
+
+/**
+ * Function Telemetry_Set_Encoding switches between plain and delta frames. A delta stream sends a keyframe
+ * every interval frames (0 for TELEM_KEYFRAME_INTERVAL), starting with the next one.
+ */
+void Telemetry_Set_Encoding(bool delta, uint8_t interval) {
+	delta_encoding = delta;
+	keyframe_interval = (interval == 0) ? TELEM_KEYFRAME_INTERVAL : interval;
+	frames_to_key = 0;
+
+	// A new stream starts from zero, as a new Decoder on the host does
+	previous_time = 0;
+	memset(previous, 0, sizeof(previous));
+}
+
+/*
+ * Sets one channel's period in ticks, 0 unsubscribes
+ */
+static void Set_Period(uint8_t channel, uint16_t ticks) {
+	t_Subscription* p_sub = &subscriptions[channel];
+
+	if(ticks > 0 && p_sub->period == 0) {
+		if(channel == TELEM_POSE) {
+			Pose_Reset();
+		}
+		// The host has no reference for a new channel until it is sent whole
+		frames_to_key = 0;
+	}
+
+	p_sub->period = ticks;
+	p_sub->countdown = 1;
+}
+
+/**
+ * Function Telemetry_Subscribe sets a channel's period, 0 unsubscribes. Returns false for an unknown channel
+ * or a negative period.
+ */
+bool Telemetry_Subscribe(uint8_t channel, float period) {
+	if(period < 0) {
+		return false;
+	}
+
+	uint16_t ticks = 0;
+	if(period > 0) {
+		float exact = period * 1000 / TELEM_TICK_MS + 0.5;
+		ticks = (exact < 1) ? 1 : (exact > UINT16_MAX) ? UINT16_MAX : (uint16_t)exact;
+	}
+
+	if(channel == TELEM_ALL) {
+		for(uint8_t i = 0; i < TELEM_NUM_CHANNELS; i++) {
+#ifndef CONFIG_IR
+			if(i == TELEM_IR) continue;
+#endif
+			Set_Period(i, ticks);
+		}
+		return true;
+	}
+
+#ifndef CONFIG_IR
+	if(channel == TELEM_IR) {
+		return false;
+	}
+#endif
+	if(channel >= TELEM_NUM_CHANNELS) {
+		return false;
+	}
+
+	Set_Period(channel, ticks);
+	return true;
+}
+
+/**
+ * Function Telemetry_Task runs one tick: updates the pose, reads the IR sensor and sends the channels that
+ * are due. Returns true while any channel is subscribed.
+ */
+bool Telemetry_Task() {
+	uint8_t subscribed = 0;
+
+	for(uint8_t i = 0; i < TELEM_NUM_CHANNELS; i++) {
+		t_Subscription* p_sub = &subscriptions[i];
+		if(p_sub->period == 0) {
+			continue;
+		}
+		subscribed |= (1 << i);
+		if(--p_sub->countdown == 0) {
+			p_sub->countdown = p_sub->period;
+			pending |= (1 << i);
+		}
+	}
+
+	if(subscribed & (1 << TELEM_POSE)) {
+		Pose_Update();
+	}
+
+#ifdef CONFIG_IR
+	// One side per tick, as the 'I' stream does
+	if(subscribed & (1 << TELEM_IR)) {
+		IRRead(ir_right_next ? RIGHT : LEFT);
+		ir_right_next = !ir_right_next;
+	}
+#endif
+
+	// Whatever was unsubscribed while waiting is dropped
+	pending &= subscribed;
+	if(pending && Send_Frame(pending, subscribed)) {
+		pending = 0;
+	}
+
+	return subscribed != 0;
+}
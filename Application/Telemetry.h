@@ -0,0 +1,113 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Telemetry.h/c streams named channels at rates the host picks, packed
+ * into one frame per tick instead of a message per stream. The host
+ * subscribes with 'Y' {uint8 channel, float period [s]}; a period of 0
+ * unsubscribes and channel TELEM_ALL applies to every channel. Periods are
+ * rounded to whole TELEM_TICK_MS ticks.
+ *
+ * Each tick every channel that is due goes into one 'Y' frame:
+ *
+ *      "cBI" + the due channels' fields in channel order
+ *      bitmap of the channels present, robot time [us] (GetTimeMicros), channel data
+ *
+ * Channels (bit = eTelemChannel):
+ *      0 encoders  "ii"    counts left, right
+ *      1 battery   "f"     voltage [V]
+ *      2 pwm       "hh"    duty cycle left, right
+ *      3 pose      "fff"   x, y [m], heading [rad] from the encoders, zeroed when subscribed
+ *      4 ir        "hc"    proximity count and side (CONFIG_IR), the sensor is read while subscribed
+ *      5 control   "ff"    target wheel velocity left, right [m/s]
+ *
+ * 'y' {uint8 encoding, uint8 keyframe interval} switches to delta frames
+ * (encoding 1) or back (0). Most values barely change from one sample to
+ * the next, so each is sent as a zigzag varint of its difference from the
+ * value last sent for that channel, as an integer in the units below.
+ * Every keyframe interval frames (0 picks TELEM_KEYFRAME_INTERVAL), and on
+ * the frame after a channel is subscribed, every subscribed channel is
+ * sent whole, due or not, so a host that joins late or loses a frame can
+ * pick up again. A delta frame is 'Y' with format "c<n>s":
+ *
+ *      bitmap (bit 7 set in a keyframe), sequence number, time [us]
+ *      (delta, or whole in a keyframe), then the channels' values
+ *
+ *      encoders counts, battery mV, pwm duty cycle, pose mm and mrad,
+ *      ir count and side (0 left, 1 right), control mm/s
+ *
+ * An encoders-only frame drops from 21 bytes to about 13, the 16 byte
+ * endpoint carries more samples for the same bandwidth.
+ *
+ * The frame goes through the send buffer like any other message. If there
+ * is no room the channels stay due and go out on a later tick, so a slow
+ * host sees lower rates rather than broken frames. The existing streams
+ * ('E', 'B', 'Q', 'I', 'T') are unchanged.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../Driver/include_driver.h"
+
+#define TELEM_TICK_MS		10		// fastest channel rate, 100 Hz
+#define TELEM_ALL			0xFF
+#define TELEM_KEYFRAME_INTERVAL	50	// delta frames per keyframe, half a second at the fastest rate
+
+typedef enum
+{
+	TELEM_ENCODERS,
+	TELEM_BATTERY,
+	TELEM_PWM,
+	TELEM_POSE,
+	TELEM_IR,
+	TELEM_CONTROL,
+	TELEM_NUM_CHANNELS
+} eTelemChannel;
+
+/**
+ * Function Telemetry_Init drops every subscription and goes back to plain frames
+ */
+void Telemetry_Init();
+
+/**
+ * Function Telemetry_Set_Encoding switches between plain and delta frames. A delta stream sends a keyframe
+ * every interval frames (0 for TELEM_KEYFRAME_INTERVAL), starting with the next one.
+ */
+void Telemetry_Set_Encoding(bool delta, uint8_t interval);
+
+/**
+ * Function Telemetry_Subscribe sets a channel's period, 0 unsubscribes. Returns false for an unknown channel
+ * or a negative period.
+ */
+bool Telemetry_Subscribe(uint8_t channel, float period);
+
+/**
+ * Function Telemetry_Task runs one tick: updates the pose, reads the IR sensor and sends the channels that
+ * are due. Returns true while any channel is subscribed.
+ */
+bool Telemetry_Task();
+
+#endif
@@ -0,0 +1,418 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Trajectory.h"
+#include "Gripper.h"
+#include "Params.h"
+
+static const uint8_t TRAJ_MASK = TRAJ_QUEUE_LEN - 1;
+
+// Segment queue
+static t_TrajSegment queue[TRAJ_QUEUE_LEN];
+static uint8_t q_start;
+static uint8_t q_count;
+// Sequence number of the active segment (wraps)
+static uint8_t seq;
+
+// Active segment
+static bool running;
+static char seg_type;
+static float dist_left, dist_right;			// distance targets
+static float travel_left, travel_right;		// distance covered so far
+static int32_t counts_left, counts_right;	// same, in encoder counts
+static bool braking;						// robot halts after this segment, brake into it
+static float seg_time, seg_duration;		// for timed segments, and the stall timeout when braking
+static float target_vel_left, target_vel_right;
+// Blended wheel velocity commands
+static float cmd_vel_left, cmd_vel_right;
+// Previous tick
+static int32_t ticks_left, ticks_right;
+static float last_time;
+
+/*
+ * Sends a compact progress event to the host
+ */
+static void Send_Event(char event, uint8_t index) {
+	struct __attribute__((__packed__)) { char event; uint8_t index; } data =
+	{
+			.event = event,
+			.index = index
+	};
+
+	usb_send_msg("ccB", 'w', &data, sizeof(data));
+}
+
+/*
+ * Limits value to +/- limit
+ */
+static float Clamp(float value, float limit) {
+	return (value > limit) ? limit : (value < -limit) ? -limit : value;
+}
+
+/*
+ * Converts a signed wheel velocity to a signed PWM duty cycle
+ */
+static int16_t Wheel_PWM(float velocity, bool left) {
+	float speed = (velocity < 0) ? -velocity : velocity;
+	int pwm = left ? Velocity_to_DutyCycle_Left(speed) : Velocity_to_DutyCycle_Right(speed);
+
+	if(pwm < 0 || velocity == 0) {
+		pwm = 0;
+	}
+
+	return (velocity < 0) ? -pwm : pwm;
+}
+
+/*
+ * Sets up wheel distance targets for a spin in place
+ */
+static void Setup_Spin(float angle) {
+	float d = (params.wheel_base * angle)/4;
+	dist_left = -1 * d;
+	dist_right = d;
+
+	target_vel_left = DutyCycle_to_Velocity_Left(params.spin_dutycycle);
+	target_vel_right = DutyCycle_to_Velocity_Right(params.spin_dutycycle);
+	if(angle > 0) {
+		target_vel_left *= -1;
+	}
+	else {
+		target_vel_right *= -1;
+	}
+}
+
+/*
+ * Sets up the motion profiles so the last distance segment decelerates into
+ * the stop. The robot may already be moving, speeding up is left to the
+ * blend, so the profiles start at cruise speed and only brake.
+ */
+static void Setup_Braking() {
+	float abs_left = (dist_left < 0) ? -dist_left : dist_left;
+	float abs_right = (dist_right < 0) ? -dist_right : dist_right;
+	float longest = (abs_left > abs_right) ? abs_left : abs_right;
+
+	if(longest <= 0) {
+		return;
+	}
+
+	Motion_Profile_Init(&mp_LeftMotor, dist_left, target_vel_left, params.dist_accel * abs_left/longest,
+			params.dist_creep, ctr_LeftMotor.update_period);
+	Motion_Profile_Init(&mp_RightMotor, dist_right, target_vel_right, params.dist_accel * abs_right/longest,
+			params.dist_creep, ctr_RightMotor.update_period);
+	mp_LeftMotor.velocity = mp_LeftMotor.v_max;
+	mp_RightMotor.velocity = mp_RightMotor.v_max;
+
+	// The profiles creep until both wheels arrive, give up on a stalled or slipping wheel as 'd' does
+	float duration_left = Motion_Profile_Duration(&mp_LeftMotor, ctr_LeftMotor.update_period);
+	float duration_right = Motion_Profile_Duration(&mp_RightMotor, ctr_RightMotor.update_period);
+	float planned = (duration_left > duration_right) ? duration_left : duration_right;
+	seg_duration = (planned * DIST_TIMEOUT_SCALE + DIST_TIMEOUT_MS) / 1000;
+
+	braking = true;
+}
+
+/*
+ * Pops the next segment off the queue and sets up its targets. Returns
+ * false if the queue is empty.
+ */
+static bool Load_Next_Segment() {
+	if(q_count == 0) {
+		return false;
+	}
+
+	t_TrajSegment seg = queue[q_start];
+	q_start = (q_start + 1) & TRAJ_MASK;
+	q_count--;
+	seq++;
+
+	seg_type = seg.type;
+	travel_left = 0;
+	travel_right = 0;
+	counts_left = 0;
+	counts_right = 0;
+	braking = false;
+	seg_time = 0;
+	seg_duration = 0;
+	dist_left = 0;
+	dist_right = 0;
+	target_vel_left = 0;
+	target_vel_right = 0;
+
+	switch(seg.type) {
+	case TRAJ_LINE:
+	{
+		dist_left = seg.p1;
+		dist_right = seg.p1;
+
+		float speed_left = (seg.p2 > 0) ? seg.p2 : DutyCycle_to_Velocity_Left(TRAJ_LINE_DC);
+		float speed_right = (seg.p2 > 0) ? seg.p2 : DutyCycle_to_Velocity_Right(TRAJ_LINE_DC);
+		target_vel_left = (seg.p1 < 0) ? -speed_left : speed_left;
+		target_vel_right = (seg.p1 < 0) ? -speed_right : speed_right;
+		break;
+	}
+
+	case TRAJ_ARC:
+	{
+		// Arcs don't run backwards, see the 'd' command
+		float linear = (seg.p1 < 0) ? -seg.p1 : seg.p1;
+		float angle = seg.p2;
+
+		if(linear < params.min_turn_arc) {
+			Setup_Spin(angle);
+		}
+		else if((angle < 0.01) && (angle > -0.01)) { // Straight, as 'd' does
+			dist_left = linear;
+			dist_right = linear;
+			target_vel_left = params.turn_velocity;
+			target_vel_right = params.turn_velocity;
+		}
+		else if(angle > 0) { // Turn left
+			float r = linear/angle;
+			dist_left = linear;
+			dist_right = angle * (r + params.wheel_base);
+			target_vel_left = params.turn_velocity;
+			target_vel_right = dist_right/(dist_left/params.turn_velocity);
+		}
+		else { // Turn right
+			angle *= -1;
+			float r = linear/angle;
+			dist_right = linear;
+			dist_left = angle * (r + params.wheel_base);
+			target_vel_right = params.turn_velocity;
+			target_vel_left = dist_left/(dist_right/params.turn_velocity);
+		}
+		break;
+	}
+
+	case TRAJ_SPIN:
+		Setup_Spin(seg.p2);
+		break;
+
+	case TRAJ_VELOCITY:
+		// The inner track runs at the given speed, the outer one faster
+		target_vel_left = seg.p1;
+		target_vel_right = seg.p1;
+		if(seg.p2 > 0.01) {
+			target_vel_right += params.wheel_base * seg.p2;
+		}
+		else if(seg.p2 < -0.01) {
+			target_vel_left -= params.wheel_base * seg.p2;
+		}
+		seg_duration = seg.p3;
+		break;
+
+#ifdef CONFIG_SERVO
+	case TRAJ_GRIP:
+	{
+		float position = (seg.p1 < SERVO_OPEN_POS) ? SERVO_OPEN_POS
+				: (seg.p1 > SERVO_CLOSED_POS) ? SERVO_CLOSED_POS : seg.p1;
+		Gripper_Move((uint8_t)position, seg.p2);
+		break;
+	}
+#endif
+
+	case TRAJ_WAIT:
+	default:
+		seg_duration = seg.p3;
+		break;
+	}
+
+	// Profile the stop if the robot halts after a distance segment
+	bool halts = (q_count == 0) || (queue[q_start].type == TRAJ_WAIT) || (queue[q_start].type == TRAJ_GRIP);
+	if(halts && (seg_type == TRAJ_LINE || seg_type == TRAJ_ARC || seg_type == TRAJ_SPIN)) {
+		Setup_Braking();
+	}
+
+	Send_Event('S', seq);
+
+	return true;
+}
+
+/*
+ * Returns true once the active segment has reached its end condition
+ */
+static bool Segment_Done() {
+	switch(seg_type) {
+	case TRAJ_LINE:
+	case TRAJ_ARC:
+	case TRAJ_SPIN:
+	{
+		if(braking) {
+			return Motion_Profile_Done(&mp_LeftMotor) && Motion_Profile_Done(&mp_RightMotor);
+		}
+
+		bool doneL = (dist_left > 0) ? (travel_left >= dist_left) : (travel_left <= dist_left);
+		bool doneR = (dist_right > 0) ? (travel_right >= dist_right) : (travel_right <= dist_right);
+		return doneL || doneR;
+	}
+
+#ifdef CONFIG_SERVO
+	case TRAJ_GRIP:
+		return Servo_Is_Settled();
+#endif
+
+	default:
+		return seg_time >= seg_duration;
+	}
+}
+
+/*
+ * Shuts off the motors
+ */
+static void Stop_Motors() {
+	Motor_PWM_Left(0);
+	Motor_PWM_Right(0);
+	Motor_PWM_Enable(false);
+
+	cmd_vel_left = 0;
+	cmd_vel_right = 0;
+	running = false;
+}
+
+/*
+ * Initializes the trajectory queue to empty and idle
+ */
+void Trajectory_Init() {
+	q_start = 0;
+	q_count = 0;
+	seq = 0;
+	running = false;
+	cmd_vel_left = 0;
+	cmd_vel_right = 0;
+}
+
+/*
+ * Appends a segment to the queue. Returns false (and sends an 'F' event)
+ * if the queue is full or the segment type is unknown.
+ */
+bool Trajectory_Add(const t_TrajSegment* p_seg) {
+	bool known = (p_seg->type == TRAJ_LINE) || (p_seg->type == TRAJ_ARC) || (p_seg->type == TRAJ_SPIN)
+			|| (p_seg->type == TRAJ_VELOCITY) || (p_seg->type == TRAJ_WAIT);
+#ifdef CONFIG_SERVO
+	known = known || (p_seg->type == TRAJ_GRIP);
+#endif
+
+	if(!known || q_count >= TRAJ_QUEUE_LEN) {
+		Send_Event('F', q_count);
+		return false;
+	}
+
+	queue[(q_start + q_count) & TRAJ_MASK] = *p_seg;
+	q_count++;
+
+	return true;
+}
+
+/*
+ * Starts executing the queue. Any partly run segment from a previous
+ * start is dropped. Returns false if the queue is empty.
+ */
+bool Trajectory_Start() {
+	// Robot is assumed to be at rest
+	cmd_vel_left = 0;
+	cmd_vel_right = 0;
+	ticks_left = Counts_Left();
+	ticks_right = Counts_Right();
+	last_time = GetTimeSec();
+
+	running = Load_Next_Segment();
+	return running;
+}
+
+/*
+ * Stops the motors, empties the queue and sends an 'A' event
+ */
+void Trajectory_Abort() {
+	Stop_Motors();
+	q_count = 0;
+	Send_Event('A', seq);
+}
+
+/*
+ * Returns the number of segments waiting in the queue
+ */
+uint8_t Trajectory_Length() {
+	return q_count;
+}
+
+/*
+ * Trajectory_Task runs one control tick of the active segment. Returns
+ * false once the queue has finished and the motors are stopped.
+ */
+bool Trajectory_Task() {
+	if(!running) {
+		return false;
+	}
+
+	float now = GetTimeSec();
+	float dt = now - last_time;
+	last_time = now;
+
+	// Distance covered since the last tick
+	int32_t left = Counts_Left();
+	int32_t right = Counts_Right();
+	travel_left += ECount_to_Distance(left - ticks_left);
+	travel_right += ECount_to_Distance(right - ticks_right);
+	counts_left += left - ticks_left;
+	counts_right += right - ticks_right;
+	ticks_left = left;
+	ticks_right = right;
+	seg_time += dt;
+
+	// A braking segment that runs out of time stops the motors before the queue moves on
+	if(braking && seg_time >= seg_duration) {
+		Stop_Motors();
+		Send_Event('T', seq);
+		running = Load_Next_Segment();
+		if(!running) {
+			Send_Event('E', seq);
+		}
+		return running;
+	}
+
+	// Move straight on to the next segment without stopping
+	if(Segment_Done() && !Load_Next_Segment()) {
+		Stop_Motors();
+		Send_Event('E', seq);
+		return false;
+	}
+
+	// Profiled braking on the last distance segment
+	float goal_left = target_vel_left;
+	float goal_right = target_vel_right;
+	if(braking) {
+		goal_left = Motion_Profile_Step(&mp_LeftMotor, counts_left) * mp_LeftMotor.direction;
+		goal_right = Motion_Profile_Step(&mp_RightMotor, counts_right) * mp_RightMotor.direction;
+	}
+
+	// Blend toward the segment's wheel velocities
+	float dv = TRAJ_BLEND_ACCEL * dt;
+	cmd_vel_left += Clamp(goal_left - cmd_vel_left, dv);
+	cmd_vel_right += Clamp(goal_right - cmd_vel_right, dv);
+
+	Motor_PWM_Left(Wheel_PWM(cmd_vel_left, true));
+	Motor_PWM_Right(Wheel_PWM(cmd_vel_right, false));
+	Motor_PWM_Enable(true);
+
+	return true;
+}
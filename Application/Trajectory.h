@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Trajectory.h/c implements an on-board queue of drive segments. The host
+ * uploads a batch of segments with the 'W' command and starts them with
+ * 'w'. Segments then run back to back without stopping; the wheel velocity
+ * commands are slew-rate limited so the joins between segments blend
+ * instead of stepping. A distance segment followed by a stop, wait or grip
+ * brakes into the stop on the same motion profile as 'd'.
+ *
+ * Segment types and their parameters (p1, p2, p3):
+ *      'L' line        distance [m] (signed), speed [m/s] (0 for default), -
+ *      'A' arc         inner track arc length [m], angle [rad] (+ left), -
+ *      'S' spin        -, angle [rad] (+ left), -
+ *      'V' velocity    linear [m/s], angular [rad/s], duration [s]
+ *      'W' wait        -, -, duration [s]
+ *      'G' grip        position [%] (0 open, 100 closed), speed [%/s] (0 for default), -
+ *                      (rejected when built without CONFIG_SERVO)
+ *
+ * As with the 'd' and 'v' commands, positive angles turn left and arcs and
+ * velocity segments run the inner track at the set speed. A grip segment
+ * holds the robot still and ends as soon as the gripper servo settles.
+ *
+ * Progress is reported with compact events, format "ccB":
+ *      'w', <event>, <segment sequence number>
+ *
+ *      'S' segment started         'E' queue finished, robot stopped
+ *      'A' aborted                 'F' upload rejected (queue full / bad type)
+ *      'R' status reply, the number is the count of queued segments
+ *      'T' braking segment timed out (a stalled or slipping wheel), the
+ *          motors are stopped and the queue moves on
+ */
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "../Driver/include_driver.h"
+#include "application_defines.h"
+#include "MEGN540_Protocol.h"
+
+#define TRAJ_QUEUE_LEN		8		// must be a power of 2
+#define TRAJ_LINE_DC		75		// default line speed, same as 'd'
+#define TRAJ_BLEND_ACCEL	1.0		// max wheel acceleration at joins [m/s^2]
+
+typedef enum
+{
+	TRAJ_LINE = 'L',
+	TRAJ_ARC = 'A',
+	TRAJ_SPIN = 'S',
+	TRAJ_VELOCITY = 'V',
+	TRAJ_WAIT = 'W',
+	TRAJ_GRIP = 'G'
+} eTrajSegment;
+
+// The 'W' payload: type, then p1 to p3 as in the table above
+typedef t_Msg_TrajectorySegment t_TrajSegment;
+
+/*
+ * Initializes the trajectory queue to empty and idle
+ */
+void Trajectory_Init();
+
+/*
+ * Appends a segment to the queue. Returns false (and sends an 'F' event)
+ * if the queue is full or the segment type is unknown.
+ */
+bool Trajectory_Add(const t_TrajSegment* p_seg);
+
+/*
+ * Starts executing the queue. Any partly run segment from a previous
+ * start is dropped. Returns false if the queue is empty.
+ */
+bool Trajectory_Start();
+
+/*
+ * Stops the motors, empties the queue and sends an 'A' event
+ */
+void Trajectory_Abort();
+
+/*
+ * Returns the number of segments waiting in the queue
+ */
+uint8_t Trajectory_Length();
+
+/*
+ * Trajectory_Task runs one control tick of the active segment. Returns
+ * false once the queue has finished and the motors are stopped.
+ */
+bool Trajectory_Task();
+
+#endif
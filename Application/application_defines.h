@@ -2,8 +2,25 @@
 #ifndef APPLICATION_DEFINES_H
 #define APPLICATION_DEFINES_H
 
+// Defaults of the runtime parameters (Params.h), use params.<name> instead
 #define WHEEL_BASE		0.098
-#define HALF_WHEEL_BASE	0.049
+
+#define TURN_VELOCITY	0.1
+#define MIN_TURN_ARC	0.04
+#define SPIN_DUTYCYLE	25
+
+// Distance move ('d', 'D') profile limits
+#define DIST_ACCEL		0.8		// [m/s^2]
+#define DIST_CREEP		0.06	// slowest speed while closing in, about 15% PWM [m/s]
+
+// 'd' and a braking trajectory segment stop if they haven't arrived after
+// this share of the planned time plus DIST_TIMEOUT_MS (a stalled or
+// slipping wheel)
+#define DIST_TIMEOUT_SCALE	1.5
+#define DIST_TIMEOUT_MS		500		// [ms]
+
+// Teleop ('j') watchdog, the robot stops if commands stop for this long
+#define TELEOP_TIMEOUT_MS	100		// [ms]
 
 /** Message Driven State Machine Flags */
 typedef struct MSG_FLAG { bool active; float duration; Time_t last_trigger_time; } MSG_FLAG_t;
@@ -22,7 +39,36 @@ MSG_FLAG_t mf_sys_data;			///<-- Used to send periodic system status data
 MSG_FLAG_t mf_motor_dist_control;	///<-- Enables motor controllers for distance
 MSG_FLAG_t mf_motor_vel_control;	///<-- Enables motor controllers for velocity
 MSG_FLAG_t mf_motor_stop;		///<-- Used to set PWM and control position & velocity to zero
+#ifdef CONFIG_IR
 MSG_FLAG_t mf_ir_proximity;		///<-- Used for IR proximity sensor
+#endif
+#ifdef CONFIG_OA
 MSG_FLAG_t mf_obj_avoidance;		///<-- Used for object avoidance
+#endif
+#ifdef CONFIG_TRAJECTORY
+MSG_FLAG_t mf_trajectory;		///<-- Runs the on-board trajectory queue
+#endif
+#ifdef CONFIG_SERVO
+MSG_FLAG_t mf_servo;			///<-- Ramps the gripper servo
+#endif
+#ifdef CONFIG_IDLE
+MSG_FLAG_t mf_duty_cycle;		///<-- Sends the main loop duty-cycle statistics
+#endif
+#ifdef CONFIG_PROFILER
+MSG_FLAG_t mf_profiler_dump;	///<-- Sends the task profiler histograms
+#endif
+#ifdef CONFIG_TRACE
+MSG_FLAG_t mf_trace_snapshot;	///<-- Copies the flight recorder to EEPROM
+#endif
+#ifdef CONFIG_LINK_BENCH
+MSG_FLAG_t mf_link_bench;		///<-- Streams USB link benchmark packets
+#endif
+#ifdef CONFIG_TELEMETRY
+MSG_FLAG_t mf_telemetry;		///<-- Sends the subscribed telemetry channels
+#endif
+#ifdef CONFIG_PARAMS
+MSG_FLAG_t mf_params_save;		///<-- Writes the parameter table to EEPROM
+MSG_FLAG_t mf_params_dump;		///<-- Sends the parameters asked for with 'k'
+#endif
 
 #endif
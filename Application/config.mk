@@ -0,0 +1,54 @@
+#
+#             MEGN540 Mechatronics
+#
+# --------------------------------------
+#         Feature configuration.
+# --------------------------------------
+#
+#  Each optional feature is y or n. A feature that is off loses its source
+#  files, its RAM buffers, its message flag and its commands (they answer
+#  '?'), so the 32U4's RAM can go to the USB and trace buffers instead.
+#  Change the defaults here or per build:
+#
+#    make CONFIG_OA=n CONFIG_TRACE=n
+#    make size          flash and RAM per module for the current set
+#
+#  The driving core (USB messages, encoders, motors, controllers, battery
+#  monitor, timing) is always built.
+#
+
+# IR proximity sensors, 'i' and 'I'
+CONFIG_IR ?= y
+# Obstacle avoidance, 'O' (needs CONFIG_IR)
+CONFIG_OA ?= y
+# Gripper servo, 'G' and 'g'
+CONFIG_SERVO ?= y
+# On-board trajectory queue, 'W' and 'w' (grip segments need CONFIG_SERVO)
+CONFIG_TRAJECTORY ?= y
+# Flight recorder and its EEPROM snapshot, 'l'
+CONFIG_TRACE ?= y
+# Per-task profiler, 'h'
+CONFIG_PROFILER ?= y
+# Idle sleep and duty cycle, 't'/'T' actions 0x03 to 0x05
+CONFIG_IDLE ?= y
+# USB link benchmark, 'u'
+CONFIG_LINK_BENCH ?= y
+# Stack painting and the RAM report, 'm'
+CONFIG_STACK ?= y
+# Batched telemetry subscriptions, 'Y'
+CONFIG_TELEMETRY ?= y
+# Gamepad teleop with a stop watchdog, 'j'
+CONFIG_TELEOP ?= y
+# Runtime parameters saved in EEPROM, 'k', 'K' and 'n' (off, they are constants)
+CONFIG_PARAMS ?= y
+
+CONFIG_FEATURES = IR OA SERVO TRAJECTORY TRACE PROFILER IDLE LINK_BENCH STACK TELEMETRY TELEOP PARAMS
+
+ifeq ($(CONFIG_OA),y)
+ifneq ($(CONFIG_IR),y)
+$(error CONFIG_OA=y needs CONFIG_IR=y)
+endif
+endif
+
+# -DCONFIG_<feature> for every feature that is on
+CONFIG_CDEFS = $(foreach f,$(CONFIG_FEATURES),$(if $(filter y,$(strip $(CONFIG_$(f)))),-DCONFIG_$(f)))
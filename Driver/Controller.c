@@ -2,7 +2,7 @@
 
 //Function Initialize_Controller sets up the z-transform-based controller for the system
 // update_period is in miliseconds
-void Controller_Init(Controller_t* p_cont, float kp, float* num, float* den, uint8_t order, float update_period)
+void Controller_Init(Controller_t* p_cont, float kp, const float* num, const float* den, uint8_t order, float update_period)
 {
 	Filter_Init(&p_cont->controller, num, den, order);
 	p_cont->kp = kp;
@@ -13,6 +13,7 @@ static volatile bool _last_left_XOR; // Necessary to check if PB4 triggered the
 
 static volatile int32_t _left_counts;   // Static limits it's use to this file
 static volatile int32_t _right_counts;  // Static limits it's use to this file
+static uint8_t _zeroed;                 // Zero_Encoders calls, see Encoders_Zeroed
 
 /** Helper Funcions for Accessing Bit Information */
 // *** MEGN540 Lab 3 TODO ***
@@ -98,10 +99,20 @@ void Zero_Encoders() {
 	// Zero both encoders
 	_right_counts = 0;
 	_left_counts = 0;
+	_zeroed++;
 	// Restore global interrupt settings
 	SREG = sreg_value;
 }
 
+/**
+ * Function Encoders_Zeroed returns how many times Zero_Encoders has run (wrapping at 255), so code that
+ * tracks count deltas can tell a reset from motion
+ * @return [uint8_t] Number of resets
+ */
+uint8_t Encoders_Zeroed() {
+	return _zeroed;
+}
+
 /**
  * Function Rad_Left returns the number of radians for the left encoder.
  * @return [float] Encoder angle in radians
@@ -72,6 +72,13 @@ int32_t Counts_Right();
  */
 void Zero_Encoders();
 
+/**
+ * Function Encoders_Zeroed returns how many times Zero_Encoders has run (wrapping at 255), so code that
+ * tracks count deltas can tell a reset from motion
+ * @return [uint8_t] Number of resets
+ */
+uint8_t Encoders_Zeroed();
+
 /**
  * Function Rad_Left returns the number of radians for the left encoder.
  * @return
@@ -32,7 +32,7 @@ void SanityPrint(Filter_Data_t* p_filt) {
  * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
  * @param order The filter order
  */
-void  Filter_Init ( Filter_Data_t* p_filt, float* numerator_coeffs, float* denominator_coeffs, uint8_t order ) {
+void  Filter_Init ( Filter_Data_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order ) {
 	// Initialize buffers
 	rb_initialize_F(&p_filt->numerator);
 	rb_initialize_F(&p_filt->denominator);
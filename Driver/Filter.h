@@ -65,7 +65,7 @@ typedef struct {
  * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
  * @param order The filter order
  */
-void  Filter_Init ( Filter_Data_t* p_filt, float* numerator_coeffs, float* denominator_coeffs, uint8_t order );
+void  Filter_Init ( Filter_Data_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order );
 
 /**
  * Function Filter_ShiftBy shifts the input list and output list to keep the filter in the same frame. This especially
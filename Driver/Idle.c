@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Idle.h"
+
+static bool enabled;
+static Time_t window_start;
+static uint32_t idle_us;
+static uint16_t sleeps;
+
+/*
+ * Microseconds from start to end, both Time_t
+ */
+static uint32_t Micros_Between(const Time_t* start, const Time_t* end) {
+	return (end->millisec - start->millisec) * 1000 + ((int32_t)end->microsec - (int32_t)start->microsec);
+}
+
+/**
+ * Function Idle_Init enables idle sleep and starts a new statistics window
+ */
+void Idle_Init() {
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	enabled = true;
+	idle_us = 0;
+	sleeps = 0;
+	window_start = GetTime();
+}
+
+/**
+ * Function Idle_Enable turns idle sleep on or off. With it off the loop spins as before, which is useful
+ * for comparing the two.
+ */
+void Idle_Enable(bool enable) {
+	enabled = enable;
+}
+
+/**
+ * Function Idle_Sleep sleeps until the next interrupt if idle sleep is enabled
+ */
+void Idle_Sleep() {
+	if(!enabled) {
+		return;
+	}
+
+	Time_t start = GetTime();
+
+	// sei only takes effect after the next instruction, so no interrupt can slip in before the sleep
+	cli();
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	Time_t end = GetTime();
+	idle_us += Micros_Between(&start, &end);
+	sleeps++;
+}
+
+/**
+ * Function Idle_Get_Stats returns the statistics since the last call (or Idle_Init) and starts a new window
+ */
+Idle_Stats_t Idle_Get_Stats() {
+	Time_t now = GetTime();
+	uint32_t window_us = Micros_Between(&window_start, &now);
+
+	Idle_Stats_t stats;
+	stats.window = window_us / 1000000.0;
+	stats.idle = idle_us / 1000000.0;
+	stats.utilization = (window_us > 0) ? 1.0 - ((float)idle_us / window_us) : 0;
+	stats.sleeps = sleeps;
+
+	window_start = now;
+	idle_us = 0;
+	sleeps = 0;
+
+	return stats;
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Idle.h/c puts the MCU to sleep (SLEEP_MODE_IDLE) when the main loop has
+ * nothing to do. Timers and USB keep running in idle mode, so the 1 kHz
+ * Timer 0 interrupt wakes the loop in time for the next scheduled task and
+ * USB interrupts wake it for bus events.
+ *
+ * Time spent asleep is accumulated so the loop's duty cycle (the fraction
+ * of time the CPU is busy) can be reported to the host.
+ */
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <stdbool.h>
+
+#include "Timing.h"
+
+typedef struct {
+	float window;		///<-- length of the measurement window [s]
+	float idle;			///<-- time spent asleep [s]
+	float utilization;	///<-- busy fraction of the window, 0 to 1
+	uint16_t sleeps;	///<-- number of times the loop slept
+} Idle_Stats_t;
+
+#ifdef CONFIG_IDLE
+
+/**
+ * Function Idle_Init enables idle sleep and starts a new statistics window
+ */
+void Idle_Init();
+
+/**
+ * Function Idle_Enable turns idle sleep on or off. With it off the loop spins as before, which is useful
+ * for comparing the two.
+ */
+void Idle_Enable(bool enable);
+
+/**
+ * Function Idle_Sleep sleeps until the next interrupt if idle sleep is enabled
+ */
+void Idle_Sleep();
+
+/**
+ * Function Idle_Get_Stats returns the statistics since the last call (or Idle_Init) and starts a new window
+ */
+Idle_Stats_t Idle_Get_Stats();
+
+#else
+
+// Built without idle sleep (CONFIG_IDLE=n), the loop spins
+static inline void Idle_Init() {}
+static inline void Idle_Sleep() {}
+
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Motion_Profile.h"
+
+/*
+ * Integer square root, rounds down
+ */
+static uint16_t ISqrt(uint32_t value) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while(bit > value) {
+		bit >>= 2;
+	}
+
+	while(bit != 0) {
+		if(value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint16_t)root;
+}
+
+/*
+ * Converts a magnitude to fixed point
+ */
+static int32_t To_Fixed(float value) {
+	if(value < 0) {
+		value = -value;
+	}
+	return (int32_t)(value * (1 << MP_FRAC_BITS) + 0.5);
+}
+
+/**
+ * Function Motion_Profile_Init sets up a profile to cover distance [m] (signed) starting from rest.
+ * speed [m/s], accel [m/s^2] and creep [m/s] are magnitudes, update_period is the control tick in ms.
+ */
+void Motion_Profile_Init(Motion_Profile_t* p_prof, float distance, float speed, float accel, float creep,
+		float update_period) {
+	float counts_per_m = 1.0 / ECount_to_Distance(1);
+	float dt = update_period / 1000.0;
+
+	p_prof->direction = (distance < 0) ? -1 : 1;
+	p_prof->target = To_Fixed(distance * counts_per_m);
+	p_prof->v_max = To_Fixed(speed * counts_per_m * dt);
+	p_prof->v_min = To_Fixed(creep * counts_per_m * dt);
+	p_prof->accel = To_Fixed(accel * counts_per_m * dt * dt);
+	p_prof->velocity = 0;
+	p_prof->to_velocity = 1.0 / ((1 << MP_FRAC_BITS) * counts_per_m * dt);
+
+	if(p_prof->accel < 1) {
+		p_prof->accel = 1;
+	}
+	if(p_prof->v_min > p_prof->v_max) {
+		p_prof->v_min = p_prof->v_max;
+	}
+
+	// Beyond this the braking speed is above v_max, also keeps 2*a*d in range
+	p_prof->brake_limit = (p_prof->v_max * p_prof->v_max) / (2 * p_prof->accel) + 1;
+
+	p_prof->done = (p_prof->target == 0);
+}
+
+/**
+ * Function Motion_Profile_Step advances the profile one control tick. travelled is the signed encoder count
+ * since the move started. Returns the speed setpoint in m/s (always positive, see Motion_Profile_t.direction),
+ * zero once the target is reached.
+ */
+float Motion_Profile_Step(Motion_Profile_t* p_prof, int32_t travelled) {
+	int32_t remaining = p_prof->target - (travelled * p_prof->direction) * (1 << MP_FRAC_BITS);
+
+	if(p_prof->done || remaining <= 0) {
+		p_prof->done = true;
+		p_prof->velocity = 0;
+		return 0;
+	}
+
+	// Accelerate up to cruise speed
+	int32_t v = p_prof->velocity + p_prof->accel;
+	if(v > p_prof->v_max) {
+		v = p_prof->v_max;
+	}
+
+	// Brake to arrive at the target
+	if(remaining < p_prof->brake_limit) {
+		int32_t v_stop = ISqrt(2 * (uint32_t)p_prof->accel * (uint32_t)remaining);
+		if(v > v_stop) {
+			v = v_stop;
+		}
+	}
+
+	if(v < p_prof->v_min) {
+		v = p_prof->v_min;
+	}
+
+	p_prof->velocity = v;
+
+	return v * p_prof->to_velocity;
+}
+
+/**
+ * Function Motion_Profile_Duration returns the time [ms] the profile plans for its move from rest: ramp up,
+ * cruise and brake, or ramp up and brake if it never reaches cruise speed. The creep at the end is not
+ * included. update_period is the control tick in ms.
+ */
+float Motion_Profile_Duration(const Motion_Profile_t* p_prof, float update_period) {
+	float ticks;
+	float ramp = (float)p_prof->v_max / p_prof->accel;
+
+	if(p_prof->target >= ramp * p_prof->v_max) {
+		ticks = (float)p_prof->target / p_prof->v_max + ramp;
+	}
+	else {
+		ticks = 2 * ISqrt(p_prof->target / p_prof->accel);
+	}
+
+	return ticks * update_period;
+}
+
+/**
+ * Function Motion_Profile_Done returns true once the target distance has been covered
+ */
+bool Motion_Profile_Done(const Motion_Profile_t* p_prof) {
+	return p_prof->done;
+}
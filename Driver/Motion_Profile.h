@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Motion_Profile.h/c generates acceleration limited (trapezoidal) velocity
+ * setpoints for a wheel that has to cover a set distance. Each control tick
+ * the profile is stepped with the encoder counts travelled so far; the
+ * returned speed ramps up at the set acceleration, cruises at the set
+ * speed and brakes so the wheel arrives at the target instead of being cut
+ * off at full speed.
+ *
+ * The braking speed comes from the remaining distance, v = sqrt(2*a*d), so
+ * the profile corrects itself if the wheel runs ahead or behind. Near the
+ * end the speed is held at a small creep speed so the wheel still reaches
+ * the target against friction.
+ *
+ * Steps are done in fixed point, 8 fraction bits, with distances in encoder
+ * counts and time in control ticks, so no float math runs per tick except
+ * the final conversion to m/s for the velocity controllers.
+ */
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "MotorPWM.h"
+
+#define MP_FRAC_BITS	8
+
+typedef struct {
+	int32_t target;		///<-- distance to cover [counts << MP_FRAC_BITS], always positive
+	int32_t velocity;	///<-- current speed setpoint [counts/tick << MP_FRAC_BITS]
+	int32_t v_max;		///<-- cruise speed [counts/tick << MP_FRAC_BITS]
+	int32_t v_min;		///<-- creep speed [counts/tick << MP_FRAC_BITS]
+	int32_t accel;		///<-- acceleration [counts/tick^2 << MP_FRAC_BITS]
+	int32_t brake_limit;	///<-- past this remaining distance braking can't limit the speed
+	float to_velocity;	///<-- converts the fixed point speed to m/s
+	int8_t direction;	///<-- +1 forward, -1 backward
+	bool done;
+} Motion_Profile_t;
+
+/**
+ * Motion profiles for the left and right motors
+ */
+Motion_Profile_t mp_LeftMotor;
+Motion_Profile_t mp_RightMotor;
+
+/**
+ * Function Motion_Profile_Init sets up a profile to cover distance [m] (signed) starting from rest.
+ * speed [m/s], accel [m/s^2] and creep [m/s] are magnitudes, update_period is the control tick in ms.
+ */
+void Motion_Profile_Init(Motion_Profile_t* p_prof, float distance, float speed, float accel, float creep,
+		float update_period);
+
+/**
+ * Function Motion_Profile_Step advances the profile one control tick. travelled is the signed encoder count
+ * since the move started. Returns the speed setpoint in m/s (always positive, see Motion_Profile_t.direction),
+ * zero once the target is reached.
+ */
+float Motion_Profile_Step(Motion_Profile_t* p_prof, int32_t travelled);
+
+/**
+ * Function Motion_Profile_Duration returns the time [ms] the profile plans for its move from rest, without the
+ * creep at the end. update_period is the control tick in ms.
+ */
+float Motion_Profile_Duration(const Motion_Profile_t* p_prof, float update_period);
+
+/**
+ * Function Motion_Profile_Done returns true once the target distance has been covered
+ */
+bool Motion_Profile_Done(const Motion_Profile_t* p_prof);
+
+#endif
@@ -1,5 +1,7 @@
 #include "MotorPWM.h"
 
+static float distance_per_count = DISTANCE_PER_COUNT;
+
 /**
  * Function MotorPWM_Init initializes the motor PWM on Timer 1 for PWM based voltage control of the motors.
  * The Motor PWM system shall initialize in the disabled state for safety reasons. You should specifically enable
@@ -64,6 +66,8 @@ bool Is_Motor_PWM_Enabled()
  */
 void Motor_PWM_Left( int16_t pwm )
 {
+	Trace_PWM(TRACE_PWM_LEFT, pwm);
+
 	// Set motor direction pins
 	if(pwm < 0)
 	{
@@ -89,6 +93,8 @@ void Motor_PWM_Left( int16_t pwm )
  */
 void Motor_PWM_Right( int16_t pwm )
 {
+	Trace_PWM(TRACE_PWM_RIGHT, pwm);
+
 	// Set motor direction pins
 	if(pwm < 0)
 	{
@@ -170,5 +176,9 @@ int Velocity_to_DutyCycle_Right(float velocity) {
 }
 
 float ECount_to_Distance(int encoder_count) {
-	return ((float)encoder_count * 2 * PI * 0.0195) / (12 * 75.81);
+	return (float)encoder_count * distance_per_count;
+}
+
+void Set_Distance_Per_Count(float distance) {
+	distance_per_count = distance;
 }
@@ -58,6 +58,7 @@
 #include <stdbool.h>       // For bool
 
 #include "driver_defines.h"
+#include "Trace.h"
 
 /**
  * Function MotorPWM_Init initializes the motor PWM on Timer 1 for PWM based voltage control of the motors.
@@ -127,4 +128,12 @@ int Velocity_to_DutyCycle_Left(float velocity);
 int Velocity_to_DutyCycle_Right(float velocity);
 float ECount_to_Distance(int encoder_count);
 
+/*
+ * Wheel travel per encoder count: 19.5 mm sprocket radius, 12 counts per
+ * motor revolution, 75.81:1 gearbox [m]. Set_Distance_Per_Count replaces it
+ * with a calibrated value (see Application/Params.h).
+ */
+#define DISTANCE_PER_COUNT	(2 * PI * 0.0195 / (12 * 75.81))
+void Set_Distance_Per_Count(float distance);
+
 #endif
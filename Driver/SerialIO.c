@@ -268,6 +268,11 @@ void usb_read_next_byte()
 			data = Endpoint_Read_8();
 			if(!clear_buffer)
 			{
+				// A full buffer drops its oldest byte
+				if(rb_length_C(&_usb_receive_buffer) == RB_LENGTH_C - 1)
+				{
+					Trace_Write(TRACE_RX_OVERFLOW, 0);
+				}
 				// Store byte in receive buffer
 				rb_push_back_C(&_usb_receive_buffer, (char)data);
 			}
@@ -402,6 +407,52 @@ void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len )
 	usb_send_data(p_data, data_len);
 }
 
+/**
+ * (blocking) Function usb_send_msg_bulk sends a message in the same format as usb_send_msg, but writes it straight
+ * to the USB endpoint in full packets instead of a byte per pass through the output ring buffer. Use it for large
+ * one-off transfers; anything already in the ring buffer is sent first so messages stay in order.
+ * @return [bool] False if the host stopped reading (LUFA's stream timeout) or USB isn't configured.
+ */
+bool usb_send_msg_bulk(char* format, char cmd, void* p_data, uint8_t data_len )
+{
+	if (USB_DeviceState != DEVICE_STATE_Configured)
+		return false;
+
+	// Drain the ring buffer first
+	while(rb_length_C(&_usb_send_buffer))
+	{
+		Endpoint_SelectEndpoint(CDC_TX_EPADDR);
+		if(Endpoint_WaitUntilReady() != ENDPOINT_READYWAIT_NoError)
+			return false;
+		usb_write_next_byte();
+	}
+
+	uint8_t format_len = strlen(format) + 1;
+	uint8_t len = 1 + format_len + data_len;
+
+	Endpoint_SelectEndpoint(CDC_TX_EPADDR);
+	uint8_t error = Endpoint_Write_Stream_LE(&len, 1, NULL);
+	if(error == ENDPOINT_RWSTREAM_NoError)
+		error = Endpoint_Write_Stream_LE(format, format_len, NULL);
+	if(error == ENDPOINT_RWSTREAM_NoError)
+		error = Endpoint_Write_Stream_LE(&cmd, 1, NULL);
+	if(error == ENDPOINT_RWSTREAM_NoError)
+		error = Endpoint_Write_Stream_LE(p_data, data_len, NULL);
+	if(error != ENDPOINT_RWSTREAM_NoError)
+		return false;
+
+	// Send the last partial packet, a full one needs an empty packet after it to end the transfer
+	bool full = (Endpoint_BytesInEndpoint() == CDC_TXRX_EPSIZE);
+	Endpoint_ClearIN();
+	if(full)
+	{
+		Endpoint_WaitUntilReady();
+		Endpoint_ClearIN();
+	}
+
+	return true;
+}
+
 /**
  * (non-blocking) Funtion usb_msg_length returns the number of bytes in the receive buffer awaiting processing.
  * @return [uint8_t] Number of bytes ready for processing.
@@ -67,6 +67,7 @@
 // *** MEGN540  ***
 // Include your Ring_Buffer homework code.
 #include "Ring_Buffer.h"
+#include "Trace.h"
 
 /* LUFA Specific Function Prototypes: */
 void USB_SetupHardware(void);  // You'll need to add in any initialization items to this function for your ring buffers
@@ -136,6 +137,14 @@ void usb_send_str(char* p_str);
  */
 void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len );
 
+/**
+ * (blocking) Function usb_send_msg_bulk sends a message in the same format as usb_send_msg, but writes it straight
+ * to the USB endpoint in full packets instead of a byte per pass through the output ring buffer. Use it for large
+ * one-off transfers; anything already in the ring buffer is sent first so messages stay in order.
+ * @return [bool] False if the host stopped reading (LUFA's stream timeout) or USB isn't configured.
+ */
+bool usb_send_msg_bulk(char* format, char cmd, void* p_data, uint8_t data_len );
+
 /**
  * (non-blocking) Funtion usb_msg_length returns the number of bytes in the receive buffer awaiting processing.
  * @return [uint8_t] Number of bytes ready for processing.
@@ -1,8 +1,29 @@
 #include "ServoPWM.h"
 
+// Ramp state, positions in percent
+static float position;
+static uint8_t target;
+static float speed;
+static float settle_time;
+static bool settled;
+
+/*
+ * Writes the pulse width for a position to the 10-bit compare register
+ */
+static void Set_Pulse(float pos) {
+	uint16_t count = DUTY_CYCLE_OPEN + (uint16_t)(pos * (DUTY_CYCLE_CLOSED - DUTY_CYCLE_OPEN) / 100.0 + 0.5);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	// High bits go through TC4H
+	TC4H = count >> 8;
+	OCR4A = count & 0xFF;
+	SREG = oldSREG;
+}
+
 /**
  * Function Servo_PWM_Init initializes a PWM signal on Timer 4 for the gripper
- * servo motor.
+ * servo motor. The servo is put straight at the given state, without a ramp.
  */
 void Servo_PWM_Init(eGripperState state)
 {
@@ -10,9 +31,9 @@ void Servo_PWM_Init(eGripperState state)
 	TCCR4A |= 0b10000010;
 	TCCR4A &= ~(0b01000000);
 
-	// Enable clock with prescaler of 2048
+	// Enable clock with prescaler of 512
 	TCCR4B &= ~(0x0F);
-	TCCR4B |= (0x0C);
+	TCCR4B |= (0x0A);
 
 	// Set PWM fast-mode
 	TCCR4D &= ~(0b00000011);
@@ -20,58 +41,89 @@ void Servo_PWM_Init(eGripperState state)
 	// Set DDR pin to write for OC4A -> PC7
 	DDRC |= (1 << DDC7);
 
-	if(state == OPEN) {
-		// Set compare value
-		OCR4A = DUTY_CYCLE_OPEN;
-		Set_LEDs(OPEN);
-	}
-	else {
-		// Set compare value
-		OCR4A = DUTY_CYCLE_CLOSED;
-		Set_LEDs(CLOSE);
-	}
-
 	// Configure timer
 	uint8_t oldSREG = SREG;
 	cli();
 	// Set TOP value
-	OCR4C = MAX_PWM;
+	TC4H = MAX_PWM >> 8;
+	OCR4C = MAX_PWM & 0xFF;
 	// Clear timer
+	TC4H = 0;
 	TCNT4 = 0;
-	TC4H &= ~(0x07);
 	SREG = oldSREG;
+
+	target = (state == OPEN) ? SERVO_OPEN_POS : SERVO_CLOSED_POS;
+	position = target;
+	speed = SERVO_SPEED;
+	settled = true;
+	Set_Pulse(position);
+	Set_LEDs(state);
 }
 
 /**
- * Function Close_Servo sets the PWM duty cycle for the servo to close.
+ * Function Servo_Move starts a ramp to position [%] at speed [%/s]. A speed of
+ * zero uses SERVO_SPEED.
  */
-void Close_Servo()
+void Servo_Move(uint8_t pos, float new_speed)
 {
-	// Configure timer
-	uint8_t oldSREG = SREG;
-	cli();
-	// Set compare value
-	OCR4A = DUTY_CYCLE_MAX;
-	SREG = oldSREG;
+	target = (pos > SERVO_CLOSED_POS) ? SERVO_CLOSED_POS : pos;
+	speed = (new_speed > 0) ? new_speed : SERVO_SPEED;
+	settle_time = 0;
+	settled = false;
+}
+
+/**
+ * Function Servo_Step advances the ramp by dt seconds. Returns true while the
+ * servo is still moving or settling.
+ */
+bool Servo_Step(float dt)
+{
+	if(settled) {
+		return false;
+	}
+
+	if(position != target) {
+		float step = speed * dt;
+		float error = target - position;
 
-	// Set LEDs
-	Set_LEDs(CLOSE);
+		if(error > step) {
+			position += step;
+		}
+		else if(error < -step) {
+			position -= step;
+		}
+		else {
+			position = target;
+		}
+
+		Set_Pulse(position);
+	}
+	else {
+		// Give the servo time to catch up with the pulse
+		settle_time += dt;
+		if(settle_time >= SERVO_SETTLE_TIME) {
+			settled = true;
+			Set_LEDs(Servo_Is_Closed() ? CLOSE : OPEN);
+		}
+	}
+
+	return !settled;
 }
 
 /**
- * Function Open_Servo sets the PWM duty cycle for the servo to open.
+ * Function Close_Servo starts a ramp to the closed position.
  */
-void Open_Servo()
+void Close_Servo()
 {
-	// Configure timer
-	uint8_t oldSREG = SREG;
-	cli();
-	// Set compare value
-	OCR4A = DUTY_CYCLE_MIN;
-	SREG = oldSREG;
+	Servo_Move(SERVO_CLOSED_POS, 0);
+}
 
-	// Set LEDs
-	Set_LEDs(OPEN);
+/**
+ * Function Open_Servo starts a ramp to the open position.
+ */
+void Open_Servo()
+{
+	Servo_Move(SERVO_OPEN_POS, 0);
 }
 
 /**
@@ -79,7 +131,23 @@ void Open_Servo()
  */
 bool Servo_Is_Closed()
 {
-	return (OCR4A < (DUTY_CYCLE_MIN + 10));
+	return (position >= (SERVO_CLOSED_POS/2));
+}
+
+/**
+ * Function Servo_Is_Settled returns true once the last move has finished
+ */
+bool Servo_Is_Settled()
+{
+	return settled;
+}
+
+/**
+ * Function Servo_Position returns the commanded position [%]
+ */
+uint8_t Servo_Position()
+{
+	return (uint8_t)(position + 0.5);
 }
 
 /*
@@ -28,6 +28,14 @@
  * direction when the pulses are 1 ms long and 180 degrees in the opposite
  * direction when the pulses are 2 ms.
  *
+ * Timer 4 runs off clk/512 with a 10-bit TOP so each compare count is 32 us,
+ * giving a dozen steps between the open and closed grip. Moves are ramped:
+ * Servo_Move sets a target and a speed and Servo_Step, called every
+ * SERVO_UPDATE_PERIOD from the main loop, walks the pulse width toward it.
+ * Once the target is reached the servo is given SERVO_SETTLE_TIME to finish
+ * moving before it reports settled.
+ *
+ * Positions are in percent of the grip, 0 is open and 100 is closed.
  */
 #ifndef SERVO_PWM_H
 #define SERVO_PWM_H
@@ -38,30 +46,45 @@
 #include "driver_defines.h"
 #include "LED_switch.h"
 
-#define DUTY_CYCLE_MIN		8
-#define DUTY_CYCLE_MAX		16
-#define DUTY_CYCLE_OPEN		10
-#define DUTY_CYCLE_CLOSED	13
-#define MAX_PWM				156
+// Compare counts, 32 us each
+#define DUTY_CYCLE_MIN		32
+#define DUTY_CYCLE_MAX		64
+#define DUTY_CYCLE_OPEN		40
+#define DUTY_CYCLE_CLOSED	52
+#define MAX_PWM				624		// 20 ms period
+
+#define SERVO_OPEN_POS		0
+#define SERVO_CLOSED_POS	100
+#define SERVO_SPEED			300		// default ramp speed [%/s]
+#define SERVO_SETTLE_TIME	0.1		// [s]
+#define SERVO_UPDATE_PERIOD	20		// one PWM frame [ms]
 
 
 /**
  * Function Servo_PWM_Init initializes a PWM signal on Timer 4 for the gripper
- * servo motor.
+ * servo motor. The servo is put straight at the given state, without a ramp.
  */
 void Servo_PWM_Init(eGripperState state);
 
 /**
- * Function Close_Servo sets the PWM duty cycle for the servo to close.
- * NOTE: This functions DOES NOT work!
- * TODO: Fix me!
+ * Function Servo_Move starts a ramp to position [%] at speed [%/s]. A speed of
+ * zero uses SERVO_SPEED.
+ */
+void Servo_Move(uint8_t position, float speed);
+
+/**
+ * Function Servo_Step advances the ramp by dt seconds. Returns true while the
+ * servo is still moving or settling.
+ */
+bool Servo_Step(float dt);
+
+/**
+ * Function Close_Servo starts a ramp to the closed position.
  */
 void Close_Servo();
 
 /**
- * Function Open_Servo sets the PWM duty cycle for the servo to open.
- * NOTE: This functions DOES NOT work!
- * TODO: Fix me!
+ * Function Open_Servo starts a ramp to the open position.
  */
 void Open_Servo();
 
@@ -70,6 +93,16 @@ void Open_Servo();
  */
 bool Servo_Is_Closed();
 
+/**
+ * Function Servo_Is_Settled returns true once the last move has finished
+ */
+bool Servo_Is_Settled();
+
+/**
+ * Function Servo_Position returns the commanded position [%]
+ */
+uint8_t Servo_Position();
+
 /*
  * Set_LEDs configures the LEDs based on OPEN/CLOSED states
  */
@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Stack_Monitor.h"
+
+// Provided by the linker script: end of .bss and top of RAM
+extern uint8_t _end;
+extern uint8_t __stack;
+
+/*
+ * Paints from _end to the top of RAM. Runs in .init1, before __zero_reg__
+ * and the stack pointer are set up, so it is naked and written in assembly.
+ */
+void Stack_Paint() __attribute__((naked, used, section(".init1")));
+
+void Stack_Paint() {
+	__asm__ volatile(
+		"	ldi r30, lo8(_end)		\n"
+		"	ldi r31, hi8(_end)		\n"
+		"	ldi r24, %0				\n"
+		"	ldi r25, hi8(__stack)	\n"
+		"	rjmp 2f					\n"
+		"1:	st Z+, r24				\n"
+		"2:	cpi r30, lo8(__stack)	\n"
+		"	cpc r31, r25			\n"
+		"	brlo 1b					\n"
+		"	breq 1b					\n"
+		:: "M" (STACK_PAINT));
+}
+
+/**
+ * Function Stack_Get_Stats scans the painted region and returns the static RAM use and the stack's
+ * current and peak depth
+ */
+Stack_Stats_t Stack_Get_Stats() {
+	Stack_Stats_t stats;
+
+	// Count the paint the stack has not reached, starting from the bottom
+	const uint8_t* p = &_end;
+	while(p <= &__stack && *p == STACK_PAINT) {
+		p++;
+	}
+
+	stats.static_ram = (uintptr_t)&_end - RAMSTART;
+	stats.stack_size = &__stack + 1 - &_end;
+	stats.stack_peak = &__stack + 1 - p;
+	stats.stack_now = (uintptr_t)&__stack - SP;
+
+	return stats;
+}
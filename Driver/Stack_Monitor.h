@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Stack_Monitor.h/c measures how deep the stack has ever grown. Before
+ * main runs (in .init1, ahead of the C runtime setup) every byte between
+ * the end of the static variables and the top of RAM is painted with
+ * STACK_PAINT. The stack grows down into that region and overwrites the
+ * paint, so the painted bytes still left above the static variables are
+ * RAM the stack has never reached since reset.
+ *
+ * The firmware never uses the heap, so everything above _end belongs to
+ * the stack. A byte the stack happens to write with the paint value reads
+ * as unused; the peak can be low by that byte or two.
+ */
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define STACK_PAINT		0xC5
+
+typedef struct __attribute__((__packed__)) {
+	uint16_t static_ram;	///<-- .data plus .bss [bytes]
+	uint16_t stack_size;	///<-- RAM left for the stack [bytes]
+	uint16_t stack_peak;	///<-- deepest the stack has been since reset [bytes]
+	uint16_t stack_now;		///<-- current depth [bytes]
+} Stack_Stats_t;
+
+#ifdef CONFIG_STACK
+
+/**
+ * Function Stack_Get_Stats scans the painted region and returns the static RAM use and the stack's
+ * current and peak depth
+ */
+Stack_Stats_t Stack_Get_Stats();
+
+#endif
+
+#endif
@@ -101,13 +101,59 @@ float  GetTimeSec()
 	return time_seconds;
 }
 
+/**
+ * This function returns the time in raw Timer 0 ticks (4 us, 64 CPU cycles). The count wraps every 262 ms, so it is
+ * only meant for timing short stretches of code: subtract two readings. A pending millisecond is counted as in
+ * GetTimeMicros, or a reading just before the ISR could come out ahead of one just after it.
+ */
+uint16_t GetTicks()
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	uint16_t ms = _count_ms;
+	uint8_t ticks = TCNT0;
+	if((TIFR0 & (1 << OCF0B)) && ticks >= OCR0B)
+	{
+		ms++;
+		ticks -= OCR0B;
+	}
+	SREG = oldSREG;
+
+	// Timer 0 is reset every 250 ticks by the millisecond ISR
+	return ms * 250 + ticks;
+}
+
+/**
+ * This function returns the time since reset in microseconds. A millisecond that has passed while interrupts were
+ * off is counted from the pending compare flag, the timer has kept counting past OCR0B in the meantime.
+ */
+uint32_t GetTimeMicros()
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	uint32_t ms = _count_ms;
+	uint8_t ticks = TCNT0;
+	if((TIFR0 & (1 << OCF0B)) && ticks >= OCR0B)
+	{
+		ms++;
+		ticks -= OCR0B;
+	}
+	SREG = oldSREG;
+	return ms * 1000 + ticks * 4;
+}
+
 /**
  * These functions return the individual parts of the Time_t struct, useful if you only care about
  * things on second or millisecond resolution.
  */
 uint32_t GetMilli()
 {
-    return GetTime().millisec;
+	uint8_t oldSREG = SREG;
+	cli();
+	uint32_t ms = _count_ms;
+	SREG = oldSREG;
+
+	return ms;
 }
 
 uint16_t GetMicro()
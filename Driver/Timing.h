@@ -86,6 +86,20 @@ typedef struct { uint32_t millisec; uint16_t microsec; } Time_t;
 Time_t GetTime();
 float  GetTimeSec();
 
+/**
+ * This function returns the time in raw Timer 0 ticks (4 us, 64 CPU cycles). The count wraps every 262 ms, so it is
+ * only meant for timing short stretches of code: subtract two readings.
+ * @return
+ */
+uint16_t GetTicks();
+
+/**
+ * This function returns the time since reset in microseconds, at the timer's 4 us resolution. Unlike GetTime the
+ * two parts are read together, so it never steps back. Wraps every 71.6 minutes.
+ * @return
+ */
+uint32_t GetTimeMicros();
+
 /**
  * This function takes a start time and calculates the time since that time, it returns it in the Time struct.
  * @param p_time_start a pointer to a start time struct
@@ -0,0 +1,223 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include <avr/eeprom.h>
+
+#include "Trace.h"
+#include "SerialIO.h"
+
+typedef struct __attribute__((__packed__)) {
+	uint16_t magic;
+	uint8_t count;
+	uint32_t time;
+} t_TraceSnapshotHeader;
+
+// Snapshot lives at the very end of the EEPROM
+#define TRACE_EEPROM_RECORDS	((uint8_t*)(E2END + 1 - TRACE_LEN * sizeof(t_TraceRecord)))
+#define TRACE_EEPROM_HEADER		((uint8_t*)TRACE_EEPROM_RECORDS - sizeof(t_TraceSnapshotHeader))
+
+static const uint8_t TRACE_MASK = TRACE_LEN - 1;
+
+static t_TraceRecord trace[TRACE_LEN];
+static uint8_t head;		// next record to write
+static uint8_t count;
+static bool frozen;			// set while a snapshot is copied
+
+// Last logged PWM per side
+static int8_t last_pwm_left, last_pwm_right;
+
+// Snapshot progress, in bytes
+static uint16_t snapshot_index;
+static uint32_t snapshot_time;
+static bool snapshot_cleared;	// old header invalidated
+
+/*
+ * Returns the index of the i-th oldest record
+ */
+static uint8_t Record_Index(uint8_t i) {
+	return (head - count + i) & TRACE_MASK;
+}
+
+/**
+ * Function Trace_Init empties the trace and records a power up event
+ */
+void Trace_Init() {
+	head = 0;
+	count = 0;
+	frozen = false;
+	last_pwm_left = 0;
+	last_pwm_right = 0;
+
+	Trace_Write(TRACE_BOOT, 0);
+}
+
+/**
+ * Function Trace_Write appends an event. Only call it from the main loop, not from an ISR.
+ */
+void Trace_Write(eTraceEvent event, uint8_t arg) {
+	if(frozen) {
+		return;
+	}
+
+	t_TraceRecord* p_rec = &trace[head];
+	p_rec->time = (uint16_t)GetMilli();
+	p_rec->event = event;
+	p_rec->arg = arg;
+
+	head = (head + 1) & TRACE_MASK;
+	if(count < TRACE_LEN) {
+		count++;
+	}
+}
+
+/**
+ * Function Trace_PWM logs a PWM change for the given side ('L' or 'R') if it moved enough to be worth a record
+ */
+void Trace_PWM(eTraceEvent side, int16_t pwm) {
+	int8_t* p_last = (side == TRACE_PWM_LEFT) ? &last_pwm_left : &last_pwm_right;
+	int8_t value = (pwm > 100) ? 100 : (pwm < -100) ? -100 : pwm;
+	int8_t change = value - *p_last;
+
+	if(change >= TRACE_PWM_STEP || change <= -TRACE_PWM_STEP || (value == 0 && *p_last != 0)) {
+		*p_last = value;
+		Trace_Write(side, (uint8_t)value);
+	}
+}
+
+/**
+ * Function Trace_Snapshot_Start freezes the trace and starts copying it to EEPROM. Returns false if snapshots
+ * are compiled out or one is already running.
+ */
+bool Trace_Snapshot_Start() {
+	if(!TRACE_EEPROM_SNAPSHOT || frozen) {
+		return false;
+	}
+
+	frozen = true;
+	snapshot_index = 0;
+	snapshot_time = GetMilli();
+	snapshot_cleared = false;
+
+	return true;
+}
+
+/**
+ * Function Trace_Snapshot_Task writes the next byte of the snapshot once the EEPROM is ready. Returns true while
+ * the copy is in progress.
+ */
+bool Trace_Snapshot_Task() {
+	if(!frozen) {
+		return false;
+	}
+
+	if(!eeprom_is_ready()) {
+		return true;
+	}
+
+	// Break the old header's magic before any record is overwritten
+	if(!snapshot_cleared) {
+		eeprom_update_byte(TRACE_EEPROM_HEADER, (uint8_t)~TRACE_MAGIC);
+		snapshot_cleared = true;
+		return true;
+	}
+
+	if(snapshot_index < count * sizeof(t_TraceRecord)) {
+		// Records are stored oldest first
+		uint8_t rec = snapshot_index / sizeof(t_TraceRecord);
+		uint8_t byte = snapshot_index % sizeof(t_TraceRecord);
+		uint8_t* p_src = (uint8_t*)&trace[Record_Index(rec)];
+
+		eeprom_update_byte(TRACE_EEPROM_RECORDS + snapshot_index, p_src[byte]);
+		snapshot_index++;
+		return true;
+	}
+
+	// Header last, marks the snapshot valid
+	t_TraceSnapshotHeader header =
+	{
+			.magic = TRACE_MAGIC,
+			.count = count,
+			.time = snapshot_time
+	};
+	eeprom_update_block(&header, TRACE_EEPROM_HEADER, sizeof(header));
+
+	frozen = false;
+	return false;
+}
+
+/**
+ * Function Trace_Dump sends the trace (or the EEPROM snapshot) to the host. Returns false if there is no valid
+ * snapshot or the host isn't reading.
+ */
+bool Trace_Dump(bool snapshot) {
+	struct __attribute__((__packed__)) {
+		uint8_t source;
+		uint8_t chunk;
+		uint8_t count;
+		uint32_t time;
+		t_TraceRecord records[TRACE_CHUNK];
+	} data;
+
+	data.source = snapshot;
+
+	if(snapshot) {
+		t_TraceSnapshotHeader header;
+		eeprom_read_block(&header, TRACE_EEPROM_HEADER, sizeof(header));
+		if(header.magic != TRACE_MAGIC || header.count > TRACE_LEN) {
+			return false;
+		}
+		data.count = header.count;
+		data.time = header.time;
+	}
+	else {
+		data.count = count;
+		data.time = GetMilli();
+	}
+
+	for(uint8_t chunk = 0; chunk < TRACE_LEN / TRACE_CHUNK; chunk++) {
+		data.chunk = chunk;
+
+		for(uint8_t i = 0; i < TRACE_CHUNK; i++) {
+			uint8_t rec = chunk * TRACE_CHUNK + i;
+			t_TraceRecord* p_rec = &data.records[i];
+
+			if(rec >= data.count) {
+				p_rec->time = 0;
+				p_rec->event = 0;
+				p_rec->arg = 0;
+			}
+			else if(snapshot) {
+				eeprom_read_block(p_rec, TRACE_EEPROM_RECORDS + rec * sizeof(t_TraceRecord), sizeof(t_TraceRecord));
+			}
+			else {
+				*p_rec = trace[Record_Index(rec)];
+			}
+		}
+
+		if(!usb_send_msg_bulk("cBBBI64s", 'l', &data, sizeof(data))) {
+			return false;
+		}
+	}
+
+	return true;
+}
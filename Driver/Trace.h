@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Trace.h/c is a flight recorder: a small ring buffer of timestamped events
+ * kept in SRAM so what happened before the host connected can be read back.
+ * A record is 4 bytes, the low 16 bits of the millisecond clock, an event
+ * code and one argument byte:
+ *
+ *      'P' power up            -
+ *      'C' command received    command char
+ *      'O' obstacle avoidance  new eOADSM state
+ *      'L' / 'R' PWM change    new left / right duty cycle [%] (int8)
+ *      'B' low battery trip    battery voltage [50 mV]
+ *      'X' USB RX overflow     -
+ *
+ * PWM is only logged when it moves by TRACE_PWM_STEP or stops, so the
+ * control loop doesn't flush the buffer every tick.
+ *
+ * On a fault the buffer can be copied to the end of the EEPROM. The copy is
+ * written a byte per main loop pass, so it doesn't stall the loop, and the
+ * recorder is frozen until it is done. The old header is invalidated first
+ * and the new one written last, so an interrupted copy is not reported as
+ * valid.
+ *
+ * The trace is dumped with the 'l' command in TRACE_LEN/TRACE_CHUNK messages,
+ * format "cBBBI64s":
+ *      'l', source (0 SRAM, 1 EEPROM), chunk, record count, time [ms], records
+ *
+ * Records are oldest first; time is the full millisecond clock when the dump
+ * (or snapshot) was taken, for unwrapping the 16-bit record times.
+ * User/trace_decode.py reads and prints them.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Timing.h"
+
+#define TRACE_LEN		64		// must be a power of 2
+#define TRACE_CHUNK		16		// records per dump message
+#define TRACE_PWM_STEP	5		// [%]
+#define TRACE_MAGIC		0x7ACE
+
+#ifndef TRACE_EEPROM_SNAPSHOT
+#define TRACE_EEPROM_SNAPSHOT	1
+#endif
+
+typedef enum
+{
+	TRACE_BOOT = 'P',
+	TRACE_COMMAND = 'C',
+	TRACE_OA_STATE = 'O',
+	TRACE_PWM_LEFT = 'L',
+	TRACE_PWM_RIGHT = 'R',
+	TRACE_LOW_BATTERY = 'B',
+	TRACE_RX_OVERFLOW = 'X'
+} eTraceEvent;
+
+typedef struct __attribute__((__packed__)) {
+	uint16_t time;
+	uint8_t event;
+	uint8_t arg;
+} t_TraceRecord;
+
+#ifdef CONFIG_TRACE
+
+/**
+ * Function Trace_Init empties the trace and records a power up event
+ */
+void Trace_Init();
+
+/**
+ * Function Trace_Write appends an event. Only call it from the main loop, not from an ISR.
+ */
+void Trace_Write(eTraceEvent event, uint8_t arg);
+
+/**
+ * Function Trace_PWM logs a PWM change for the given side ('L' or 'R') if it moved enough to be worth a record
+ */
+void Trace_PWM(eTraceEvent side, int16_t pwm);
+
+/**
+ * Function Trace_Snapshot_Start freezes the trace and starts copying it to EEPROM. Returns false if snapshots
+ * are compiled out or one is already running.
+ */
+bool Trace_Snapshot_Start();
+
+/**
+ * Function Trace_Snapshot_Task writes the next byte of the snapshot once the EEPROM is ready. Returns true while
+ * the copy is in progress.
+ */
+bool Trace_Snapshot_Task();
+
+/**
+ * Function Trace_Dump sends the trace (or the EEPROM snapshot) to the host. Returns false if there is no valid
+ * snapshot or the host isn't reading.
+ */
+bool Trace_Dump(bool snapshot);
+
+#else
+
+// Built without the flight recorder (CONFIG_TRACE=n), the hooks compile away
+static inline void Trace_Init() {}
+static inline void Trace_Write(eTraceEvent event, uint8_t arg) { (void)event; (void)arg; }
+static inline void Trace_PWM(eTraceEvent side, int16_t pwm) { (void)side; (void)pwm; }
+static inline bool Trace_Snapshot_Start() { return false; }
+static inline bool Trace_Snapshot_Task() { return false; }
+static inline bool Trace_Dump(bool snapshot) { (void)snapshot; return false; }
+
+#endif
+
+#endif
@@ -8,10 +8,14 @@
 #include "driver_defines.h"
 #include "Encoder.h"
 #include "Filter.h"
+#include "Idle.h"
 #include "LED_switch.h"
+#include "Motion_Profile.h"
 #include "MotorPWM.h"
 #include "Proximity.h"
 #include "Ring_Buffer.h"
 #include "SerialIO.h"
 #include "ServoPWM.h"
+#include "Stack_Monitor.h"
 #include "Timing.h"
+#include "Trace.h"
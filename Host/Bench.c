@@ -0,0 +1,351 @@
+/*
+ * Bench.c times the firmware's hot kernels natively so a change to one of
+ * them can be compared before and after without a robot:
+ *
+ *      rb_C push/pop       one byte through the command/USB ring buffer
+ *      rb_C burst          a 32 byte burst in and out, per byte
+ *      rb_F push/pop       one sample through the filter ring buffer
+ *      filter order N      Filter_Value, N = 1 (the controllers), 2 to 6 and 7 (the max)
+ *      controller          Controller_Update with the coefficients from Main.c
+ *      msg <cmd>           one command fed to Message_Handling_Task and parsed
+ *      msg stream          the whole command mix back to back
+ *
+ * Every kernel is run for at least BENCH_MIN_TIME and the best of
+ * BENCH_REPEATS runs is reported in ns per operation, together with the
+ * heap allocations per operation (the firmware should never allocate; the
+ * bench is linked with -Wl,--wrap for malloc and friends to prove it).
+ *
+ * Workstation timings only rank changes against each other. For AVR
+ * numbers use 'make bench-size' for code size and the on-board task
+ * profiler (the 'h' command) for cycle counts.
+ *
+ * Usage: Bench [name ...]
+ *      Only run kernels whose name contains one of the given strings.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MEGN540_MessageHandeling.h"
+#include "Profiler.h"
+
+#define BENCH_MIN_TIME	0.02	// [s] per timed run
+#define BENCH_REPEATS	5
+
+/*
+ * Allocation counting. The linker routes the firmware's calls here.
+ */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+
+static unsigned long allocations;
+
+void* __wrap_malloc(size_t size) {
+	allocations++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+	allocations++;
+	return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+	allocations++;
+	return __real_realloc(p, size);
+}
+
+/*
+ * Kernels. Each runs its operation n times; results go to the sink so the
+ * compiler can't drop the work.
+ */
+static volatile float sink;
+
+typedef struct {
+	const char* name;
+	void (*setup)();
+	void (*run)(unsigned long n);
+} t_Kernel;
+
+static struct Ring_Buffer_C rb_c;
+static struct Ring_Buffer_F rb_f;
+
+static void Setup_RB() {
+	rb_initialize_C(&rb_c);
+	rb_initialize_F(&rb_f);
+}
+
+static void Run_RB_C(unsigned long n) {
+	char acc = 0;
+	for(unsigned long i = 0; i < n; i++) {
+		rb_push_back_C(&rb_c, (char)i);
+		acc ^= rb_pop_front_C(&rb_c);
+	}
+	sink = acc;
+}
+
+#define BURST	32
+
+static void Run_RB_C_Burst(unsigned long n) {
+	char acc = 0;
+	for(unsigned long i = 0; i < n; i += BURST) {
+		for(uint8_t j = 0; j < BURST; j++) {
+			rb_push_back_C(&rb_c, (char)j);
+		}
+		while(rb_length_C(&rb_c)) {
+			acc ^= rb_pop_front_C(&rb_c);
+		}
+	}
+	sink = acc;
+}
+
+static void Run_RB_F(unsigned long n) {
+	float acc = 0;
+	for(unsigned long i = 0; i < n; i++) {
+		rb_push_back_F(&rb_f, (float)i);
+		acc += rb_pop_front_F(&rb_f);
+	}
+	sink = acc;
+}
+
+// Moving average, as in the Filter_Init example
+static Filter_Data_t filter;
+static float filt_num[RB_LENGTH_F];
+static float filt_den[RB_LENGTH_F];
+
+static void Setup_Filter_Order(uint8_t order) {
+	for(uint8_t i = 0; i <= order; i++) {
+		filt_num[i] = 1;
+		filt_den[i] = 0;
+	}
+	filt_den[0] = order + 1;
+	Filter_Init(&filter, filt_num, filt_den, order);
+}
+
+static void Setup_Filter_1() {
+	Setup_Filter_Order(1);
+}
+
+static void Setup_Filter_2() {
+	Setup_Filter_Order(2);
+}
+
+static void Setup_Filter_3() {
+	Setup_Filter_Order(3);
+}
+
+static void Setup_Filter_4() {
+	Setup_Filter_Order(4);
+}
+
+static void Setup_Filter_5() {
+	Setup_Filter_Order(5);
+}
+
+static void Setup_Filter_6() {
+	Setup_Filter_Order(6);
+}
+
+static void Setup_Filter_7() {
+	Setup_Filter_Order(RB_LENGTH_F - 1);
+}
+
+static void Run_Filter(unsigned long n) {
+	float acc = 0;
+	for(unsigned long i = 0; i < n; i++) {
+		acc = Filter_Value(&filter, (float)(i & 0xFF));
+	}
+	sink = acc;
+}
+
+// Left motor controller from Main.c
+#define KP_L		0.1875335
+
+static float ctr_num[] = {0.187533508705,	0.124897316798};
+static float ctr_den[] = {1.000000000000,	-1.000000000000};
+static Controller_t controller;
+
+static void Setup_Controller() {
+	Controller_Init(&controller, KP_L, ctr_num, ctr_den, 1, 10);
+	Controller_Set_Target_Velocity(&controller, 0.3);
+}
+
+static void Run_Controller(unsigned long n) {
+	float acc = 0;
+	for(unsigned long i = 0; i < n; i++) {
+		acc = Controller_Update(&controller, (float)(i & 0x3F), 0.01);
+	}
+	sink = acc;
+}
+
+/*
+ * Message parsing. Commands are packed exactly as the host sends them,
+ * with the payload structs from MEGN540_Protocol.h.
+ */
+typedef struct {
+	uint8_t len;
+	uint8_t data[RB_LENGTH_C];
+} t_Command;
+
+static t_Command Make_Command(char cmd, const void* p_data, uint8_t data_len) {
+	t_Command command;
+	command.data[0] = cmd;
+	if(data_len) {
+		memcpy(&command.data[1], p_data, data_len);
+	}
+	command.len = 1 + data_len;
+	return command;
+}
+
+static t_Command commands[16];
+static uint8_t num_commands;
+static uint8_t selected;
+static unsigned long bytes_out;
+
+static void Setup_Messages() {
+	t_Msg_Multiply operands = { 3.5, 1.25 };
+	t_Msg_Velocity velocity = { 0.2, 1.0 };
+	t_Msg_Pwm pwm = { 100, -100 };
+	t_TrajSegment segment = { TRAJ_LINE, 0.5, 0, 0 };
+	char clear = 'C';
+	char open = 'O';
+
+	num_commands = 0;
+	commands[num_commands++] = Make_Command('*', &operands, sizeof(operands));
+	commands[num_commands++] = Make_Command('/', &operands, sizeof(operands));
+	commands[num_commands++] = Make_Command('+', &operands, sizeof(operands));
+	commands[num_commands++] = Make_Command('p', &pwm, sizeof(pwm));
+	commands[num_commands++] = Make_Command('v', &velocity, sizeof(velocity));
+#ifdef CONFIG_TELEOP
+	commands[num_commands++] = Make_Command('j', &velocity, sizeof(velocity));
+#endif
+	commands[num_commands++] = Make_Command('s', NULL, 0);
+	commands[num_commands++] = Make_Command('W', &segment, sizeof(segment));
+	commands[num_commands++] = Make_Command('w', &clear, sizeof(clear));
+	commands[num_commands++] = Make_Command('G', &open, sizeof(open));
+
+	usb_init_buffers();
+	Message_Handling_Init();
+	Trajectory_Init();
+	Controller_Init(&ctr_LeftMotor, KP_L, ctr_num, ctr_den, 1, 10);
+	Controller_Init(&ctr_RightMotor, KP_L, ctr_num, ctr_den, 1, 10);
+	bytes_out = 0;
+}
+
+static void Parse(const t_Command* p_command) {
+	// Keep 'W' on the accept path rather than timing the queue-full reply
+	if(Trajectory_Length() == TRAJ_QUEUE_LEN) {
+		Trajectory_Init();
+	}
+
+	Host_USB_Feed(p_command->data, p_command->len);
+	while(usb_msg_length()) {
+		Message_Handling_Task();
+	}
+	bytes_out += Host_USB_Drain();
+}
+
+static void Run_Message(unsigned long n) {
+	for(unsigned long i = 0; i < n; i++) {
+		Parse(&commands[selected]);
+	}
+}
+
+static void Run_Stream(unsigned long n) {
+	for(unsigned long i = 0; i < n; i++) {
+		Parse(&commands[i % num_commands]);
+	}
+}
+
+static const t_Kernel kernels[] = {
+	{ "rb_C push/pop", Setup_RB, Run_RB_C },
+	{ "rb_C burst", Setup_RB, Run_RB_C_Burst },
+	{ "rb_F push/pop", Setup_RB, Run_RB_F },
+	{ "filter order 1", Setup_Filter_1, Run_Filter },
+	{ "filter order 2", Setup_Filter_2, Run_Filter },
+	{ "filter order 3", Setup_Filter_3, Run_Filter },
+	{ "filter order 4", Setup_Filter_4, Run_Filter },
+	{ "filter order 5", Setup_Filter_5, Run_Filter },
+	{ "filter order 6", Setup_Filter_6, Run_Filter },
+	{ "filter order 7", Setup_Filter_7, Run_Filter },
+	{ "controller", Setup_Controller, Run_Controller },
+};
+
+#define NUM_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+static double Now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool Selected(const char* name, int argc, char** argv) {
+	if(argc < 2) {
+		return true;
+	}
+	for(int i = 1; i < argc; i++) {
+		if(strstr(name, argv[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Bench_Kernel grows the operation count until a run takes BENCH_MIN_TIME,
+ * then reports the best of BENCH_REPEATS runs of that length
+ */
+static void Bench_Kernel(const char* name, void (*setup)(), void (*run)(unsigned long n)) {
+	unsigned long n = 1;
+	double elapsed = 0;
+	while(elapsed < BENCH_MIN_TIME) {
+		n *= 2;
+		setup();
+		double start = Now();
+		run(n);
+		elapsed = Now() - start;
+	}
+
+	double best = elapsed;
+	allocations = 0;
+	for(int r = 0; r < BENCH_REPEATS; r++) {
+		setup();
+		double start = Now();
+		run(n);
+		elapsed = Now() - start;
+		if(elapsed < best) best = elapsed;
+	}
+
+	printf("%-20s %10lu %10.1f %10.2f", name, n, best / n * 1e9,
+			(double)allocations / (n * BENCH_REPEATS));
+	if(run == Run_Message || run == Run_Stream) {
+		printf(" %10.1f", (double)bytes_out / n);
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv) {
+	printf("%-20s %10s %10s %10s %10s\n", "kernel", "ops", "ns/op", "allocs/op", "bytes out");
+
+	for(unsigned int k = 0; k < NUM_KERNELS; k++) {
+		if(Selected(kernels[k].name, argc, argv)) {
+			Bench_Kernel(kernels[k].name, kernels[k].setup, kernels[k].run);
+		}
+	}
+
+	Setup_Messages();
+	for(selected = 0; selected < num_commands; selected++) {
+		char name[32];
+		snprintf(name, sizeof(name), "msg %c", commands[selected].data[0]);
+		if(Selected(name, argc, argv)) {
+			Bench_Kernel(name, Setup_Messages, Run_Message);
+		}
+	}
+	if(Selected("msg stream", argc, argv)) {
+		Bench_Kernel("msg stream", Setup_Messages, Run_Stream);
+	}
+
+	return 0;
+}
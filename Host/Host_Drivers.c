@@ -0,0 +1,131 @@
+/*
+ * Host_Drivers.c stands in for the robot hardware that host tools link
+ * against but do not exercise: the battery reads full so drive commands
+ * are accepted, the encoders and IR sensor read zero, the servo is
+ * always settled, and the idle, profiler and flight recorder hooks do
+ * nothing. There is no painted stack to measure, so the RAM report is all
+ * zeros.
+ *
+ * Built with HOST_ROBOT the battery, encoders and IR sensor come from the
+ * model in Host_Robot.c instead, and obstacle avoidance is the real one.
+ */
+#include <string.h>
+
+#include "MEGN540_MessageHandeling.h"
+
+#ifndef HOST_ROBOT
+float Battery_Voltage() {
+	return 7.4;
+}
+
+int32_t Counts_Left() {
+	return 0;
+}
+
+int32_t Counts_Right() {
+	return 0;
+}
+
+void Zero_Encoders() {
+}
+
+uint8_t Encoders_Zeroed() {
+	return 0;
+}
+
+void IRRead(eProximitySize side) {
+	(void)side;
+}
+
+t_ProximityReturn IR_Counts() {
+	t_ProximityReturn ret_val = { 0, LEFT };
+	return ret_val;
+}
+
+void Init_Obstacle_Avoidance() {
+}
+#endif
+
+void Servo_PWM_Init(eGripperState state) {
+	(void)state;
+}
+
+void Servo_Move(uint8_t position, float speed) {
+	(void)position;
+	(void)speed;
+}
+
+bool Servo_Is_Settled() {
+	return true;
+}
+
+bool Servo_Step(float dt) {
+	(void)dt;
+	return false;
+}
+
+uint8_t Servo_Position() {
+	return 0;
+}
+
+void Idle_Enable(bool enable) {
+	(void)enable;
+}
+
+Idle_Stats_t Idle_Get_Stats() {
+	Idle_Stats_t stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+#ifdef CONFIG_PROFILER
+void Profiler_Init() {
+}
+
+void Profiler_Record(eProfTask task, uint16_t start) {
+	(void)task;
+	(void)start;
+}
+
+bool Profiler_Dump_Task() {
+	return false;
+}
+
+void Profiler_Dump_Start(bool reset) {
+	(void)reset;
+}
+#endif
+
+#ifdef CONFIG_TRACE
+void Trace_Init() {
+}
+
+void Trace_Write(eTraceEvent event, uint8_t arg) {
+	(void)event;
+	(void)arg;
+}
+
+void Trace_PWM(eTraceEvent side, int16_t pwm) {
+	(void)side;
+	(void)pwm;
+}
+
+bool Trace_Snapshot_Start() {
+	return false;
+}
+
+bool Trace_Snapshot_Task() {
+	return false;
+}
+
+bool Trace_Dump(bool snapshot) {
+	(void)snapshot;
+	return false;
+}
+#endif
+
+Stack_Stats_t Stack_Get_Stats() {
+	Stack_Stats_t stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
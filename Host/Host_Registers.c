@@ -0,0 +1,23 @@
+/*
+ * Host_Registers.c backs the register names declared in Host/avr/io.h with
+ * plain variables. Values start at their datasheet reset state (zero), the
+ * EEPROM (Host/avr/eeprom.h) starts erased.
+ */
+#include <avr/eeprom.h>
+#include <avr/io.h>
+
+volatile uint8_t  TCCR1A;
+volatile uint8_t  TCCR1B;
+volatile uint16_t OCR1A;
+volatile uint16_t OCR1B;
+volatile uint16_t ICR1;
+
+volatile uint8_t  DDRB;
+volatile uint8_t  PORTB;
+volatile uint8_t  DDRD;
+volatile uint8_t  PORTD;
+
+volatile uint8_t  SREG;
+
+// EEPROM (avr/eeprom.h), erased
+uint8_t host_eeprom[E2END + 1] = { [0 ... E2END] = 0xFF };
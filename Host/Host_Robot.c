@@ -0,0 +1,130 @@
+/*
+ * Host_Robot.c implements the driver calls for the motors' feedback, the
+ * encoders, the battery monitor and the IR sensor on the model described
+ * in Host_Robot.h. The motor PWM itself is the real Driver/MotorPWM.c on
+ * Host_Registers.c, so the model reads back what the firmware wrote.
+ */
+#include <math.h>
+
+#include "Host_Robot.h"
+#include "MEGN540_MessageHandeling.h"
+
+static float battery_volts;
+static float wall_x;
+
+static double last_step;
+static double velocity[2];		// left, right [m/s]
+static double travel[2];		// since the encoders were zeroed [m]
+static double pose_x, pose_y, pose_heading;
+static uint8_t zeroed;
+
+void Host_Robot_Init(float battery, float wall) {
+	battery_volts = battery;
+	wall_x = wall;
+	last_step = GetTimeSec();
+	velocity[0] = velocity[1] = 0;
+	travel[0] = travel[1] = 0;
+	pose_x = pose_y = pose_heading = 0;
+}
+
+/*
+ * The speed a wheel settles at for its duty cycle, direction from its PORTB pin
+ */
+static double Target_Velocity(int16_t duty, uint8_t direction_pin, float (*to_velocity)(int)) {
+	if(!Is_Motor_PWM_Enabled() || duty <= 0) {
+		return 0;
+	}
+	double speed = to_velocity(duty);
+	return (PORTB & direction_pin) ? -speed : speed;
+}
+
+void Host_Robot_Step() {
+	double now = GetTimeSec();
+	double dt = now - last_step;
+	last_step = now;
+	if(dt <= 0) {
+		return;
+	}
+
+	double target[2] = {
+		Target_Velocity(Get_Motor_PWM_Left(), 0b00000100, DutyCycle_to_Velocity_Left),
+		Target_Velocity(Get_Motor_PWM_Right(), 0b00000010, DutyCycle_to_Velocity_Right)
+	};
+	double blend = 1 - exp(-dt / ROBOT_TAU);
+	for(int i = 0; i < 2; i++) {
+		velocity[i] += (target[i] - velocity[i]) * blend;
+		travel[i] += velocity[i] * dt;
+	}
+
+	double linear = (velocity[0] + velocity[1]) / 2;
+	double angular = (velocity[1] - velocity[0]) / WHEEL_BASE;
+	pose_x += linear * cos(pose_heading) * dt;
+	pose_y += linear * sin(pose_heading) * dt;
+	pose_heading += angular * dt;
+}
+
+/*
+ * Driver/Battery_Monitor.h
+ */
+void Battery_Monitor_Init() {
+}
+
+float Battery_Voltage() {
+	return battery_volts;
+}
+
+float Battery_Voltage_Task() {
+	return battery_volts;
+}
+
+/*
+ * Driver/Encoder.h
+ */
+void Encoders_Init() {
+}
+
+int32_t Counts_Left() {
+	return lround(travel[0] / DISTANCE_PER_COUNT);
+}
+
+int32_t Counts_Right() {
+	return lround(travel[1] / DISTANCE_PER_COUNT);
+}
+
+void Zero_Encoders() {
+	travel[0] = travel[1] = 0;
+	zeroed++;
+}
+
+uint8_t Encoders_Zeroed() {
+	return zeroed;
+}
+
+/*
+ * Driver/Proximity.h. The reading is taken when IR_Counts is called.
+ */
+void Proxy_Init() {
+}
+
+void IRRead(eProximitySize side) {
+	(void)side;
+}
+
+t_ProximityReturn IR_Counts() {
+	t_ProximityReturn ret_val = { 0, LEFT };
+	double facing = cos(pose_heading);
+	if(wall_x <= 0 || facing <= 0) {
+		return ret_val;
+	}
+
+	double range = (wall_x - pose_x) / facing;
+	if(range < ROBOT_IR_NEAR) {
+		ret_val.m_nCount = 2;
+	}
+	else if(range < ROBOT_IR_FAR) {
+		ret_val.m_nCount = 1;
+	}
+	// Turned left the wall is off to the right
+	ret_val.m_eSide = (sin(pose_heading) > 0) ? RIGHT : LEFT;
+	return ret_val;
+}
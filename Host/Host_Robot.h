@@ -0,0 +1,30 @@
+/*
+ * Host_Robot.h/c is a kinematic stand-in for the Zumo's motors, encoders,
+ * battery and IR sensor, so the firmware's own main loop can drive it on
+ * a workstation (see Link_Sim.c). Each wheel follows its PWM duty cycle
+ * through a first order lag to the speed DutyCycle_to_Velocity_* gives,
+ * the encoders count the distance rolled, and the pose is integrated for
+ * the IR sensor, which sees an optional wall across the start heading.
+ */
+#ifndef HOST_ROBOT_H
+#define HOST_ROBOT_H
+
+#include <stdbool.h>
+
+#define ROBOT_TAU			0.03	// wheel speed time constant [s]
+#define ROBOT_BATTERY		7.4		// default battery voltage [V]
+#define ROBOT_IR_NEAR		0.10	// IR count 2 inside this range [m]
+#define ROBOT_IR_FAR		0.25	// IR count 1 inside this range [m]
+
+/*
+ * Function Host_Robot_Init puts the robot at rest at the origin facing +x.
+ * wall is the distance to a wall across the x axis, 0 for none.
+ */
+void Host_Robot_Init(float battery, float wall);
+
+/*
+ * Function Host_Robot_Step advances the model to the current time
+ */
+void Host_Robot_Step();
+
+#endif
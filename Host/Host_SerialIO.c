@@ -0,0 +1,167 @@
+/*
+ * Host_SerialIO.c implements the usb_* message API from Driver/SerialIO.c
+ * on top of the same ring buffers, minus LUFA. See Host_SerialIO.h.
+ */
+#include <string.h>
+
+#include "Host_SerialIO.h"
+
+static struct Ring_Buffer_C _usb_receive_buffer;
+static struct Ring_Buffer_C _usb_send_buffer;
+
+// Bytes that skipped the send buffer (usb_send_msg_bulk)
+static uint16_t _bulk_bytes;
+
+static Host_USB_Writer_t _writer;
+
+void usb_send_byte(uint8_t byte)
+{
+	rb_push_back_C(&_usb_send_buffer, byte);
+}
+
+void usb_send_data(void* p_data, uint8_t data_len)
+{
+	char* p_data_char = (char*)p_data;
+	for ( uint8_t i=0; i < data_len; i++)
+	{
+		rb_push_back_C(&_usb_send_buffer, p_data_char[i]);
+	}
+}
+
+void usb_send_str(char* p_str)
+{
+	for (size_t i = 0; i < strlen(p_str); i++){
+		rb_push_back_C(&_usb_send_buffer, p_str[i]);
+	}
+
+	rb_push_back_C(&_usb_send_buffer, 0x00);
+}
+
+void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len )
+{
+	uint8_t len = 2 + strlen(format) + data_len;
+	usb_send_byte(len);
+	usb_send_str(format);
+	usb_send_byte(cmd);
+	usb_send_data(p_data, data_len);
+}
+
+bool usb_send_msg_bulk(char* format, char cmd, void* p_data, uint8_t data_len )
+{
+	uint8_t format_len = strlen(format) + 1;
+	uint8_t len = 1 + format_len + data_len;
+
+	// Written straight to the endpoint on the robot, so never in the send buffer
+	if(_writer)
+	{
+		// Anything already queued goes first
+		Host_USB_Drain();
+
+		_writer(&len, 1);
+		_writer(format, format_len);
+		_writer(&cmd, 1);
+		_writer(p_data, data_len);
+	}
+	else
+	{
+		_bulk_bytes += 1 + len;
+	}
+	return true;
+}
+
+uint8_t usb_msg_length()
+{
+	return rb_length_C(&_usb_receive_buffer);
+}
+
+uint8_t usb_out_msg_length()
+{
+	return rb_length_C(&_usb_send_buffer);
+}
+
+uint8_t usb_msg_peek()
+{
+	if(rb_length_C(&_usb_receive_buffer))
+	{
+		return (uint8_t)rb_get_C(&_usb_receive_buffer, 0);
+	}
+	else
+	{
+		return 0x00;
+	}
+}
+
+uint8_t usb_msg_get()
+{
+	if(rb_length_C(&_usb_receive_buffer))
+	{
+		return (uint8_t)rb_pop_front_C(&_usb_receive_buffer);
+	}
+	else
+	{
+		return 0x00;
+	}
+}
+
+bool usb_msg_read_into(void* p_obj, uint8_t data_len)
+{
+	uint8_t* p_dataObj = (uint8_t*)p_obj;
+	if (rb_length_C(&_usb_receive_buffer) < data_len){
+		return false;
+	}
+	for (uint8_t i = 0; i < data_len; i++) {
+		p_dataObj[i] = (uint8_t)rb_pop_front_C(&_usb_receive_buffer);
+	}
+	return true;
+}
+
+void usb_flush_input_buffer()
+{
+	rb_initialize_C(&_usb_receive_buffer);
+}
+
+void usb_init_buffers()
+{
+	rb_initialize_C(&_usb_receive_buffer);
+	rb_initialize_C(&_usb_send_buffer);
+	_bulk_bytes = 0;
+}
+
+bool Host_USB_Feed(const void* p_data, uint8_t data_len)
+{
+	// One slot of the ring is always left empty
+	if(rb_length_C(&_usb_receive_buffer) + data_len > RB_LENGTH_C - 1)
+		return false;
+
+	const char* p_data_char = (const char*)p_data;
+	for (uint8_t i = 0; i < data_len; i++)
+	{
+		rb_push_back_C(&_usb_receive_buffer, p_data_char[i]);
+	}
+	return true;
+}
+
+uint16_t Host_USB_Drain()
+{
+	uint16_t sent = rb_length_C(&_usb_send_buffer) + _bulk_bytes;
+
+	if(_writer)
+	{
+		char data[RB_LENGTH_C];
+		uint8_t len = 0;
+		while(rb_length_C(&_usb_send_buffer))
+		{
+			data[len++] = rb_pop_front_C(&_usb_send_buffer);
+		}
+		_writer(data, len);
+	}
+
+	rb_initialize_C(&_usb_send_buffer);
+	_bulk_bytes = 0;
+	return sent;
+}
+
+void Host_USB_Set_Writer(Host_USB_Writer_t writer)
+{
+	_writer = writer;
+}
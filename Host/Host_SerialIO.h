@@ -0,0 +1,65 @@
+/*
+ * Host stand-in for Driver/SerialIO.h. The real header pulls in LUFA, so
+ * host builds pre-define its include guard and force-include this file
+ * instead (gcc -include Host_SerialIO.h). The usb_* message API keeps its
+ * device behaviour: bytes fed by the host tool land in a receive ring
+ * buffer and replies are queued in a send ring buffer for the tool to
+ * drain, exactly as USB_Upkeep_Task would.
+ */
+#ifndef HOST_SERIAL_IO_H
+#define HOST_SERIAL_IO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Ring_Buffer.h"
+
+/*
+ * Device API, see Driver/SerialIO.h
+ */
+void usb_send_byte(uint8_t byte);
+void usb_send_data(void* p_data, uint8_t data_len);
+void usb_send_str(char* p_str);
+void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len );
+bool usb_send_msg_bulk(char* format, char cmd, void* p_data, uint8_t data_len );
+uint8_t usb_msg_length();
+uint8_t usb_out_msg_length();
+uint8_t usb_msg_peek();
+uint8_t usb_msg_get();
+bool usb_msg_read_into(void* p_obj, uint8_t data_len);
+void usb_flush_input_buffer();
+void usb_init_buffers();
+
+/*
+ * The USB and interrupt set up the firmware's main() calls. Only hosts that
+ * run Main.c (Link_Sim) define them.
+ */
+void USB_SetupHardware(void);
+void USB_Upkeep_Task(void);
+void GlobalInterruptEnable(void);
+
+/*
+ * Host side of the link
+ */
+
+/*
+ * Function Host_USB_Feed appends bytes to the receive buffer as if the host
+ * had sent them. Returns false (and feeds nothing) if they don't fit.
+ */
+bool Host_USB_Feed(const void* p_data, uint8_t data_len);
+
+/*
+ * Function Host_USB_Drain empties the send buffer and returns the number of
+ * bytes that were waiting. Bulk messages are counted here as well.
+ */
+uint16_t Host_USB_Drain();
+
+/*
+ * Function Host_USB_Set_Writer hands everything the firmware sends to
+ * writer: the send buffer when it is drained and bulk messages as they are
+ * sent. Without one the bytes are only counted.
+ */
+typedef void (*Host_USB_Writer_t)(const void* p_data, uint16_t data_len);
+void Host_USB_Set_Writer(Host_USB_Writer_t writer);
+
+#endif
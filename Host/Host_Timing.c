@@ -0,0 +1,69 @@
+/*
+ * Host_Timing.c implements Driver/Timing.h on the workstation's monotonic
+ * clock. Driver/Timing.c needs Timer 0 and AVR assembly. Time starts at
+ * zero the first time any of these is called, as it does at power up.
+ */
+#include <time.h>
+
+#include "Timing.h"
+
+static double Host_Seconds() {
+	static double start = -1;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	double now = ts.tv_sec + ts.tv_nsec * 1e-9;
+	if(start < 0) {
+		start = now;
+	}
+	return now - start;
+}
+
+void SetupTimer0() {
+	Host_Seconds();
+}
+
+Time_t GetTime() {
+	double now = Host_Seconds();
+	uint32_t ms = (uint32_t)(now * 1000);
+	Time_t time = {
+			.millisec = ms,
+			.microsec = (uint16_t)((now - ms * 0.001) * 1e6)
+	};
+	return time;
+}
+
+float GetTimeSec() {
+	return Host_Seconds();
+}
+
+uint32_t GetMilli() {
+	return GetTime().millisec;
+}
+
+uint16_t GetMicro() {
+	return GetTime().microsec;
+}
+
+uint16_t GetTicks() {
+	// 4 us ticks, wrapping like the robot's
+	return (uint16_t)(uint32_t)(Host_Seconds() * 250000);
+}
+
+uint32_t GetTimeMicros() {
+	return (uint32_t)(uint64_t)(Host_Seconds() * 1e6);
+}
+
+Time_t SecondsSince(const Time_t* time_start_p) {
+	Time_t delta_time, current_time;
+
+	current_time = GetTime();
+	delta_time.millisec = current_time.millisec - time_start_p->millisec;
+	delta_time.microsec = current_time.microsec - time_start_p->microsec;
+
+	return delta_time;
+}
+
+void DelayMicroseconds(uint16_t us) {
+	struct timespec ts = { 0, us * 1000L };
+	nanosleep(&ts, NULL);
+}
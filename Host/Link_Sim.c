@@ -0,0 +1,342 @@
+/*
+ * Link_Sim.c runs the robot's firmware on the host behind a pseudo
+ * terminal, so the host scripts can be pointed at it when there is no
+ * robot. It prints the terminal's path on the first line of stdout and
+ * runs until killed:
+ *
+ *      ./BIN/Link_Sim
+ *      /dev/pts/7
+ *      python ../User/link_bench.py /dev/pts/7
+ *
+ * The firmware is the real thing: Main.c's loop (its main renamed to
+ * Firmware_Main), message handling, controllers, trajectories, obstacle
+ * avoidance and telemetry. The hardware under it is Host_Robot.c, a
+ * kinematic model that turns the motor PWM into wheel speeds, encoder
+ * counts and a pose, so drive commands move the robot and 'e', 'Q', 'I'
+ * and the telemetry channels report it. USB_Upkeep_Task moves bytes
+ * between the terminal and the firmware's ring buffers and Idle_Sleep
+ * waits on the terminal, so an idle robot costs next to no CPU (built
+ * with CONFIG_IDLE=n the loop spins, as it does on the robot).
+ *
+ * Options:
+ *      --latency ms    one way delay of every message, in both directions
+ *      --jitter ms     extra uniform random delay (messages keep their order)
+ *      --loss p        probability a message is dropped, in both directions
+ *      --seed n        random seed for jitter and loss (default 1)
+ *      --wall m        a wall m ahead of the start pose for the IR sensor
+ *      --battery V     battery voltage (default ROBOT_BATTERY)
+ *
+ * Delay and loss act on whole messages, split by the command lengths on
+ * the way in and by the length byte on the way out. With any of them set
+ * the message counts go to stderr when Link_Sim is stopped. Link timings
+ * taken here measure the host side and the protocol, not the robot's USB
+ * link.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Host_Robot.h"
+#include "MEGN540_MessageHandeling.h"
+
+#define SIM_TICK_S		0.001	// longest idle sleep, the robot's Timer 0 tick
+#define SIM_QUEUE_LEN	4096	// messages in flight per direction
+#define SIM_MSG_LEN		256		// longest message, the length byte plus 255
+
+int Firmware_Main(void);
+
+static int master;
+static volatile sig_atomic_t stop;
+
+// Link impairments
+static double latency;		// [s]
+static double jitter;		// [s]
+static double loss;
+static bool impaired;
+
+/*
+ * A delay line holds the messages going one way until they are due
+ */
+typedef struct {
+	struct { double due; uint16_t len; uint8_t data[SIM_MSG_LEN]; } queue[SIM_QUEUE_LEN];
+	uint32_t head;				// next out, free running
+	uint32_t tail;				// next in, free running
+	double last_due;			// messages never overtake each other
+	uint8_t partial[SIM_MSG_LEN];
+	uint16_t partial_len;
+	uint16_t (*length)(const uint8_t* p_data);
+	unsigned long messages;
+	unsigned long dropped;
+} t_Delay_Line;
+
+static t_Delay_Line to_robot;
+static t_Delay_Line to_host;
+
+static double Now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Host to robot: the command char's length, unknown chars go through alone
+static uint16_t Command_Length(const uint8_t* p_data) {
+	uint8_t len = MEGN540_Message_Len(p_data[0]);
+	return len ? len : 1;
+}
+
+// Robot to host: the length byte counts what follows it
+static uint16_t Reply_Length(const uint8_t* p_data) {
+	return 1 + p_data[0];
+}
+
+/*
+ * Delay_Push splits bytes into messages and queues each one, or drops it
+ */
+static void Delay_Push(t_Delay_Line* p_line, const uint8_t* p_data, uint16_t data_len) {
+	for(uint16_t i = 0; i < data_len; i++) {
+		p_line->partial[p_line->partial_len++] = p_data[i];
+		if(p_line->partial_len < p_line->length(p_line->partial)) {
+			continue;
+		}
+
+		p_line->messages++;
+		if(drand48() < loss || p_line->tail - p_line->head == SIM_QUEUE_LEN) {
+			p_line->dropped++;
+		}
+		else {
+			double due = Now() + latency + jitter * drand48();
+			if(due < p_line->last_due) {
+				due = p_line->last_due;
+			}
+			p_line->last_due = due;
+
+			uint32_t slot = p_line->tail++ % SIM_QUEUE_LEN;
+			p_line->queue[slot].due = due;
+			p_line->queue[slot].len = p_line->partial_len;
+			memcpy(p_line->queue[slot].data, p_line->partial, p_line->partial_len);
+		}
+		p_line->partial_len = 0;
+	}
+}
+
+/*
+ * Delay_Pop hands the messages that are due to sink, stopping early if it
+ * has no room. Returns the time until the next one is due, or SIM_TICK_S.
+ */
+static double Delay_Pop(t_Delay_Line* p_line, double now, bool (*sink)(const void* p_data, uint16_t data_len)) {
+	while(p_line->head != p_line->tail) {
+		uint32_t slot = p_line->head % SIM_QUEUE_LEN;
+		if(p_line->queue[slot].due > now) {
+			double wait = p_line->queue[slot].due - now;
+			return (wait < SIM_TICK_S) ? wait : SIM_TICK_S;
+		}
+		if(!sink(p_line->queue[slot].data, p_line->queue[slot].len)) {
+			return 0;
+		}
+		p_line->head++;
+	}
+	return SIM_TICK_S;
+}
+
+/*
+ * Writes to the terminal, waiting while the reader is behind
+ */
+static bool Write_Master(const void* p_data, uint16_t data_len) {
+	const uint8_t* p = (const uint8_t*)p_data;
+	while(data_len > 0) {
+		ssize_t n = write(master, p, data_len);
+		if(n > 0) {
+			p += n;
+			data_len -= n;
+		}
+		else if(n < 0 && errno != EAGAIN && errno != EINTR) {
+			return true;
+		}
+		else {
+			usleep(100);
+		}
+	}
+	return true;
+}
+
+static bool Feed_Robot(const void* p_data, uint16_t data_len) {
+	return Host_USB_Feed(p_data, data_len);
+}
+
+// Everything the firmware sends, from the send buffer and bulk messages
+static void Robot_Output(const void* p_data, uint16_t data_len) {
+	if(impaired) {
+		Delay_Push(&to_host, p_data, data_len);
+	}
+	else {
+		Write_Master(p_data, data_len);
+	}
+}
+
+static void Print_Stats() {
+	fprintf(stderr, "Link_Sim: to robot %lu messages, %lu dropped; to host %lu messages, %lu dropped\n",
+			to_robot.messages, to_robot.dropped, to_host.messages, to_host.dropped);
+}
+
+/*
+ * Firmware hooks (Driver/SerialIO.h, Driver/Idle.h and LUFA)
+ */
+void USB_SetupHardware(void) {
+	usb_init_buffers();
+}
+
+void GlobalInterruptEnable(void) {
+}
+
+void USB_Upkeep_Task(void) {
+	if(stop) {
+		if(impaired) {
+			Print_Stats();
+		}
+		exit(0);
+	}
+
+	Host_Robot_Step();
+
+	if(impaired) {
+		// Read only while there is room to queue it, the rest waits in the terminal
+		if(to_robot.tail - to_robot.head < SIM_QUEUE_LEN - RB_LENGTH_C) {
+			uint8_t data[RB_LENGTH_C];
+			ssize_t n = read(master, data, sizeof(data));
+			if(n > 0) {
+				Delay_Push(&to_robot, data, n);
+			}
+		}
+		Delay_Pop(&to_robot, Now(), Feed_Robot);
+	}
+	else {
+		// Take what fits in the receive buffer, the rest waits in the terminal
+		uint8_t room = RB_LENGTH_C - 1 - usb_msg_length();
+		if(room > 0) {
+			uint8_t data[RB_LENGTH_C];
+			ssize_t n = read(master, data, room);
+			if(n > 0) {
+				Host_USB_Feed(data, n);
+			}
+		}
+	}
+
+	Host_USB_Drain();
+	if(impaired) {
+		Delay_Pop(&to_host, Now(), Write_Master);
+	}
+}
+
+#ifdef CONFIG_IDLE
+void Idle_Init() {
+}
+
+/*
+ * Sleeps until the terminal has data, a delayed message is due or the next
+ * Timer 0 tick, whichever is first
+ */
+void Idle_Sleep() {
+	double now = Now();
+	double wait = SIM_TICK_S;
+	if(impaired) {
+		double robot_wait = Delay_Pop(&to_robot, now, Feed_Robot);
+		double host_wait = Delay_Pop(&to_host, now, Write_Master);
+		wait = (robot_wait < host_wait) ? robot_wait : host_wait;
+	}
+
+	struct pollfd pfd = { .fd = master, .events = POLLIN };
+	struct timespec timeout = { 0, (long)(wait * 1e9) };
+	ppoll(&pfd, 1, &timeout, NULL);
+}
+#endif
+
+static int Open_Terminal() {
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		perror("posix_openpt");
+		return -1;
+	}
+
+	// Raw bytes like the CDC link. Holding the slave open keeps the master
+	// usable between clients.
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if(slave < 0) {
+		perror(ptsname(master));
+		return -1;
+	}
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	return 0;
+}
+
+static void Stop(int signal) {
+	(void)signal;
+	stop = 1;
+}
+
+static void Usage() {
+	fprintf(stderr, "usage: Link_Sim [--latency ms] [--jitter ms] [--loss p] [--seed n] [--wall m] [--battery V]\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	static const struct option options[] = {
+		{ "latency", required_argument, NULL, 'l' },
+		{ "jitter", required_argument, NULL, 'j' },
+		{ "loss", required_argument, NULL, 'p' },
+		{ "seed", required_argument, NULL, 's' },
+		{ "wall", required_argument, NULL, 'w' },
+		{ "battery", required_argument, NULL, 'b' },
+		{ NULL, 0, NULL, 0 }
+	};
+	long seed = 1;
+	float wall = 0;
+	float battery = ROBOT_BATTERY;
+
+	int opt;
+	while((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch(opt) {
+		case 'l': latency = atof(optarg) / 1000; break;
+		case 'j': jitter = atof(optarg) / 1000; break;
+		case 'p': loss = atof(optarg); break;
+		case 's': seed = atol(optarg); break;
+		case 'w': wall = atof(optarg); break;
+		case 'b': battery = atof(optarg); break;
+		default: Usage();
+		}
+	}
+	if(optind != argc || latency < 0 || jitter < 0 || loss < 0 || loss > 1) {
+		Usage();
+	}
+	impaired = (latency > 0 || jitter > 0 || loss > 0);
+	srand48(seed);
+	to_robot.length = Command_Length;
+	to_host.length = Reply_Length;
+
+	if(Open_Terminal() != 0) {
+		return 1;
+	}
+	printf("%s\n", ptsname(master));
+	fflush(stdout);
+
+	signal(SIGTERM, Stop);
+	signal(SIGINT, Stop);
+
+	SetupTimer0();
+	Host_Robot_Init(battery, wall);
+	Host_USB_Set_Writer(Robot_Output);
+
+	return Firmware_Main();
+}
@@ -0,0 +1,381 @@
+/*
+ * OA_Replay.c replays recorded IR proximity and encoder traces through the
+ * obstacle avoidance logic in Application/Obstacle_Avoidance.c on the host.
+ *
+ * Scenario files use the CSV layout written by RecordData.saveData in
+ * User/serial_monitor_lib.py, so a capture of the 'I' and 'E' (or 'Q')
+ * streams taken while the robot drives can be replayed directly:
+ *
+ *      <host time [s]>, I, <IR count>, <L|R>
+ *      <host time [s]>, E, <left counts>, <right counts>
+ *      <host time [s]>, Q, <robot time>, <PWM L>, <PWM R>, <enc L>, <enc R>
+ *
+ * Blank lines and lines starting with '#' are ignored. The obstacle
+ * avoidance task runs on its own clock next to the recording: Run_OA_Task is
+ * called once per task period, one scheduler tick each, so the READ_L,
+ * READ_R and RUN_DSM steps of a decision land on separate ticks as on the
+ * robot. IRRead takes the latest recorded 'I' sample, which IR_Counts then
+ * returns. Each call the state machine makes to
+ * Controller_Set_Target_Velocity is captured.
+ *
+ * Per scenario the harness reports:
+ *      obstacles   number of times the IR went from clear to a detection
+ *      react       time from a detection to the first turn command
+ *      clear       time from a detection to the next drive-straight command
+ *      cmd path    distance integrated from the commanded wheel velocities
+ *      odo path    distance from the recorded encoder counts
+ *
+ * Usage: OA_Replay [-v] [-p ms] scenario.csv [scenario.csv ...]
+ *      -v  print every captured velocity command
+ *      -p  obstacle avoidance task period, the 'O' duration (default 20 ms)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Obstacle_Avoidance.h"
+#include "Profiler.h"
+
+#define MAX_LINE	256
+#define DEFAULT_PERIOD_MS	20
+
+/*
+ * Replay state shared with the driver stand-ins below
+ */
+static t_ProximityReturn ir_recorded;	// latest 'I' sample in the file
+static t_ProximityReturn ir_sample;		// what the last IRRead saw
+static float replay_time;
+static float task_period;				// [s]
+static bool verbose;
+
+typedef struct {
+	float vel_left;
+	float vel_right;
+	unsigned int commands;
+} t_CommandLog;
+
+static t_CommandLog cmd_log;
+
+/*
+ * Driver stand-ins. The IR hardware is replaced by the recorded sample and
+ * velocity targets are logged before being stored in the controller.
+ */
+void IRRead(eProximitySize side) {
+	(void)side;
+	ir_sample = ir_recorded;
+}
+
+t_ProximityReturn IR_Counts() {
+	return ir_sample;
+}
+
+/*
+ * Task timing means nothing off the robot
+ */
+uint16_t GetTicks() {
+	return 0;
+}
+
+#ifdef CONFIG_PROFILER
+void Profiler_Record(eProfTask task, uint16_t start) {
+	(void)task;
+	(void)start;
+}
+#endif
+
+/*
+ * No flight recorder either
+ */
+#ifdef CONFIG_TRACE
+void Trace_Write(eTraceEvent event, uint8_t arg) {
+	(void)event;
+	(void)arg;
+}
+
+void Trace_PWM(eTraceEvent side, int16_t pwm) {
+	(void)side;
+	(void)pwm;
+}
+#endif
+
+void Controller_Set_Target_Velocity(Controller_t* p_cont, float vel) {
+	p_cont->target_vel = vel;
+
+	if(p_cont == &ctr_LeftMotor) {
+		cmd_log.vel_left = vel;
+	}
+	else {
+		cmd_log.vel_right = vel;
+	}
+	cmd_log.commands++;
+
+	if(verbose) {
+		printf("  %9.3f  %s  %+.4f m/s\n", replay_time,
+				(p_cont == &ctr_LeftMotor) ? "L" : "R", vel);
+	}
+}
+
+/*
+ * Per-scenario metrics
+ */
+typedef struct {
+	unsigned int samples;
+	unsigned int obstacles;
+	unsigned int unresolved;
+	float react_sum, react_max;
+	unsigned int react_n;
+	float clear_sum, clear_max;
+	unsigned int clear_n;
+	float cmd_path;
+	float odo_path;
+} t_ReplayStats;
+
+/*
+ * Obstacle event being timed
+ */
+typedef struct {
+	bool in_event;
+	bool reacted;
+	float start;
+} t_Event;
+
+/*
+ * Reset_Replay clears the capture and puts the controllers back the way
+ * InitializeSystem leaves them on the robot. Only the fields the obstacle
+ * avoidance logic reads matter here.
+ */
+static void Reset_Replay() {
+	memset(&cmd_log, 0, sizeof(cmd_log));
+	memset(&ir_recorded, 0, sizeof(ir_recorded));
+	ir_recorded.m_eSide = LEFT;
+	ir_sample = ir_recorded;
+
+	memset(&ctr_LeftMotor, 0, sizeof(ctr_LeftMotor));
+	memset(&ctr_RightMotor, 0, sizeof(ctr_RightMotor));
+	ctr_LeftMotor.update_period = 10;
+	ctr_RightMotor.update_period = 10;
+	mf_motor_vel_control.active = false;
+}
+
+/*
+ * Task_Tick is one scheduler tick of the obstacle avoidance task at time
+ * tick: a single Run_OA_Task step, then the event timing on what it
+ * commanded. last_tick is the previous tick, for the commanded path.
+ */
+static void Task_Tick(float tick, float last_tick, t_ReplayStats* stats, t_Event* event) {
+	// Integrate the commanded path over the last tick
+	if(mf_motor_vel_control.active) {
+		stats->cmd_path += 0.5 * (fabsf(cmd_log.vel_left) + fabsf(cmd_log.vel_right)) * (tick - last_tick);
+	}
+
+	replay_time = tick;
+	Run_OA_Task();
+
+	if(event->in_event) {
+		// The drive-straight command is the only one with these targets
+		bool straight = (cmd_log.vel_left == DutyCycle_to_Velocity_Left(OA_DRIVE_DC))
+				&& (cmd_log.vel_right == DutyCycle_to_Velocity_Right(OA_DRIVE_DC));
+		float dt = tick - event->start;
+		if(!event->reacted && !straight) {
+			event->reacted = true;
+			stats->react_sum += dt;
+			stats->react_n++;
+			if(dt > stats->react_max) stats->react_max = dt;
+		}
+		else if(event->reacted && straight) {
+			event->in_event = false;
+			stats->clear_sum += dt;
+			stats->clear_n++;
+			if(dt > stats->clear_max) stats->clear_max = dt;
+		}
+	}
+}
+
+static int Replay_Scenario(const char* path, t_ReplayStats* stats) {
+	FILE* file = fopen(path, "r");
+	if(file == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	Reset_Replay();
+	Init_Obstacle_Avoidance();
+
+	char line[MAX_LINE];
+	unsigned int line_no = 0;
+	bool have_t0 = false, have_enc = false;
+	float t0 = 0;
+	float enc_left = 0, enc_right = 0;
+
+	// Task clock, relative to the first sample
+	float next_tick = 0, last_tick = 0;
+
+	// Obstacle event tracking
+	t_Event event = { false, false, 0 };
+	uint16_t last_count = 0;
+
+	while(fgets(line, sizeof(line), file)) {
+		line_no++;
+		char* p = line;
+		while(*p == ' ' || *p == '\t') p++;
+		if(*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+			continue;
+		}
+
+		float t;
+		char cmd;
+		int used;
+		if(sscanf(p, "%f , %c ,%n", &t, &cmd, &used) < 2) {
+			fprintf(stderr, "%s:%u: unrecognized line\n", path, line_no);
+			fclose(file);
+			return -1;
+		}
+		p += used;
+
+		if(!have_t0) {
+			t0 = t;
+			have_t0 = true;
+		}
+
+		// Ticks due before this sample see the samples before it
+		while(next_tick < t - t0) {
+			Task_Tick(next_tick, last_tick, stats, &event);
+			last_tick = next_tick;
+			next_tick += task_period;
+		}
+		replay_time = t - t0;
+
+		switch(cmd) {
+		case 'I':
+		case 'i':
+		{
+			int count;
+			char side;
+			if(sscanf(p, "%d , %c", &count, &side) != 2) {
+				fprintf(stderr, "%s:%u: bad IR sample\n", path, line_no);
+				fclose(file);
+				return -1;
+			}
+
+			ir_recorded.m_nCount = count;
+			ir_recorded.m_eSide = (side == 'R') ? RIGHT : LEFT;
+			stats->samples++;
+
+			// New obstacle? Timed from the sample, so the task's cadence counts.
+			if(count > 0 && last_count == 0 && !event.in_event) {
+				event.in_event = true;
+				event.reacted = false;
+				event.start = replay_time;
+				stats->obstacles++;
+			}
+			last_count = count;
+			break;
+		}
+
+		case 'E':
+		case 'e':
+		case 'Q':
+		case 'q':
+		{
+			float left, right, unused;
+			int n = (cmd == 'E' || cmd == 'e') ?
+					sscanf(p, "%f , %f", &left, &right)
+					: sscanf(p, "%f , %f , %f , %f , %f", &unused, &unused, &unused, &left, &right);
+			if(n < 2) {
+				fprintf(stderr, "%s:%u: bad encoder sample\n", path, line_no);
+				fclose(file);
+				return -1;
+			}
+
+			if(have_enc) {
+				stats->odo_path += 0.5 * (fabsf(ECount_to_Distance((int)(left - enc_left)))
+						+ fabsf(ECount_to_Distance((int)(right - enc_right))));
+			}
+			enc_left = left;
+			enc_right = right;
+			have_enc = true;
+			break;
+		}
+
+		default:
+			// Other streams in the capture are not used
+			break;
+		}
+	}
+
+	if(event.in_event) {
+		stats->unresolved++;
+	}
+
+	fclose(file);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	int first = 1;
+	float period_ms = DEFAULT_PERIOD_MS;
+	while(first < argc && argv[first][0] == '-') {
+		if(strcmp(argv[first], "-v") == 0) {
+			verbose = true;
+			first++;
+		}
+		else if(strcmp(argv[first], "-p") == 0 && first + 1 < argc && atof(argv[first + 1]) > 0) {
+			period_ms = atof(argv[first + 1]);
+			first += 2;
+		}
+		else {
+			break;
+		}
+	}
+	task_period = period_ms / 1000;
+
+	if(first >= argc || argv[first][0] == '-') {
+		fprintf(stderr, "Usage: %s [-v] [-p ms] scenario.csv [scenario.csv ...]\n", argv[0]);
+		return 2;
+	}
+
+	printf("%-28s %7s %5s %9s %15s %15s %9s %9s\n", "scenario", "samples", "cmds", "obstacles",
+			"react avg/max", "clear avg/max", "cmd path", "odo path");
+
+	int rc = 0;
+	for(int i = first; i < argc; i++) {
+		t_ReplayStats stats;
+		if(verbose) {
+			printf("%s\n", argv[i]);
+		}
+		if(Replay_Scenario(argv[i], &stats) != 0) {
+			rc = 1;
+			continue;
+		}
+
+		const char* name = strrchr(argv[i], '/');
+		name = name ? name + 1 : argv[i];
+
+		char react[32], clear[32];
+		if(stats.react_n) {
+			snprintf(react, sizeof(react), "%.3f/%.3f s", stats.react_sum / stats.react_n, stats.react_max);
+		}
+		else {
+			snprintf(react, sizeof(react), "-");
+		}
+		if(stats.clear_n) {
+			snprintf(clear, sizeof(clear), "%.3f/%.3f s", stats.clear_sum / stats.clear_n, stats.clear_max);
+		}
+		else {
+			snprintf(clear, sizeof(clear), "-");
+		}
+
+		printf("%-28s %7u %5u %5u", name, stats.samples, cmd_log.commands, stats.obstacles);
+		if(stats.unresolved) {
+			printf("(%u!)", stats.unresolved);
+		}
+		else {
+			printf("    ");
+		}
+		printf(" %15s %15s %7.3f m %7.3f m\n", react, clear, stats.cmd_path, stats.odo_path);
+	}
+
+	return rc;
+}
@@ -0,0 +1,37 @@
+/*
+ * Host stand-in for <avr/eeprom.h>. The EEPROM is a RAM array (see
+ * Host_Registers.c) that starts erased, every byte 0xFF, and writes are
+ * ready at once. It lasts as long as the host process.
+ */
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef E2END
+#define E2END	0x3FF	// ATmega32U4, 1 KB
+#endif
+
+extern uint8_t host_eeprom[E2END + 1];
+
+#define eeprom_is_ready()	1
+
+static inline uint8_t eeprom_read_byte(const uint8_t* p_addr) {
+	return host_eeprom[(uintptr_t)p_addr];
+}
+
+static inline void eeprom_update_byte(uint8_t* p_addr, uint8_t value) {
+	host_eeprom[(uintptr_t)p_addr] = value;
+}
+
+static inline void eeprom_read_block(void* p_dst, const void* p_src, size_t n) {
+	memcpy(p_dst, &host_eeprom[(uintptr_t)p_src], n);
+}
+
+static inline void eeprom_update_block(const void* p_src, void* p_dst, size_t n) {
+	memcpy(&host_eeprom[(uintptr_t)p_dst], p_src, n);
+}
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for <avr/interrupt.h>. There is nothing to mask on the
+ * host so the global interrupt controls are no-ops.
+ */
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define sei()
+#define cli()
+#define ISR(vector)		void vector(void)
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Host stand-in for <avr/io.h>. The I/O registers touched by the driver
+ * files linked into host builds are plain variables (see Host_Registers.c)
+ * so the driver code compiles and runs unmodified on a workstation.
+ */
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+/*
+ * Timer 1 (motor PWM)
+ */
+extern volatile uint8_t  TCCR1A;
+extern volatile uint8_t  TCCR1B;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint16_t ICR1;
+
+#define COM1A0	6
+#define COM1A1	7
+
+/*
+ * Ports
+ */
+extern volatile uint8_t  DDRB;
+extern volatile uint8_t  PORTB;
+extern volatile uint8_t  DDRD;
+extern volatile uint8_t  PORTD;
+
+#define DDB1	1
+#define DDB2	2
+#define DDB5	5
+#define DDB6	6
+
+#define DDD0	0
+#define DDD3	3
+#define DDD5	5
+#define PORTD0	0
+#define PORTD3	3
+#define PORTD5	5
+
+/*
+ * Status register
+ */
+extern volatile uint8_t  SREG;
+
+#define _BV(bit)				(1 << (bit))
+#define bit_is_set(sfr, bit)	((sfr) & _BV(bit))
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>. There is one address space on a
+ * workstation, so flash data is ordinary const data.
+ */
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(addr)	(*(const uint8_t*)(addr))
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for <avr/sleep.h>. The host never sleeps, the controls are
+ * no-ops.
+ */
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE		0
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+
+#endif
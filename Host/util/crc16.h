@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for <util/crc16.h>, the C equivalents avr-libc documents
+ * for its assembly versions.
+ */
+#ifndef HOST_UTIL_CRC16_H
+#define HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// CRC-16 (IBM), polynomial 0xA001 reflected
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+	crc ^= a;
+	for(int i = 0; i < 8; i++) {
+		crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	return crc;
+}
+
+#endif
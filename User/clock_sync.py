@@ -0,0 +1,224 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    clock_sync.py puts host and robot on one clock. The host pings with
+    'c' {uint8 sequence} and the robot answers 'c' "cBI" {sequence, robot
+    time [us]}, stamped with GetTimeMicros as the ping is handled. Taking
+    the robot's time to be at the midpoint of the round trip, each exchange
+    gives a (host time, robot time) pair. Exchanges held up by USB polling
+    or thread scheduling have long round trips and are left out: the
+    shortest exchange in each stretch of the history goes into a straight
+    line fit, robot = offset + rate * host, so crystal drift is followed as
+    well as the offset.
+
+        sync = ClockSync()
+        conn.write(sync.ping(time.perf_counter()))      # while sync.due(now)
+        sync.reply(sequence, robot_us, time.perf_counter())
+        sync.to_robot(host_time), sync.to_host(robot_time)
+        sync.unwrap(robot_us)                           # robot seconds, past the 71.6 minute wrap
+
+    Telemetry frames ('Y') carry the same robot time, so samples can be
+    placed on the robot's clock no matter when they reached the host.
+
+        python clock_sync.py /dev/ttyACM0 --seconds 10
+        python clock_sync.py --sim                      # no robot, uses Host/BIN/Link_Sim
+'''
+
+import argparse
+import collections
+import os
+import subprocess
+import sys
+import time
+
+import frame_parser
+import protocol
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+SYNC_HISTORY = 256      # exchanges kept
+SYNC_BUCKETS = 16       # stretches of the history, the shortest round trip of each is fitted
+SYNC_FAST = 10          # exchanges at SYNC_FAST_PERIOD after starting
+SYNC_FAST_PERIOD = 0.05 # [s]
+SYNC_PERIOD = 1.0       # [s] after that
+SYNC_MIN_SPAN = 5.0     # [s] of history before the rate is fitted rather than taken as 1
+
+WRAP = 1 << 32
+
+
+class ClockSync:
+
+    def __init__(self):
+        self.samples = collections.deque(maxlen=SYNC_HISTORY)  # (host midpoint, robot, round trip) [s]
+        self.pending = {}
+        self.sequence = 0
+        self.exchanges = 0
+        self.next_ping = 0
+        self.offset = 0.0
+        self.rate = 1.0
+        self.wraps = 0
+        self.last_us = None
+
+    def due(self, now):
+        return now >= self.next_ping
+
+    def ping(self, now):
+        ''' The bytes of the next ping, sent at host time now '''
+        self.sequence = (self.sequence + 1) & 0xFF
+        self.pending[self.sequence] = now
+        self.next_ping = now + (SYNC_FAST_PERIOD if self.exchanges < SYNC_FAST else SYNC_PERIOD)
+        return protocol.pack('c', self.sequence)
+
+    def reply(self, sequence, robot_us, now):
+        ''' Takes the robot's answer to a ping, received at host time now '''
+        sent = self.pending.pop(sequence, None)
+        if sent is None:
+            return
+        # Anything older than this ping went unanswered
+        self.pending = {s: t for s, t in self.pending.items() if t > sent}
+        self.exchanges += 1
+        self.samples.append(((sent + now) / 2, self.unwrap(robot_us), now - sent))
+        self._fit()
+
+    def synced(self):
+        return len(self.samples) > 0
+
+    def unwrap(self, robot_us):
+        ''' Robot seconds since reset for a 32 bit microsecond stamp. Stamps must arrive within half a wrap
+            (35 minutes) of each other, in either order. '''
+        if self.last_us is None:
+            self.last_us = robot_us
+        elif robot_us < self.last_us - WRAP // 2:
+            self.wraps += 1
+            self.last_us = robot_us
+        elif robot_us > self.last_us + WRAP // 2:
+            # A late stamp from before the last wrap
+            return ((self.wraps - 1) * WRAP + robot_us) / 1e6
+        elif robot_us > self.last_us:
+            self.last_us = robot_us
+        return (self.wraps * WRAP + robot_us) / 1e6
+
+    def _best(self):
+        ''' The shortest round trip in each of SYNC_BUCKETS stretches of the history '''
+        samples = list(self.samples)
+        span = samples[-1][0] - samples[0][0]
+        if span <= 0:
+            return [min(samples, key=lambda s: s[2])]
+        buckets = {}
+        for sample in samples:
+            b = min(int((sample[0] - samples[0][0]) / span * SYNC_BUCKETS), SYNC_BUCKETS - 1)
+            if b not in buckets or sample[2] < buckets[b][2]:
+                buckets[b] = sample
+        return [buckets[b] for b in sorted(buckets)]
+
+    def _fit(self):
+        best = self._best()
+        span = best[-1][0] - best[0][0]
+        if len(best) < 3 or span < SYNC_MIN_SPAN:
+            self.rate = 1.0
+            self.offset = sum(r - h for h, r, _ in best) / len(best)
+            return
+
+        # Least squares about the means keeps the host's large perf_counter values from costing precision
+        n = len(best)
+        mean_h = sum(s[0] for s in best) / n
+        mean_r = sum(s[1] for s in best) / n
+        shh = sum((s[0] - mean_h) ** 2 for s in best)
+        shr = sum((s[0] - mean_h) * (s[1] - mean_r) for s in best)
+        self.rate = shr / shh
+        self.offset = mean_r - self.rate * mean_h
+
+    def to_robot(self, host_time):
+        return self.offset + self.rate * host_time
+
+    def to_host(self, robot_time):
+        return (robot_time - self.offset) / self.rate
+
+    def drift_ppm(self):
+        return (self.rate - 1.0) * 1e6
+
+    def residuals(self):
+        ''' Robot time minus the fit for the fitted exchanges [s] '''
+        return [r - self.to_robot(h) for h, r, _ in self._best()] if self.samples else []
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure the robot's clock against the host's")
+    parser.add_argument("port", nargs="?", help="serial port of the robot")
+    parser.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+    parser.add_argument("--seconds", type=float, default=10, help="how long to sync for (default 10)")
+    args = parser.parse_args()
+
+    sim = None
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+        port = sim.stdout.readline().strip()
+    elif args.port:
+        port = args.port
+    else:
+        parser.error("give a serial port or --sim")
+
+    import serial
+    conn = serial.Serial(port, 115200, timeout=0.01)
+    sync = ClockSync()
+    frames = frame_parser.FrameParser()
+    try:
+        conn.reset_input_buffer()
+        end = time.perf_counter() + args.seconds
+        while time.perf_counter() < end:
+            if sync.due(time.perf_counter()):
+                now = time.perf_counter()
+                conn.write(sync.ping(now))
+            chunk = conn.read(conn.in_waiting or 1)
+            now = time.perf_counter()
+            frames.feed(chunk)
+            for fmt, values in frames.frames():
+                if values[0] == b'c' and fmt == "cBI":
+                    sync.reply(values[1], values[2], now)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        conn.close()
+        if sim is not None:
+            sim.terminate()
+
+    if not sync.synced():
+        print("no replies, is the firmware new enough for 'c'?", file=sys.stderr)
+        return 1
+    trips = sorted(s[2] for s in sync.samples)
+    residuals = sync.residuals()
+    print("%d exchanges, round trip min %.3f ms, median %.3f ms" % (sync.exchanges, trips[0] * 1e3,
+          trips[len(trips) // 2] * 1e3))
+    print("robot = host %+.6f s, drift %+.1f ppm, fit residual max %.1f us" % (
+          sync.offset, sync.drift_ppm(), max(abs(r) for r in residuals) * 1e6))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,324 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+'''
+    flash.py loads a hex file onto one robot or a fleet through the CDC
+    bootloader, sending only the flash pages that changed:
+
+        python flash.py ../Application/Main.hex -p /dev/ttyZumoCarAVR
+        python flash.py Main.hex -p /dev/ttyACM0,/dev/ttyACM1 -p /dev/ttyACM2
+        python flash.py Main.hex -p /dev/ttyACM0 --full     # every page of the image
+
+    The robots must be in their bootloader (press reset). A port that isn't
+    there, or isn't a bootloader, is retried for --wait seconds, so a fleet
+    can be reset one robot after another while flash.py runs. Robots are
+    flashed at the same time, one thread each, and start their application
+    when done unless --stay.
+
+    With the bootloader in lufa/Bootloaders/CDC built with its page CRC
+    extension (NO_PAGE_CRC_SUPPORT removed from Config/AppConfig.h, see
+    BootloaderCDC.txt; it then answers 'h'), flash.py reads the CRC16 of every page of the image
+    with 'H' and sends the pages that differ in one 'W' stream. The
+    bootloader writes each page while it receives the next and checks it
+    against its CRC as it reads back from flash, so there is no round trip
+    per page. A second 'H' pass checks the whole image at the end. An
+    unchanged robot costs the CRC read, a change costs about 10 ms per
+    changed page, instead of erasing and writing all 28 KB.
+
+    Other AVR109 bootloaders (the Zumo's stock one, which make program uses
+    through avrdude) answer '?' to 'h'. flash.py then reads the image back
+    with 'g', writes the pages that differ with 'B' and reads those back to
+    verify: a round trip per page, but unchanged pages are still skipped.
+
+    Flash past the end of the image is left as it is. The exit status is 1
+    if any robot failed.
+'''
+
+import argparse
+import concurrent.futures
+import sys
+import time
+
+TIMEOUT = 1.0           # [s] for a reply
+PAGE_WRITE_TIME = 0.02  # [s] erase and write one page, with room to spare
+
+# Application flash of the parts the stock bootloaders run on, by signature
+APP_BYTES = {(0x1E, 0x95, 0x87): 0x7000}   # ATmega32U4 with a 4 KB boot section
+
+
+class FlashError(Exception):
+    pass
+
+
+def _crc16_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0xFFFF):
+    ''' avr-libc's _crc16_update() over data, from 0xFFFF as the bootloader does '''
+    for byte in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ byte) & 0xFF]
+    return crc
+
+
+def read_hex(path):
+    ''' {address: byte} from an Intel hex file '''
+    image = {}
+    base = 0
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                if line[0] != ':':
+                    raise ValueError
+                record = bytes.fromhex(line[1:])
+            except ValueError:
+                raise FlashError("%s:%d: not an Intel hex record" % (path, number))
+            if len(record) < 5 or len(record) != 5 + record[0] or sum(record) & 0xFF:
+                raise FlashError("%s:%d: bad length or checksum" % (path, number))
+            kind = record[3]
+            data = record[4:-1]
+            if kind == 0:
+                address = base + (record[1] << 8 | record[2])
+                for i, byte in enumerate(data):
+                    image[address + i] = byte
+            elif kind == 1:
+                break
+            elif kind == 2:
+                base = (data[0] << 8 | data[1]) << 4
+            elif kind == 4:
+                base = (data[0] << 8 | data[1]) << 16
+    if not image:
+        raise FlashError("%s: no data" % path)
+    return image
+
+
+def paginate(image, page_size):
+    ''' {page index: page bytes} for the pages the image touches, 0xFF filled '''
+    pages = {}
+    for address, byte in image.items():
+        page = pages.setdefault(address // page_size, bytearray(b"\xff" * page_size))
+        page[address % page_size] = byte
+    return {index: bytes(page) for index, page in pages.items()}
+
+
+def read_exact(conn, count, timeout=TIMEOUT):
+    data = b""
+    deadline = time.perf_counter() + timeout
+    while len(data) < count and time.perf_counter() < deadline:
+        data += conn.read(count - len(data))
+    return data
+
+
+def command(conn, message, reply_len, timeout=TIMEOUT):
+    conn.write(message)
+    reply = read_exact(conn, reply_len, timeout)
+    if len(reply) != reply_len:
+        raise FlashError("no reply to '%s'" % message[:1].decode("latin-1"))
+    return reply
+
+
+def set_address(conn, byte_address):
+    # AVR109 addresses flash in words
+    word = byte_address >> 1
+    if command(conn, bytes([ord('A'), word >> 8, word & 0xFF]), 1) != b"\r":
+        raise FlashError("bootloader refused address %04x" % byte_address)
+
+
+def is_bootloader(conn):
+    ''' An AVR109 bootloader answers 'p' (programmer type) with 'S'. The robot's
+        application waits for the rest of a 'p' message instead. '''
+    conn.write(b"\x1b")
+    time.sleep(0.05)
+    conn.reset_input_buffer()
+    conn.write(b"p")
+    return read_exact(conn, 1, 0.3) == b"S"
+
+
+def page_crcs(conn, page_size, first, count):
+    set_address(conn, first * page_size)
+    reply = command(conn, b"H" + bytes([count >> 8, count & 0xFF]), 2 * count, TIMEOUT + count * 0.002)
+    return [reply[i] << 8 | reply[i + 1] for i in range(0, len(reply), 2)]
+
+
+def image_crcs(conn, page_size, pages):
+    ''' {page index: CRC in flash} for the image's pages, read as one span '''
+    first, last = min(pages), max(pages)
+    crcs = page_crcs(conn, page_size, first, last - first + 1)
+    return {index: crcs[index - first] for index in pages}
+
+
+def flash_streamed(conn, pages, page_size, full):
+    ''' Writes the pages whose CRC differs with one 'W'. Returns the number written. '''
+    wanted = {index: crc16(data) for index, data in pages.items()}
+    if full:
+        changed = sorted(pages)
+    else:
+        changed = sorted(index for index, crc in image_crcs(conn, page_size, pages).items() if crc != wanted[index])
+
+    if changed:
+        stream = bytearray(b"W" + bytes([len(changed) >> 8, len(changed) & 0xFF]))
+        for index in changed:
+            stream += bytes([index >> 8, index & 0xFF]) + pages[index]
+            stream += bytes([wanted[index] >> 8, wanted[index] & 0xFF])
+        reply = command(conn, bytes(stream), 3, TIMEOUT + len(changed) * PAGE_WRITE_TIME)
+        failed = reply[1] << 8 | reply[2]
+        if reply[:1] == b"?":
+            raise FlashError("page %d (%04x) is outside the application section" % (failed, failed * page_size))
+        if reply[:1] == b"C":
+            raise FlashError("page %d arrived corrupted" % failed)
+        if reply[:1] == b"V":
+            raise FlashError("page %d failed to verify" % failed)
+        if reply[:1] != b"\r":
+            raise FlashError("unexpected reply %r to the page stream" % reply)
+
+    bad = sorted(index for index, crc in image_crcs(conn, page_size, pages).items() if crc != wanted[index])
+    if bad:
+        raise FlashError("%d pages differ after writing, first %d" % (len(bad), bad[0]))
+    return len(changed)
+
+
+def read_page(conn, page_size, index):
+    set_address(conn, index * page_size)
+    return command(conn, b"g" + bytes([page_size >> 8, page_size & 0xFF]) + b"F", page_size)
+
+
+def flash_blocks(conn, pages, page_size, full):
+    ''' Plain AVR109: compares, writes and verifies page by page. Returns the number written. '''
+    written = 0
+    for index in sorted(pages):
+        if not full and read_page(conn, page_size, index) == pages[index]:
+            continue
+        set_address(conn, index * page_size)
+        if command(conn, b"B" + bytes([page_size >> 8, page_size & 0xFF]) + b"F" + pages[index], 1) != b"\r":
+            raise FlashError("bootloader refused page %d" % index)
+        if read_page(conn, page_size, index) != pages[index]:
+            raise FlashError("page %d failed to verify" % index)
+        written += 1
+    return written
+
+
+def flash(conn, image, full=False, stay=False):
+    ''' Loads image ({address: byte}) through the bootloader on conn. Returns a summary line. '''
+    start = time.perf_counter()
+    command(conn, b"P", 1)
+
+    reply = command(conn, b"h", 1)
+    if reply == b"Y":
+        reply = read_exact(conn, 4)
+        if len(reply) != 4:
+            raise FlashError("short reply to 'h'")
+        page_size = reply[0] << 8 | reply[1]
+        app_bytes = (reply[2] << 8 | reply[3]) * page_size
+        write = flash_streamed
+    else:
+        reply = command(conn, b"b", 3)
+        if reply[:1] != b"Y":
+            raise FlashError("bootloader has no block support")
+        page_size = reply[1] << 8 | reply[2]
+        signature = tuple(reversed(command(conn, b"s", 3)))
+        app_bytes = APP_BYTES.get(signature)
+        if app_bytes is None:
+            raise FlashError("unknown part %02x %02x %02x" % signature)
+        write = flash_blocks
+
+    if max(image) >= app_bytes:
+        raise FlashError("image ends at %04x, past the application section (%04x)" % (max(image) + 1, app_bytes))
+    pages = paginate(image, page_size)
+    written = write(conn, pages, page_size, full)
+
+    command(conn, b"L", 1)
+    if not stay:
+        command(conn, b"E", 1)
+    if written:
+        summary = "%d of %d pages written" % (written, len(pages))
+    else:
+        summary = "up to date (%d pages)" % len(pages)
+    return "%s%s, %.1f s" % (summary, "" if write is flash_streamed else " without page CRCs",
+                             time.perf_counter() - start)
+
+
+def flash_port(port, image, args):
+    import serial
+    deadline = time.perf_counter() + args.wait
+    while True:
+        try:
+            conn = serial.Serial(port, 115200, timeout=0.01)
+            try:
+                if is_bootloader(conn):
+                    return flash(conn, image, args.full, args.stay)
+            finally:
+                conn.close()
+            error = "not in its bootloader, press reset"
+        except OSError as e:        # serial.SerialException is an OSError
+            error = str(e)
+        if time.perf_counter() >= deadline:
+            raise FlashError(error)
+        time.sleep(0.5)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load a hex file through the CDC bootloader, changed pages only")
+    parser.add_argument("hex", help="Intel hex file, e.g. Application/Main.hex")
+    parser.add_argument("-p", "--port", action="append", default=[],
+                        help="serial port, repeat it or separate with commas for several robots")
+    parser.add_argument("--wait", type=float, default=10, help="seconds to wait for each bootloader (default 10)")
+    parser.add_argument("--full", action="store_true", help="write every page of the image, changed or not")
+    parser.add_argument("--stay", action="store_true", help="stay in the bootloader afterwards")
+    args = parser.parse_args()
+
+    ports = [port for ports in args.port for port in ports.split(",") if port]
+    if not ports:
+        parser.error("give a serial port (-p)")
+    try:
+        image = read_hex(args.hex)
+    except (FlashError, OSError) as e:
+        parser.error(str(e))
+
+    failed = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=len(ports)) as pool:
+        jobs = {pool.submit(flash_port, port, image, args): port for port in ports}
+        for job in concurrent.futures.as_completed(jobs):
+            try:
+                print("%s: %s" % (jobs[job], job.result()))
+            except FlashError as e:
+                print("%s: %s" % (jobs[job], e), file=sys.stderr)
+                failed += 1
+            sys.stdout.flush()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+'''
+    frame_parser.py splits the robot's byte stream into messages. Bytes are
+    fed in whatever chunks the serial port returns, the parser keeps the
+    partial message at the end for the next feed:
+
+        parser = FrameParser()
+        parser.feed(conn.read(conn.in_waiting or 1))
+        for fmt, values in parser.frames():
+            ...
+
+    A message is [length][format\0][cmd][data], length counting everything
+    after itself, and the format (cmd included as its leading 'c') must
+    describe exactly the data that follows. A message that doesn't add up
+    is taken as line noise: one byte is dropped and the parser looks for
+    the next message from there, counted in resyncs. The check is made as
+    soon as the format's \0 has arrived, without waiting for the data.
+
+    One struct.Struct is kept per format, along with how its values map to
+    the list serial_monitor_lib hands its callbacks (to_list), so a stream
+    of the same few messages costs one unpack each.
+
+        python frame_parser.py --bench      # frames per second on this machine
+'''
+
+import struct
+import sys
+import time
+
+
+class FrameParser:
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.resyncs = 0
+        self._structs = {}
+
+    def feed(self, data):
+        self.buffer += data
+
+    def layout(self, fmt):
+        ''' Returns the cached struct.Struct for a format, None if the format is not valid '''
+        try:
+            return self._structs[fmt]
+        except KeyError:
+            try:
+                layout = struct.Struct("<" + fmt)
+            except struct.error:
+                layout = None
+            self._structs[fmt] = layout
+            return layout
+
+    def frames(self):
+        ''' Yields (format, values) for every complete message in the buffer '''
+        buffer = self.buffer
+        end = len(buffer)
+        i = 0
+        while i < end:
+            length = buffer[i]
+            complete = i + 1 + length <= end
+
+            # The format is checked as soon as its \0 is in, a noise byte claiming a long message doesn't hold
+            # up the ones behind it
+            nul = buffer.find(b'\0', i + 1, min(end, i + 1 + length))
+            if nul < 0 and not complete:
+                break
+            layout = None
+            if nul > i + 1:
+                fmt = buffer[i + 1:nul].decode('ascii', 'replace')
+                layout = self.layout(fmt)
+            if layout is None or layout.size != i + length - nul:
+                self.resyncs += 1
+                i += 1
+                continue
+            if not complete:
+                break
+
+            values = layout.unpack_from(buffer, nul + 1)
+            i += 1 + length
+            yield fmt, values
+
+        del buffer[:i]
+
+
+# Per format: how the unpacked values become the callback list
+_plans = {}
+
+
+def _plan(fmt):
+    ''' [(code, count)] for each token of a format, e.g. "c3sh2f" -> c 1, s 3, h 1, f 2 '''
+    plan = []
+    count = ""
+    for code in fmt:
+        if code.isdigit():
+            count += code
+            continue
+        plan.append((code, int(count) if count else 1))
+        count = ""
+    return plan
+
+
+def to_list(fmt, values):
+    ''' The values as serial_monitor_lib's callbacks get them: repeated chars joined into one string, a
+        string field as text (or hex if it isn't text), everything else as unpacked. '''
+    plan = _plans.get(fmt)
+    if plan is None:
+        plan = _plans[fmt] = _plan(fmt)
+
+    data = []
+    i = 0
+    for code, count in plan:
+        if code == 'c':
+            data.append(b"".join(values[i:i + count]).decode('ascii', 'replace'))
+            i += count
+        elif code == 's':
+            try:
+                data.append(values[i].decode('ascii'))
+            except UnicodeDecodeError:
+                data.append(values[i].hex())
+            i += 1
+        elif code == 'x':
+            continue
+        else:
+            data.extend(values[i:i + count])
+            i += count
+    return data
+
+
+def _bench():
+    ''' Parses a mix of the robot's streams, fed in serial sized chunks '''
+    def message(fmt, cmd, *values):
+        body = fmt.encode() + b'\0' + struct.pack("<" + fmt, cmd, *values)
+        return bytes([len(body)]) + body
+
+    mix = (message("cff", b'E', 1200.0, -1180.0) +
+           message("cfhhhh", b'Q', 12.5, 200, -200, 1500, 1490) +
+           message("cBIiifhh", b'Y', 0x07, 12345, 1500, 1490, 7.4, 200, -200) +
+           message("c11s", b'Y', b'\x09\x05\x14\x02\x01\x00\x00\x00\x00\x00\x00'))
+    stream = mix * 5000
+    frames = 4 * 5000
+
+    parser = FrameParser()
+    start = time.perf_counter()
+    for i in range(0, len(stream), 256):
+        parser.feed(stream[i:i + 256])
+        for fmt, values in parser.frames():
+            to_list(fmt, values)
+    elapsed = time.perf_counter() - start
+
+    print("%d frames in %.3f s: %.0f frames/s, %d resyncs" % (frames, elapsed, frames / elapsed, parser.resyncs))
+
+
+if __name__ == "__main__":
+    if "--bench" in sys.argv:
+        _bench()
+    else:
+        print(__doc__)
@@ -33,11 +33,123 @@
 from inputs_mod import get_gamepad, devices
 
 # FOR THREADING AND MUTEX PROTECTION (used in serial interface primarily) 
-from threading import Thread, Lock
+from threading import Thread, Lock, Condition
 import collections  # FOR DEQUEUE USED IN DATA STORAGE AND CALLBACK QUEUES
 
+import sys
 import time
 
+import protocol
+
+'''
+    Teleop drives the robot with 'j' commands: {float linear [m/s], float angular [rad/s]}.
+    The firmware answers nothing and stops the motors if no 'j' arrives for 100 ms
+    (TELEOP_TIMEOUT_MS), so a held stick is resent every TELEOP_KEEPALIVE and a
+    dropped link or a crashed script stops the robot on its own.
+'''
+TELEOP_MIN_INTERVAL = 0.01  # [s] events closer than this are coalesced into one command
+TELEOP_KEEPALIVE = 0.04     # [s] resend period while the robot should be moving
+TELEOP_DEADBAND = 0.05      # stick travel (fraction of full) read as centred
+TELEOP_RESOLUTION = 0.01    # stick travel that counts as a new command
+TELEOP_IDLE = 0.1           # [s] how often an idle pump checks for shutdown
+
+MAX_LIN_VEL = 0.5           # [m/s] at full stick
+MAX_ANG_VEL = 6.28          # [rad/s] at full stick
+
+
+class Teleop:
+    ''' Turns stick positions into velocity commands as they arrive.
+
+        update() is called from the event thread with the stick positions in [-1, 1]
+        and sends straight away unless a command went out less than min_interval ago.
+        run() is the pump thread: it sends what update() had to hold back and the
+        keepalives. send(lin_vel, ang_vel) returns False if nothing took the command.
+    '''
+    def __init__(self, send, min_interval=TELEOP_MIN_INTERVAL, keepalive=TELEOP_KEEPALIVE,
+                 deadband=TELEOP_DEADBAND, resolution=TELEOP_RESOLUTION):
+        self.send = send
+        self.min_interval = min_interval
+        self.keepalive = keepalive
+        self.deadband = deadband
+        self.resolution = resolution
+
+        self.mutex = Lock()
+        self.wake = Condition(self.mutex)
+        self.stick = [0.0, 0.0]     # linear, angular as fractions of full travel
+        self.sent = [0.0, 0.0]
+        self.pending_since = None   # time of the oldest event not sent yet
+        self.last_send = -float("inf")
+        self.commands = 0
+        self.latency = collections.deque(maxlen=1000)  # event to write [s]
+
+    def update(self, linear=None, angular=None, now=None):
+        if now is None:
+            now = time.perf_counter()
+        with self.mutex:
+            if linear is not None:
+                self.stick[0] = 0.0 if abs(linear) < self.deadband else linear
+            if angular is not None:
+                self.stick[1] = 0.0 if abs(angular) < self.deadband else angular
+            if self.pending_since is None and self._changed():
+                self.pending_since = now
+            self._service(now)
+            self.wake.notify()
+
+    def run(self, is_running):
+        with self.mutex:
+            while is_running():
+                wait = self._service(time.perf_counter())
+                self.wake.wait(TELEOP_IDLE if wait is None else min(wait, TELEOP_IDLE))
+
+    def stop(self):
+        ''' Sends a zero command if the robot was last told to move '''
+        self.update(0.0, 0.0)
+
+    def latency_stats(self):
+        ''' Returns (count, median, p99, max) of the event to write latency in seconds '''
+        with self.mutex:
+            samples = sorted(self.latency)
+        if not samples:
+            return (0, 0.0, 0.0, 0.0)
+        n = len(samples)
+        return (n, samples[n//2], samples[min(n-1, int(n*0.99))], samples[-1])
+
+    def _changed(self):
+        for now, last in zip(self.stick, self.sent):
+            if abs(now - last) >= self.resolution or (now == 0) != (last == 0):
+                return True
+        return False
+
+    def _service(self, now):
+        ''' Sends whatever is due, returns the time until something else will be or None '''
+        if self.pending_since is not None:
+            if not self._changed():
+                self.pending_since = None
+            elif now - self.last_send < self.min_interval and any(self.stick):
+                # Stopping never waits
+                return self.last_send + self.min_interval - now
+            else:
+                self._send(now)
+        if not any(self.sent):
+            return None
+        if now - self.last_send >= self.keepalive:
+            self._send(now)
+        return self.last_send + self.keepalive - now
+
+    def _send(self, now):
+        if not self.send(self.stick[0]*MAX_LIN_VEL, self.stick[1]*MAX_ANG_VEL):
+            # Nobody listening, start from rest when somebody is
+            self.sent = [0.0, 0.0]
+            self.pending_since = None
+            return
+        if self.pending_since is not None:
+            self.latency.append(time.perf_counter() - self.pending_since)
+        self.sent = list(self.stick)
+        self.last_send = now
+        self.pending_since = None
+        self.commands += 1
+
+
 class MEGN540_GamePadInterface:
     def __init__(self):
         self.is_running = False
@@ -45,16 +157,11 @@ class MEGN540_GamePadInterface:
         self.cb_thread = None
         self.cbk_list = collections.deque()
         self.callback_list_mutex = Lock()
-        self.rate_mutex = Lock()
-        self.last_send_time = time.perf_counter()
+        self.writer = None
+        self.teleop = Teleop(self.send)
         
         self.gamepad = None
         
-        
-        self.lin_vel = 0
-        self.ang_vel = 0
-        self.changed = True
-        
     def connect(self):
         if self.is_running is False and len(devices.gamepads) > 0:
             
@@ -65,13 +172,15 @@ class MEGN540_GamePadInterface:
             self.is_running = True
             self.thread.start()
             
-            self.cb_thread = Thread(target=self.process_callbacks)
+            self.cb_thread = Thread(target=self.teleop.run, args=(self.is_connected,))
             self.cb_thread.start()
             print("Game Pad Event Handler Started")
         else:
             print("Could not connect to gamepad.")
             
     def disconnect(self):
+        if self.is_running:
+            self.teleop.stop()
         self.is_running = False
         self.gamepad = None
         
@@ -87,6 +196,26 @@ class MEGN540_GamePadInterface:
     def is_connected(self):
         return self.is_running
         
+    def set_writer(self, write):
+        ''' write(bytes) sends packed commands to the robot, e.g. SerialData.writeBytes. None to stop. '''
+        if write is None and self.writer is not None:
+            self.teleop.stop()
+        self.writer = write
+        
+    def send(self, lin_vel, ang_vel):
+        sent = False
+        if self.writer:
+            sent = self.writer(protocol.pack('j', lin_vel, ang_vel)) is not False
+        
+        self.callback_list_mutex.acquire()
+        try:
+            for function in self.cbk_list:
+                function(lin_vel, ang_vel)
+                sent = True
+        finally:
+            self.callback_list_mutex.release()
+        return sent
+        
     def add_callback(self, cbk_function):
         self.callback_list_mutex.acquire()
         try:
@@ -114,79 +243,53 @@ class MEGN540_GamePadInterface:
                     time.sleep(0.0001)
                     continue
                 
+                # One command per batch, sent before the next read
+                linear = None
+                angular = None
                 for event in events:
-                    if event.ev_type is "Absolute":
-                        try:
-                            self.rate_mutex.acquire()
-                        
-                            if event.code is "ABS_X":
-                                #self.ang_vel = -6.28*(event.state-128)/128
-                                #self.changed = True
-                                continue
-                            elif event.code is "ABS_Y":
-                                self.lin_vel = -0.5*(event.state-128)/128
-                                self.changed = True
-                            elif event.code is "ABS_RZ":
-                                #self.lin_vel = -0.5*(event.state-128)/128
-                                #self.changed = True
-                                continue
-                            elif event.code is "ABS_Z":
-                                self.ang_vel = -6.28*(event.state-128)/128
-                                self.changed = True
-                        
-                        finally:
-                            self.rate_mutex.release()
+                    if event.ev_type == "Absolute":
+                        if event.code == "ABS_Y":
+                            linear = -(event.state-128)/128
+                        elif event.code == "ABS_Z":
+                            angular = -(event.state-128)/128
+                
+                if linear is not None or angular is not None:
+                    self.teleop.update(linear, angular)
                        
              except:
                  print("Game pad error! Disconnecting")
                  break;
                     
-            
-                           
-                
         self.is_running = False
-    
-    def process_callbacks(self):
-        while self.is_running:
-            try:
-                self.rate_mutex.acquire()
-                if time.perf_counter() - self.last_send_time > 0.1 and self.changed:
-                    self.callback_list_mutex.acquire()
-                    try:
-                        if abs(self.ang_vel) < 0.01:
-                            self.ang_vel = 0
-                        if abs(self.lin_vel) < 0.01:
-                            self.lin_vel = 0
-                            
-                        for function in self.cbk_list:
-                            function(self.lin_vel, self.ang_vel)
-                    finally:
-                        self.callback_list_mutex.release()
-                    
-                    self.last_send_time = time.perf_counter()
-                    self.changed = False
-            finally:
-                self.rate_mutex.release()
-                
-            time.sleep(0.03)
-                
+        self.teleop.stop()
                 
 
 def print_check(lin,ang):
     print("Lin: " + str(lin) + " Ang: " + str(ang) )
         
 def main():
-    
-    devices.gamepads[0]
-    events = get_gamepad()
+    ''' Drives a robot from the game pad without the GUI: game_pad_interface.py [PORT] '''
     
     interface = MEGN540_GamePadInterface()
-    interface.add_callback(print_check)
+    if len(sys.argv) > 1:
+        import serial
+        port = serial.Serial(sys.argv[1], 115200, timeout=0)
+        interface.set_writer(port.write)
+    else:
+        interface.add_callback(print_check)
     interface.connect()
     
-    while interface.is_connected():
-        continue
+    try:
+        while interface.is_connected():
+            time.sleep(0.1)
+    except KeyboardInterrupt:
+        pass
+    interface.disconnect()
+    
+    count, median, p99, worst = interface.teleop.latency_stats()
+    print("%d commands, event to send latency median %.2f ms, p99 %.2f ms, max %.2f ms"
+          % (count, median*1e3, p99*1e3, worst*1e3))
                 
                 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
@@ -0,0 +1,188 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    link_bench.py measures the USB link with the robot's 'u' command: round
+    trip time from pings, then sustained bandwidth and drops from a stream
+    of numbered packets, through the send ring buffer (the path telemetry
+    takes) and through the bulk path (the raw link).
+
+        python link_bench.py /dev/ttyACM0
+        python link_bench.py /dev/ttyACM0 --pings 500 --count 2000 --size 48
+        python link_bench.py --sim           # no robot, uses Host/BIN/Link_Sim
+
+    Ring packets are limited to what fits in the robot's send buffer (about
+    50 bytes), bulk packets to 64. See Application/Link_Bench.h.
+'''
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import time
+
+import protocol
+from trace_decode import read_messages
+
+MIN_SIZE = 3
+MAX_SIZE = 64
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+REQUEST = protocol.COMMANDS["u"].codec
+PING = struct.Struct("<cHI")
+PACKET = struct.Struct("<cH")
+END = struct.Struct("<cHI")
+
+
+def send(conn, action, count=0, size=0):
+    conn.write(REQUEST.pack(b'u', action, count, size))
+
+
+def replies(conn):
+    ''' Yields (receive time, format, data) for the 'u' replies until the read times out '''
+    for fmt, cmd, data in read_messages(conn.read):
+        if cmd == 'u':
+            yield time.perf_counter(), fmt, data
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[int(round(p * (len(ordered) - 1)))]
+
+
+def run_pings(conn, pings):
+    rtts = []
+    for seq in range(pings):
+        start = time.perf_counter()
+        send(conn, b'P', seq)
+        for now, fmt, data in replies(conn):
+            if fmt == "ccHI" and data[:1] == b'P' and PING.unpack_from(data)[1] == seq:
+                rtts.append((now - start) * 1000.0)
+                break
+            # Anything else is a late reply to an earlier ping
+
+    lost = pings - len(rtts)
+    line = "ping       %d sent, %d answered, loss %.1f%%" % (pings, len(rtts), 100.0 * lost / max(pings, 1))
+    if rtts:
+        line += ", rtt p50 %.2f ms, p99 %.2f ms, max %.2f ms" % (
+            percentile(rtts, 0.5), percentile(rtts, 0.99), max(rtts))
+    print(line)
+
+
+def run_stream(conn, count, size, bulk):
+    name = "bulk" if bulk else "ring"
+    send(conn, b'B' if bulk else b'S', count, size)
+
+    numbers = set()
+    wire_bytes = 0
+    first = last = None
+    end = None
+    for now, fmt, data in replies(conn):
+        if fmt == "cc":
+            print("stream %s  rejected, size %d does not fit this path" % (name, size))
+            return
+        tag = data[:1]
+        if tag == b'D':
+            numbers.add(PACKET.unpack_from(data)[1])
+            # Length byte, format, command and data
+            wire_bytes += 1 + len(fmt) + 1 + 1 + len(data)
+            if first is None:
+                first = now
+            last = now
+        elif tag == b'E':
+            end = END.unpack_from(data)
+            break
+
+    received = len(numbers)
+    dropped = count - received
+    line = "stream %s  %d x %d B: %d received, drop %.1f%%" % (name, count, size, received,
+                                                              100.0 * dropped / max(count, 1))
+    if first is not None and last > first:
+        # The first packet only starts the clock
+        rate = (received - 1) / (last - first)
+        line += ", %.0f B/s (%.0f packets/s)" % (wire_bytes * rate / received, rate)
+    if end is not None:
+        line += ", robot sent %d in %.3f s" % (end[1], end[2] / 1000.0)
+    else:
+        line += ", no end report (timed out)"
+    print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure USB link latency and bandwidth")
+    parser.add_argument("port", nargs="?", help="serial port of the robot")
+    parser.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+    parser.add_argument("--pings", type=int, default=200, help="number of pings (default 200)")
+    parser.add_argument("--count", type=int, default=1000, help="packets per stream (default 1000)")
+    parser.add_argument("--size", type=int, default=32, help="packet data bytes, %d to %d (default 32)"
+                        % (MIN_SIZE, MAX_SIZE))
+    parser.add_argument("--path", choices=["ring", "bulk", "both"], default="both",
+                        help="stream path (default both)")
+    parser.add_argument("--timeout", type=float, default=0.5, help="reply timeout [s] (default 0.5)")
+    args = parser.parse_args()
+
+    if not MIN_SIZE <= args.size <= MAX_SIZE:
+        parser.error("--size must be between %d and %d" % (MIN_SIZE, MAX_SIZE))
+    if not 0 < args.count <= 0xFFFF:
+        parser.error("--count must be between 1 and 65535")
+
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+    elif not args.port:
+        parser.error("give a serial port or --sim")
+
+    # From here on Link_Sim is stopped however the run ends
+    sim = None
+    conn = None
+    try:
+        if args.sim:
+            sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+            port = sim.stdout.readline().strip()
+        else:
+            port = args.port
+
+        import serial
+        conn = serial.Serial(port, 115200, timeout=args.timeout)
+        conn.reset_input_buffer()
+        if args.pings > 0:
+            run_pings(conn, args.pings)
+        for bulk in ([False, True] if args.path == "both" else [args.path == "bulk"]):
+            conn.reset_input_buffer()
+            run_stream(conn, args.count, args.size, bulk)
+    finally:
+        if conn is not None:
+            conn.close()
+        if sim is not None:
+            sim.terminate()
+            sim.wait()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
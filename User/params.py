@@ -0,0 +1,306 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    params.py reads and sets the robot's runtime parameters (see
+    Application/Params.h) by name, on one robot or on a fleet at once:
+
+        python params.py get -p /dev/ttyACM0                 # every parameter
+        python params.py get -p /dev/ttyACM0 wheel_base num_left
+        python params.py set -p /dev/ttyACM0,/dev/ttyACM1 wheel_base=0.097 "num_left[1]=0.125"
+        python params.py apply -p /dev/ttyACM0 -p /dev/ttyACM1 tuned.params --save
+        python params.py save -p /dev/ttyACM0                # also load, defaults
+        python params.py get --sim                           # no robot, uses Host/BIN/Link_Sim
+
+    get prints what apply reads: name=value lines, an array element as
+    name[i]=value, # to the end of a line is a comment. A whole array can be
+    given as name=v0,v1,v2. So one robot's table can be kept in a file,
+    edited and pushed to the rest. set and apply change the running values;
+    --save then writes them to the robot's EEPROM, where the robot loads
+    them from at boot. save, load and defaults act on the EEPROM copy and
+    the compiled-in defaults.
+
+    Robots are done one after another. A robot that rejects a value (its
+    batch of up to PARAMS_CHUNK is then left alone, see 'K') or doesn't
+    answer is reported and the others carry on; the exit status is 1 if any
+    failed.
+
+    Names, ids and types come from the param entries in
+    Application/protocol.def, through protocol.PARAMS. A robot built from
+    another list (its PARAMS_LAYOUT differs) is refused rather than
+    misread.
+
+    read_params(), write_params() and store() can be imported by other
+    scripts.
+'''
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import time
+
+import protocol
+from frame_parser import FrameParser
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+PARAMS_CHUNK = 6        # entries per 'K', see Params.h
+NO_ID = 0xFF
+ACTIONS = {"save": b"\x00", "load": b"\x01", "defaults": b"\x02"}
+TIMEOUT = 2.0           # [s] for a reply, a save writes the EEPROM a byte per loop pass
+
+
+class ParamError(Exception):
+    pass
+
+
+def _ids():
+    ''' id -> (label, struct code), an array element labelled name[i] '''
+    table = {}
+    for p in protocol.PARAMS.values():
+        if p.count:
+            for i in range(p.count):
+                table[p.id + i] = ("%s[%d]" % (p.name, i), p.code)
+        else:
+            table[p.id] = (p.name, p.code)
+    return table
+
+
+IDS = _ids()
+BY_LABEL = dict((label, id) for id, (label, code) in IDS.items())
+
+
+def lookup(name):
+    ''' The ids a name covers: every element of an array, or one element as name[i] '''
+    if name in BY_LABEL:
+        return [BY_LABEL[name]]
+    param = protocol.PARAMS.get(name)
+    if param is None:
+        raise ParamError("no parameter '%s'" % name)
+    return list(range(param.id, param.id + param.count))
+
+
+def parse_value(id, text):
+    code = IDS[id][1]
+    try:
+        return float(text) if code == 'f' else int(text, 0)
+    except ValueError:
+        raise ParamError("%s: bad value '%s'" % (IDS[id][0], text))
+
+
+def format_value(id, value):
+    if IDS[id][1] != 'f':
+        return "%d" % value
+    # Shortest text that reads back as the same float32
+    for digits in range(6, 10):
+        text = "%.*g" % (digits, value)
+        if struct.pack("<f", float(text)) == struct.pack("<f", value):
+            return text
+    return repr(value)
+
+
+def encode(id, value):
+    ''' The 4 byte 'K' value slot: the parameter in its own type, zero padded '''
+    try:
+        data = struct.pack("<" + IDS[id][1], value)
+    except struct.error:
+        raise ParamError("%s: %s is out of range" % (IDS[id][0], value))
+    return struct.unpack("<I", data.ljust(protocol.PARAM_SLOT, b"\0"))[0]
+
+
+def parse_assignments(texts):
+    ''' [(id, value)] from name=value texts, in order '''
+    items = []
+    for text in texts:
+        text = text.split("#", 1)[0].strip()
+        if not text:
+            continue
+        name, equals, values = text.partition("=")
+        if not equals:
+            raise ParamError("expected name=value, got '%s'" % text)
+        ids = lookup(name.strip())
+        values = values.split(",")
+        if len(values) != len(ids):
+            raise ParamError("%s takes %d value%s" % (name.strip(), len(ids), "s" if len(ids) > 1 else ""))
+        for id, value in zip(ids, values):
+            value = parse_value(id, value.strip())
+            encode(id, value)
+            items.append((id, value))
+    return items
+
+
+def exchange(conn, message, cmd, done, timeout=TIMEOUT):
+    ''' Sends message, then hands the values of each cmd reply to done until it returns True '''
+    parser = FrameParser()
+    conn.write(message)
+    deadline = time.perf_counter() + timeout
+    while time.perf_counter() < deadline:
+        parser.feed(conn.read(conn.in_waiting or 1))
+        for fmt, values in parser.frames():
+            if values[0] != cmd.encode():
+                continue
+            if fmt == "cc" and values[1] == b"?":
+                raise ParamError("robot answered '?' to '%s' (built with CONFIG_PARAMS=n?)" % cmd)
+            if done(values):
+                return
+    raise ParamError("no '%s' reply" % cmd)
+
+
+def read_params(conn, first=0, count=0):
+    ''' {id: value} for count parameters from id first, count 0 for the rest '''
+    end = len(IDS) if count == 0 else min(first + count, len(IDS))
+    values = {}
+
+    def done(reply):
+        if reply[1] != protocol.PARAMS_LAYOUT:
+            raise ParamError("robot has another parameter list (layout %04x, here %04x), rebuild one of them"
+                             % (reply[1], protocol.PARAMS_LAYOUT))
+        for i in range(2, len(reply), 2):
+            values[reply[i]] = reply[i + 1]
+        return all(id in values for id in range(first, end))
+
+    exchange(conn, protocol.pack('k', first, count), 'k', done)
+    return values
+
+
+def write_params(conn, items):
+    ''' Sets [(id, value)], PARAMS_CHUNK per 'K'. Raises ParamError at the first batch the robot rejects. '''
+    # A layout check first, ids from another list would set the wrong things
+    read_params(conn, 0, 1)
+    for start in range(0, len(items), PARAMS_CHUNK):
+        batch = items[start:start + PARAMS_CHUNK]
+        ids = [id for id, value in batch] + [0] * (PARAMS_CHUNK - len(batch))
+        slots = [encode(id, value) for id, value in batch] + [0] * (PARAMS_CHUNK - len(batch))
+        result = []
+        exchange(conn, protocol.pack('K', len(batch), *(ids + slots)), 'K', lambda reply: result.append(reply) or True)
+        applied, rejected = result[0][1:]
+        if rejected != NO_ID:
+            value = dict(batch).get(rejected)
+            raise ParamError("robot rejected %s=%s, %d set before it" % (
+                IDS[rejected][0] if rejected in IDS else rejected, value, start))
+
+
+def store(conn, action):
+    ''' 'save', 'load' or 'defaults'. Raises ParamError if the robot has no saved copy to load. '''
+    result = []
+    exchange(conn, protocol.pack('n', ACTIONS[action]), 'n', lambda reply: result.append(reply) or True)
+    if not result[0][2]:
+        raise ParamError("no valid parameters in the robot's EEPROM")
+
+
+def run(conn, args, items):
+    ''' One robot. Returns the lines to print. '''
+    if args.command == "get":
+        ids = sorted(set(id for name in args.names for id in lookup(name))) if args.names else sorted(IDS)
+        values = read_params(conn, ids[0], ids[-1] - ids[0] + 1)
+        return ["%s=%s" % (IDS[id][0], format_value(id, values[id])) for id in ids]
+
+    if args.command in ("set", "apply"):
+        write_params(conn, items)
+        if args.save:
+            store(conn, "save")
+        return ["set %d value%s%s" % (len(items), "s" if len(items) != 1 else "", ", saved" if args.save else "")]
+
+    store(conn, args.command)
+    return ["%s done" % args.command]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Read and set the robot's runtime parameters")
+    sub = parser.add_subparsers(dest="command")
+    sub.required = True
+
+    def add(name, help):
+        p = sub.add_parser(name, help=help)
+        p.add_argument("-p", "--port", action="append", default=[],
+                       help="serial port, repeat it or separate with commas for several robots")
+        p.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+        return p
+
+    add("get", "print parameters as name=value").add_argument("names", nargs="*", help="default all")
+    p = add("set", "set name=value ...")
+    p.add_argument("assignments", nargs="+")
+    p.add_argument("--save", action="store_true", help="then write them to EEPROM")
+    p = add("apply", "set the name=value lines of a file (get's output)")
+    p.add_argument("file")
+    p.add_argument("--save", action="store_true", help="then write them to EEPROM")
+    add("save", "write the running values to EEPROM")
+    add("load", "reload the values saved in EEPROM")
+    add("defaults", "go back to the compiled-in defaults (the EEPROM copy is kept)")
+    args = parser.parse_args()
+
+    try:
+        items = []
+        if args.command == "set":
+            items = parse_assignments(args.assignments)
+        elif args.command == "apply":
+            with open(args.file) as f:
+                items = parse_assignments(f.readlines())
+        elif args.command == "get":
+            for name in args.names:
+                lookup(name)
+    except (ParamError, OSError) as e:
+        parser.error(str(e))
+
+    ports = [port for ports in args.port for port in ports.split(",") if port]
+    sim = None
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+        ports.append(sim.stdout.readline().strip())
+    if not ports:
+        parser.error("give a serial port (-p) or --sim")
+
+    import serial
+    failed = 0
+    try:
+        for port in ports:
+            try:
+                conn = serial.Serial(port, 115200, timeout=0.01)
+                try:
+                    conn.reset_input_buffer()
+                    lines = run(conn, args, items)
+                finally:
+                    conn.close()
+            except (ParamError, OSError) as e:     # serial.SerialException is an OSError
+                print("%s: %s" % (port, e), file=sys.stderr)
+                failed += 1
+                continue
+            if len(ports) > 1:
+                print("# %s" % port)
+            print("\n".join(lines))
+    finally:
+        if sim is not None:
+            sim.terminate()
+            sim.wait()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,113 @@
+'''
+    protocol.py, generated by protocol_gen.py from Application/protocol.def.
+    Do not edit: change the schema and run python3 protocol_gen.py
+
+    Every command has a precompiled struct.Struct that includes the command
+    char. char fields take and give 1 byte bytes objects:
+
+        protocol.pack('V', 0.2, 0.0, 1.0)
+        protocol.COMMANDS['Y'].codec.pack(b'Y', 0, 0.01)
+        protocol.unpack(message)        -> ('V', (0.2, 0.0, 1.0))
+
+    An array field takes and gives its elements in place, in order.
+'''
+
+import collections
+import struct
+
+Command = collections.namedtuple("Command", "char name feature fields codec")
+Channel = collections.namedtuple("Channel", "name fmt fields scales")
+Param = collections.namedtuple("Param", "id name code count")
+
+COMMANDS = collections.OrderedDict([
+    ('~', Command('~', 'reset', None, (), struct.Struct('<c'))),
+    ('*', Command('*', 'multiply', None, ('v1', 'v2'), struct.Struct('<cff'))),
+    ('/', Command('/', 'divide', None, ('v1', 'v2'), struct.Struct('<cff'))),
+    ('+', Command('+', 'add', None, ('v1', 'v2'), struct.Struct('<cff'))),
+    ('-', Command('-', 'subtract', None, ('v1', 'v2'), struct.Struct('<cff'))),
+    ('t', Command('t', 'time', None, ('action',), struct.Struct('<cc'))),
+    ('T', Command('T', 'time_repeat', None, ('action', 'duration'), struct.Struct('<ccf'))),
+    ('c', Command('c', 'clock_sync', None, ('sequence',), struct.Struct('<cB'))),
+    ('e', Command('e', 'encoders', None, (), struct.Struct('<c'))),
+    ('E', Command('E', 'encoders_repeat', None, ('duration',), struct.Struct('<cf'))),
+    ('b', Command('b', 'battery', None, (), struct.Struct('<c'))),
+    ('B', Command('B', 'battery_repeat', None, ('duration',), struct.Struct('<cf'))),
+    ('q', Command('q', 'status', None, (), struct.Struct('<c'))),
+    ('Q', Command('Q', 'status_repeat', None, ('duration',), struct.Struct('<cf'))),
+    ('p', Command('p', 'pwm', None, ('left', 'right'), struct.Struct('<chh'))),
+    ('P', Command('P', 'pwm_timed', None, ('left', 'right', 'duration'), struct.Struct('<chhf'))),
+    ('s', Command('s', 'stop', None, (), struct.Struct('<c'))),
+    ('S', Command('S', 'halt', None, (), struct.Struct('<c'))),
+    ('d', Command('d', 'distance', None, ('linear', 'angular'), struct.Struct('<cff'))),
+    ('D', Command('D', 'distance_timed', None, ('linear', 'angular', 'duration'), struct.Struct('<cfff'))),
+    ('v', Command('v', 'velocity', None, ('velocity', 'angular'), struct.Struct('<cff'))),
+    ('V', Command('V', 'velocity_timed', None, ('velocity', 'angular', 'duration'), struct.Struct('<cfff'))),
+    ('j', Command('j', 'teleop', 'TELEOP', ('linear', 'angular'), struct.Struct('<cff'))),
+    ('i', Command('i', 'ir', 'IR', (), struct.Struct('<c'))),
+    ('I', Command('I', 'ir_repeat', 'IR', ('duration',), struct.Struct('<cf'))),
+    ('G', Command('G', 'gripper', 'SERVO', ('action',), struct.Struct('<cc'))),
+    ('g', Command('g', 'gripper_move', 'SERVO', ('position', 'speed'), struct.Struct('<cBf'))),
+    ('O', Command('O', 'avoid', 'OA', ('duration',), struct.Struct('<cf'))),
+    ('h', Command('h', 'profiler', 'PROFILER', ('action',), struct.Struct('<cc'))),
+    ('l', Command('l', 'trace', 'TRACE', ('action',), struct.Struct('<cc'))),
+    ('W', Command('W', 'trajectory_segment', 'TRAJECTORY', ('type', 'p1', 'p2', 'p3'), struct.Struct('<ccfff'))),
+    ('w', Command('w', 'trajectory_control', 'TRAJECTORY', ('action',), struct.Struct('<cc'))),
+    ('u', Command('u', 'link_bench', 'LINK_BENCH', ('action', 'count', 'size'), struct.Struct('<ccHB'))),
+    ('m', Command('m', 'ram_report', 'STACK', (), struct.Struct('<c'))),
+    ('Y', Command('Y', 'telemetry_subscribe', 'TELEMETRY', ('channel', 'period'), struct.Struct('<cBf'))),
+    ('y', Command('y', 'telemetry_encoding', 'TELEMETRY', ('encoding', 'interval'), struct.Struct('<cBB'))),
+    ('k', Command('k', 'param_get', 'PARAMS', ('first', 'count'), struct.Struct('<cBB'))),
+    ('K', Command('K', 'param_set', 'PARAMS', ('count', 'id', 'value'), struct.Struct('<cB6B6I'))),
+    ('n', Command('n', 'param_store', 'PARAMS', ('action',), struct.Struct('<cc'))),
+])
+
+BY_NAME = dict((c.name, c) for c in COMMANDS.values())
+
+# Telemetry channels in bit order, scales turn delta frame integers back into units
+CHANNELS = [
+    Channel('encoders', 'ii', ('left', 'right'), (1, 1)),
+    Channel('battery', 'f', ('volts',), (0.001,)),
+    Channel('pwm', 'hh', ('left', 'right'), (1, 1)),
+    Channel('pose', 'fff', ('x', 'y', 'heading'), (0.001, 0.001, 0.001)),
+    Channel('ir', 'hc', ('count', 'side'), (1, None)),
+    Channel('control', 'ff', ('target_left', 'target_right'), (0.001, 0.001)),
+]
+
+# Runtime parameters by name (Params.h), an array takes count ids from id
+PARAMS = collections.OrderedDict([
+    ('wheel_base', Param(0, 'wheel_base', 'f', None)),
+    ('distance_per_count', Param(1, 'distance_per_count', 'f', None)),
+    ('turn_velocity', Param(2, 'turn_velocity', 'f', None)),
+    ('min_turn_arc', Param(3, 'min_turn_arc', 'f', None)),
+    ('spin_dutycycle', Param(4, 'spin_dutycycle', 'h', None)),
+    ('dist_accel', Param(5, 'dist_accel', 'f', None)),
+    ('dist_creep', Param(6, 'dist_creep', 'f', None)),
+    ('oa_turn_velocity', Param(7, 'oa_turn_velocity', 'f', None)),
+    ('oa_angular_velocity', Param(8, 'oa_angular_velocity', 'f', None)),
+    ('oa_drive_duty', Param(9, 'oa_drive_duty', 'h', None)),
+    ('oa_hold_timeout', Param(10, 'oa_hold_timeout', 'H', None)),
+    ('teleop_timeout_ms', Param(11, 'teleop_timeout_ms', 'H', None)),
+    ('kp_left', Param(12, 'kp_left', 'f', None)),
+    ('num_left', Param(13, 'num_left', 'f', 3)),
+    ('den_left', Param(16, 'den_left', 'f', 3)),
+    ('kp_right', Param(19, 'kp_right', 'f', None)),
+    ('num_right', Param(20, 'num_right', 'f', 3)),
+    ('den_right', Param(23, 'den_right', 'f', 3)),
+])
+PARAMS_LAYOUT = 0xAD86
+PARAM_SLOT = 4
+
+
+def length(char):
+    ''' Length of a command including its char, 0 if unknown '''
+    command = COMMANDS.get(char)
+    return command.codec.size if command else 0
+
+
+def pack(char, *values):
+    return COMMANDS[char].codec.pack(char.encode(), *values)
+
+
+def unpack(message):
+    char = message[:1].decode()
+    return char, COMMANDS[char].codec.unpack(message)[1:]
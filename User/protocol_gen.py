@@ -0,0 +1,584 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    protocol_gen.py turns Application/protocol.def, the one description of
+    the messages on the USB link, into code for both ends:
+
+        Application/MEGN540_Protocol.h   packed payload structs, telemetry
+                                         channel structs and formats, the
+                                         command length table (in flash) and
+                                         the runtime parameter table t_Params
+        User/protocol.py                 struct.Struct codecs for the same,
+                                         and the parameters by name
+
+        python3 protocol_gen.py            regenerate both
+        python3 protocol_gen.py --check    fail if either is stale, then check
+                                           C and Python against each other
+
+    --check packs a golden value for every field with the Python codecs,
+    builds a small program that fills the C structs with the same values
+    (gcc, against Host/'s stand-in headers) and compares the bytes and the
+    lengths, and each parameter's id and type. Without gcc only the Python
+    half runs. "make protocol-check" in
+    Host/ runs it too.
+'''
+
+import argparse
+import binascii
+import collections
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+SCHEMA_PATH = os.path.join(ROOT, "Application", "protocol.def")
+C_PATH = os.path.join(ROOT, "Application", "MEGN540_Protocol.h")
+PY_PATH = os.path.join(ROOT, "User", "protocol.py")
+
+# schema type: (C type, struct code)
+TYPES = collections.OrderedDict([
+    ("char", ("char", "c")),
+    ("u8", ("uint8_t", "B")),
+    ("i8", ("int8_t", "b")),
+    ("u16", ("uint16_t", "H")),
+    ("i16", ("int16_t", "h")),
+    ("u32", ("uint32_t", "I")),
+    ("i32", ("int32_t", "i")),
+    ("f32", ("float", "f")),
+])
+
+Field = collections.namedtuple("Field", "type name scale count")
+Command = collections.namedtuple("Command", "line char name feature fields")
+Channel = collections.namedtuple("Channel", "line name fields")
+Param = collections.namedtuple("Param", "line id name type count default")
+
+# Largest parameter type, the value slot of a 'K' entry
+PARAM_SLOT = 4
+
+
+class SchemaError(Exception):
+    pass
+
+
+def camel(name):
+    return "".join(part.capitalize() for part in name.split("_"))
+
+
+def code(type, count=None):
+    return ("%d" % count if count else "") + TYPES[type][1]
+
+
+def fmt(fields):
+    return "".join(code(f.type, f.count) for f in fields)
+
+
+def decl(f):
+    return "%s %s%s;" % (TYPES[f.type][0], f.name, "[%d]" % f.count if f.count else "")
+
+
+def size(fields):
+    return struct.calcsize("<" + fmt(fields))
+
+
+def parse_array(text):
+    ''' Splits "name[4]" into ("name", 4), "name" into ("name", None). count is 0 if it is not a number. '''
+    name, bracket, rest = text.partition("[")
+    if not bracket:
+        return name, None
+    return name, int(rest[:-1]) if rest.endswith("]") and rest[:-1].isdigit() else 0
+
+
+def parse_field(text, where, scaled):
+    ''' type:name or type:name[count] for commands, type:name:scale for telemetry channels '''
+    parts = text.split(":")
+    name, count = parse_array(parts[1]) if len(parts) > 1 else ("", None)
+    if (len(parts) != (3 if scaled else 2) or parts[0] not in TYPES or not name.isidentifier() or count == 0
+            or (scaled and count)):
+        raise SchemaError("%s: bad field '%s', expected type:name%s with type one of %s"
+                          % (where, text, ":scale" if scaled else "[count]", " ".join(TYPES)))
+    scale = None
+    if scaled and parts[2] != "-":
+        try:
+            scale = int(parts[2]) if parts[2].lstrip("-").isdigit() else float(parts[2])
+        except ValueError:
+            raise SchemaError("%s: bad scale '%s'" % (where, parts[2]))
+    return Field(parts[0], name, scale, count)
+
+
+def parse(lines, path="<schema>"):
+    ''' Returns (commands, channels, params) in file order '''
+    commands = []
+    channels = []
+    params = []
+    for number, line in enumerate(lines, 1):
+        where = "%s:%d" % (path, number)
+        words = line.split("#", 1)[0].split()
+        if not words:
+            continue
+        if words[0] == "command":
+            if len(words) < 4 or len(words[1]) != 1 or ord(words[1]) >= 128:
+                raise SchemaError("%s: expected command <char> <name> <feature> [type:field ...]" % where)
+            feature = None if words[3] == "-" else words[3]
+            fields = [parse_field(w, where, False) for w in words[4:]]
+            commands.append(Command(number, words[1], words[2], feature, fields))
+        elif words[0] == "channel":
+            if len(words) < 3:
+                raise SchemaError("%s: expected channel <name> type:field:scale ..." % where)
+            channels.append(Channel(number, words[1], [parse_field(w, where, True) for w in words[2:]]))
+        elif words[0] == "param":
+            type, count = parse_array(words[3]) if len(words) == 5 else ("", None)
+            if (len(words) != 5 or not words[1].isdigit() or not words[2].isidentifier() or type not in TYPES
+                    or type == "char" or struct.calcsize(code(type)) > PARAM_SLOT or count == 0):
+                raise SchemaError("%s: expected param <id> <name> <type>[count] <default>, type a number of up to"
+                                  " %d bytes" % (where, PARAM_SLOT))
+            params.append(Param(number, int(words[1]), words[2], type, count, words[4]))
+        else:
+            raise SchemaError("%s: unknown entry '%s'" % (where, words[0]))
+
+    for kind, items, key in (("command", commands, lambda c: c.char), ("name", commands, lambda c: c.name),
+                             ("channel", channels, lambda c: c.name)):
+        seen = {}
+        for item in items:
+            if key(item) in seen:
+                raise SchemaError("%s:%d: %s '%s' already defined on line %d"
+                                  % (path, item.line, kind, key(item), seen[key(item)]))
+            seen[key(item)] = item.line
+        for item in items:
+            names = [f.name for f in item.fields]
+            if len(set(names)) != len(names):
+                raise SchemaError("%s:%d: repeated field name" % (path, item.line))
+    for command in commands:
+        if 1 + size(command.fields) > 255:
+            raise SchemaError("%s:%d: '%s' is longer than 255 bytes" % (path, command.line, command.char))
+
+    # Ids never move once robots have saved them, so they are spelled out and checked
+    next_id = 0
+    names = set()
+    for param in params:
+        if param.id != next_id:
+            raise SchemaError("%s:%d: param '%s' should have id %d" % (path, param.line, param.name, next_id))
+        if param.name in names:
+            raise SchemaError("%s:%d: param '%s' already defined" % (path, param.line, param.name))
+        names.add(param.name)
+        next_id += param.count or 1
+    if next_id > 255:
+        raise SchemaError("%s: more than 255 param ids" % path)
+    return commands, channels, params
+
+
+def load(path=SCHEMA_PATH):
+    with open(path) as f:
+        return parse(f.readlines(), os.path.relpath(path, ROOT))
+
+
+def c_char(char):
+    return "'\\''" if char == "'" else "'\\\\'" if char == "\\" else "'%s'" % char
+
+
+def param_ids(params):
+    ''' (id, param, index) for every id, index None for a scalar '''
+    for p in params:
+        for i in range(p.count or 1):
+            yield p.id + i, p, i if p.count else None
+
+
+def layout(params):
+    ''' 16-bit signature of the parameter list, saved tables from another list are not loaded '''
+    text = " ".join("%d:%s:%s" % (p.id, p.name, code(p.type, p.count)) for p in params)
+    return binascii.crc_hqx(text.encode(), 0xFFFF)
+
+
+def render_c(commands, channels, params):
+    out = []
+    w = out.append
+    w("/*")
+    w(" * MEGN540_Protocol.h, generated by User/protocol_gen.py from")
+    w(" * Application/protocol.def. Do not edit: change the schema and run")
+    w(" *")
+    w(" *      python3 User/protocol_gen.py")
+    w(" *")
+    w(" * t_Msg_<Name> is a command's payload, the bytes after its char, ready for")
+    w(" * usb_msg_read_into. t_Telem_<Name> and TELEM_FMT_<NAME> are a telemetry")
+    w(" * channel's data and format in a plain 'Y' frame. t_Params is the runtime")
+    w(" * parameter table, see Params.h.")
+    w(" */")
+    w("#ifndef MEGN540_PROTOCOL_H")
+    w("#define MEGN540_PROTOCOL_H")
+    w("")
+    w("#include <stddef.h>")
+    w("#include <stdint.h>")
+    w("#include <avr/pgmspace.h>")
+    w("")
+    w("/*")
+    w(" * Command payloads")
+    w(" */")
+    for c in commands:
+        if not c.fields:
+            continue
+        w("// %s %s" % (c_char(c.char), c.name))
+        w("typedef struct __attribute__((__packed__)) {")
+        for f in c.fields:
+            w("\t%s" % decl(f))
+        w("} t_Msg_%s;" % camel(c.name))
+        w("_Static_assert(sizeof(t_Msg_%s) == %d, \"%s payload is %d bytes\");"
+          % (camel(c.name), size(c.fields), c_char(c.char).replace("\\", "\\\\"), size(c.fields)))
+        w("")
+    w("/*")
+    w(" * Telemetry channels, in eTelemChannel order")
+    w(" */")
+    for ch in channels:
+        w("#define TELEM_FMT_%s\t\"%s\"" % (ch.name.upper(), fmt(ch.fields)))
+        w("typedef struct __attribute__((__packed__)) {")
+        for f in ch.fields:
+            w("\t%s" % decl(f))
+        w("} t_Telem_%s;" % camel(ch.name))
+        w("_Static_assert(sizeof(t_Telem_%s) == %d, \"%s channel is %d bytes\");"
+          % (camel(ch.name), size(ch.fields), ch.name, size(ch.fields)))
+        w("")
+    w("/*")
+    w(" * Function MEGN540_Protocol_Len returns the length of command cmd including its char, 0 if it is")
+    w(" * unknown or its feature is off. The table lives in flash, one byte per 7-bit char.")
+    w(" */")
+    w("static inline uint8_t MEGN540_Protocol_Len(char cmd)")
+    w("{")
+    w("\tstatic const uint8_t lengths[128] PROGMEM = {")
+    feature = None
+    for c in commands:
+        if c.feature != feature:
+            if feature:
+                w("#endif")
+            if c.feature:
+                w("#ifdef CONFIG_%s" % c.feature)
+            feature = c.feature
+        w("\t\t[%s] = %d," % (c_char(c.char), 1 + size(c.fields)))
+    if feature:
+        w("#endif")
+    w("\t};")
+    w("")
+    w("\tif((uint8_t)cmd >= sizeof(lengths)) {")
+    w("\t\treturn 0;")
+    w("\t}")
+    w("\treturn pgm_read_byte(&lengths[(uint8_t)cmd]);")
+    w("}")
+    w("")
+    w("/*")
+    w(" * Runtime parameters. An id addresses one value, an array takes an id per")
+    w(" * element. The defaults are the constants named in the schema, defined")
+    w(" * where PARAMS_DEFAULTS is used.")
+    w(" */")
+    w("#define PARAMS_COUNT\t%d" % sum(p.count or 1 for p in params))
+    w("#define PARAMS_LAYOUT\t0x%04X\t// changes with the ids, names and types" % layout(params))
+    w("")
+    w("typedef struct {")
+    for p in params:
+        ids = "%d" % p.id if not p.count else "%d to %d" % (p.id, p.id + p.count - 1)
+        w("\t%s\t// %s" % (decl(Field(p.type, p.name, None, p.count)), ids))
+    w("} t_Params;")
+    w("_Static_assert(sizeof(t_Params) <= 255, \"t_Params offsets fit a byte\");")
+    w("")
+    w("#define PARAMS_DEFAULTS { \\")
+    for p in params:
+        w("\t.%s = %s, \\" % (p.name, p.default))
+    w("}")
+    w("")
+    w("typedef struct { uint8_t offset; char code; } t_Param_Info;")
+    w("")
+    w("/*")
+    w(" * Function MEGN540_Param_Info returns where parameter id lives in t_Params and its struct code ('f',")
+    w(" * 'h', 'B', ...), code 0 if there is no such id. The table lives in flash.")
+    w(" */")
+    w("static inline t_Param_Info MEGN540_Param_Info(uint8_t id)")
+    w("{")
+    w("\tstatic const t_Param_Info info[PARAMS_COUNT] PROGMEM = {")
+    for id, p, index in param_ids(params):
+        member = p.name if index is None else "%s[%d]" % (p.name, index)
+        w("\t\t{ offsetof(t_Params, %s), '%s' },\t// %d" % (member, code(p.type), id))
+    w("\t};")
+    w("")
+    w("\tt_Param_Info param = { 0, 0 };")
+    w("\tif(id < PARAMS_COUNT) {")
+    w("\t\tparam.offset = pgm_read_byte(&info[id].offset);")
+    w("\t\tparam.code = pgm_read_byte(&info[id].code);")
+    w("\t}")
+    w("\treturn param;")
+    w("}")
+    w("")
+    w("#endif")
+    return "\n".join(out) + "\n"
+
+
+def render_py(commands, channels, params):
+    out = []
+    w = out.append
+    w("'''")
+    w("    protocol.py, generated by protocol_gen.py from Application/protocol.def.")
+    w("    Do not edit: change the schema and run python3 protocol_gen.py")
+    w("")
+    w("    Every command has a precompiled struct.Struct that includes the command")
+    w("    char. char fields take and give 1 byte bytes objects:")
+    w("")
+    w("        protocol.pack('V', 0.2, 0.0, 1.0)")
+    w("        protocol.COMMANDS['Y'].codec.pack(b'Y', 0, 0.01)")
+    w("        protocol.unpack(message)        -> ('V', (0.2, 0.0, 1.0))")
+    w("")
+    w("    An array field takes and gives its elements in place, in order.")
+    w("'''")
+    w("")
+    w("import collections")
+    w("import struct")
+    w("")
+    w("Command = collections.namedtuple(\"Command\", \"char name feature fields codec\")")
+    w("Channel = collections.namedtuple(\"Channel\", \"name fmt fields scales\")")
+    w("Param = collections.namedtuple(\"Param\", \"id name code count\")")
+    w("")
+    w("COMMANDS = collections.OrderedDict([")
+    for c in commands:
+        w("    (%r, Command(%r, %r, %r, %r, struct.Struct(%r)))," % (
+            c.char, c.char, c.name, c.feature, tuple(f.name for f in c.fields), "<c" + fmt(c.fields)))
+    w("])")
+    w("")
+    w("BY_NAME = dict((c.name, c) for c in COMMANDS.values())")
+    w("")
+    w("# Telemetry channels in bit order, scales turn delta frame integers back into units")
+    w("CHANNELS = [")
+    for ch in channels:
+        w("    Channel(%r, %r, %r, %r)," % (ch.name, fmt(ch.fields), tuple(f.name for f in ch.fields),
+                                           tuple(f.scale for f in ch.fields)))
+    w("]")
+    w("")
+    w("# Runtime parameters by name (Params.h), an array takes count ids from id")
+    w("PARAMS = collections.OrderedDict([")
+    for p in params:
+        w("    (%r, Param(%d, %r, %r, %r))," % (p.name, p.id, p.name, code(p.type), p.count))
+    w("])")
+    w("PARAMS_LAYOUT = 0x%04X" % layout(params))
+    w("PARAM_SLOT = %d" % PARAM_SLOT)
+    w("")
+    w("")
+    w("def length(char):")
+    w("    ''' Length of a command including its char, 0 if unknown '''")
+    w("    command = COMMANDS.get(char)")
+    w("    return command.codec.size if command else 0")
+    w("")
+    w("")
+    w("def pack(char, *values):")
+    w("    return COMMANDS[char].codec.pack(char.encode(), *values)")
+    w("")
+    w("")
+    w("def unpack(message):")
+    w("    char = message[:1].decode()")
+    w("    return char, COMMANDS[char].codec.unpack(message)[1:]")
+    return "\n".join(out) + "\n"
+
+
+def generated(commands, channels, params):
+    return [(C_PATH, render_c(commands, channels, params)), (PY_PATH, render_py(commands, channels, params))]
+
+
+# Golden values, exact in every type so C and Python must agree bit for bit
+def golden(field, i):
+    return {
+        "char": lambda: chr(ord("A") + i),
+        "u8": lambda: 250 - i,
+        "i8": lambda: -100 + i,
+        "u16": lambda: 60000 - i,
+        "i16": lambda: -30000 + i,
+        "u32": lambda: 4000000000 - i,
+        "i32": lambda: -2000000000 + i,
+        "f32": lambda: 1.5 - 2.25 * i,
+    }[field.type]()
+
+
+def golden_c(field, i):
+    if field.count:
+        return "{ %s }" % ", ".join(golden_c(field._replace(count=None), i + j) for j in range(field.count))
+    value = golden(field, i)
+    if field.type == "char":
+        return c_char(value)
+    if field.type == "f32":
+        return repr(value) + "f"
+    if field.type == "u32":
+        return "%du" % value
+    if field.type == "i32":
+        return "(-%d - 1)" % (-value - 1)
+    return str(value)
+
+
+def golden_py(fields):
+    values = []
+    for i, f in enumerate(fields):
+        for j in range(f.count or 1):
+            value = golden(f, i + j)
+            values.append(value.encode() if f.type == "char" else value)
+    return values
+
+
+def check_python(module, commands, channels, params):
+    ''' Round trips the golden values through the generated codecs, returns a list of problems '''
+    problems = []
+    for c in commands:
+        values = golden_py(c.fields)
+        message = module.pack(c.char, *values)
+        if len(message) != 1 + size(c.fields) or module.length(c.char) != len(message):
+            problems.append("'%s' packs to %d bytes, the schema says %d" % (c.char, len(message), 1 + size(c.fields)))
+        char, decoded = module.unpack(message)
+        if char != c.char or list(decoded) != values:
+            problems.append("'%s' doesn't decode to what was packed" % c.char)
+    if [ch.name for ch in module.CHANNELS] != [ch.name for ch in channels]:
+        problems.append("telemetry channels differ")
+    if list(module.PARAMS) != [p.name for p in params] or module.PARAMS_LAYOUT != layout(params):
+        problems.append("parameters differ")
+    return problems
+
+
+def golden_bytes(commands, channels, params, module):
+    ''' Expected output of the C check program: one line per command and channel '''
+    lines = []
+    for c in commands:
+        lines.append("command %s %d %s" % (c.char, 1 + size(c.fields),
+                                          module.pack(c.char, *golden_py(c.fields))[1:].hex()))
+    for ch in channels:
+        lines.append("channel %s %s %s" % (ch.name, fmt(ch.fields),
+                                          struct.pack("<" + fmt(ch.fields), *golden_py(ch.fields)).hex()))
+    lines.append("params %d %04x" % (sum(p.count or 1 for p in params), module.PARAMS_LAYOUT))
+    for id, p, index in param_ids(params):
+        lines.append("param %d %s" % (id, module.PARAMS[p.name].code))
+    return lines
+
+
+def check_c(commands, channels, params, header):
+    ''' Builds the C half of the golden check, returns its output lines or None without gcc '''
+    cc = shutil.which("gcc") or shutil.which("cc")
+    if not cc:
+        return None
+    out = []
+    w = out.append
+    w("#include <stdio.h>")
+    w("#include \"MEGN540_Protocol.h\"")
+    w("")
+    w("static void hex(const void* p, unsigned int len) {")
+    w("\tfor(unsigned int i = 0; i < len; i++) printf(\"%02x\", ((const unsigned char*)p)[i]);")
+    w("\tprintf(\"\\n\");")
+    w("}")
+    w("")
+    w("int main() {")
+    for c in commands:
+        w("\tprintf(\"command %%c %%d \", %s, MEGN540_Protocol_Len(%s));" % (c_char(c.char), c_char(c.char)))
+        if c.fields:
+            w("\t{ t_Msg_%s m = { %s }; hex(&m, sizeof(m)); }" % (
+                camel(c.name), ", ".join(golden_c(f, i) for i, f in enumerate(c.fields))))
+        else:
+            w("\thex(0, 0);")
+    for ch in channels:
+        w("\tprintf(\"channel %s %%s \", TELEM_FMT_%s);" % (ch.name, ch.name.upper()))
+        w("\t{ t_Telem_%s m = { %s }; hex(&m, sizeof(m)); }" % (
+            camel(ch.name), ", ".join(golden_c(f, i) for i, f in enumerate(ch.fields))))
+    w("\tprintf(\"params %d %04x\\n\", PARAMS_COUNT, PARAMS_LAYOUT);")
+    w("\tfor(int id = 0; id < PARAMS_COUNT; id++) printf(\"param %d %c\\n\", id, MEGN540_Param_Info(id).code);")
+    w("\treturn 0;")
+    w("}")
+
+    features = sorted(set(c.feature for c in commands if c.feature))
+    tmp = tempfile.mkdtemp()
+    try:
+        with open(os.path.join(tmp, "MEGN540_Protocol.h"), "w") as f:
+            f.write(header)
+        source = os.path.join(tmp, "check.c")
+        with open(source, "w") as f:
+            f.write("\n".join(out) + "\n")
+        binary = os.path.join(tmp, "check")
+        # Host/avr stands in for avr-libc's pgmspace.h
+        subprocess.run([cc, "-std=gnu99", "-Wall", "-Werror", "-I", tmp, "-I", os.path.join(ROOT, "Host"),
+                        "-o", binary, source] + ["-DCONFIG_" + f for f in features], check=True)
+        return subprocess.run([binary], check=True, stdout=subprocess.PIPE).stdout.decode().splitlines()
+    finally:
+        shutil.rmtree(tmp)
+
+
+def check(commands, channels, params):
+    ok = True
+    for path, text in generated(commands, channels, params):
+        try:
+            with open(path) as f:
+                current = f.read()
+        except OSError:
+            current = None
+        if current != text:
+            print("%s is out of date, run protocol_gen.py" % os.path.relpath(path, ROOT))
+            ok = False
+
+    # Check what the schema generates now, the files on disk were checked above
+    module = type(sys)("protocol")
+    exec(render_py(commands, channels, params), module.__dict__)
+    problems = check_python(module, commands, channels, params)
+
+    try:
+        lines = check_c(commands, channels, params, render_c(commands, channels, params))
+        if lines is None:
+            print("no C compiler, only the Python codecs were checked")
+        else:
+            want = golden_bytes(commands, channels, params, module)
+            for expected, got in zip(want, lines + [""] * len(want)):
+                if expected != got:
+                    problems.append("C and Python differ:\n    python  %s\n    C       %s" % (expected, got))
+    except (subprocess.CalledProcessError, OSError) as e:
+        problems.append("C check failed: %s" % e)
+
+    for problem in problems:
+        print(problem)
+    if ok and not problems:
+        print("%d commands, %d telemetry channels and %d parameters agree" % (len(commands), len(channels),
+                                                                          len(params)))
+    return ok and not problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the C and Python protocol code from protocol.def")
+    parser.add_argument("--check", action="store_true",
+                        help="check the generated files are current and that C and Python agree")
+    args = parser.parse_args()
+
+    try:
+        commands, channels, params = load()
+    except (SchemaError, OSError) as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    if args.check:
+        return 0 if check(commands, channels, params) else 1
+
+    for path, text in generated(commands, channels, params):
+        with open(path, "w") as f:
+            f.write(text)
+        print("wrote %s" % os.path.relpath(path, ROOT))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,317 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    ram_report.py reports where the 32U4's 2.5 KB of RAM goes, from the
+    build output (run 'make ram' in Application/, which builds with
+    -fstack-usage and calls this):
+
+        python ram_report.py ../Application/BIN/Main.elf ../Application/BIN
+        python ram_report.py Main.elf BIN --port /dev/ttyACM0   # add the measured peak
+
+    Static RAM: the .data, .bss and .noinit sections and the largest
+    variables in them, read from the ELF symbol table.
+
+    Stack: the frame of every function from the .su files gcc writes with
+    -fstack-usage. On AVR a frame includes the return address and the
+    saved registers. When avr-objdump is available the call graph is taken
+    from the disassembly and the deepest path is worked out from main and
+    from each interrupt handler. Interrupts don't nest in this firmware,
+    so the worst case is main's deepest path plus the deepest handler.
+    Recursion, indirect calls (icall) and library functions without .su
+    data can't be bounded this way and are listed separately.
+
+    With --port the robot's own high-water mark (the 'm' command, see
+    Driver/Stack_Monitor.h) is read for comparison.
+'''
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+
+DATA_SECTIONS = [".data", ".bss", ".noinit"]
+
+SHT_SYMTAB = 2
+STT_OBJECT = 1
+
+
+def read_elf(path):
+    ''' Returns ({section: (addr, size)}, [(name, value, size, section)] objects, {symbol: value}) '''
+    with open(path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF":
+        sys.exit("%s is not an ELF file" % path)
+    wide = elf[4] == 2
+    endian = "<" if elf[5] == 1 else ">"
+
+    if wide:
+        shoff, = struct.unpack_from(endian + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x3A)
+        shdr = struct.Struct(endian + "IIQQQQIIQQ")
+        sym = struct.Struct(endian + "IBBHQQ")
+    else:
+        shoff, = struct.unpack_from(endian + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x2E)
+        shdr = struct.Struct(endian + "IIIIIIIIII")
+        sym = struct.Struct(endian + "IIIBBH")
+
+    headers = [shdr.unpack_from(elf, shoff + i * shentsize) for i in range(shnum)]
+
+    def c_string(offset):
+        return elf[offset:elf.index(b"\0", offset)].decode("ascii", "replace")
+
+    # (name, type, flags, addr, offset, size, link, info, align, entsize)
+    names_at = headers[shstrndx][4]
+    names = [c_string(names_at + h[0]) for h in headers]
+
+    sections = {}
+    for name, h in zip(names, headers):
+        sections[name] = (h[3], h[5])
+
+    objects = []
+    symbols = {}
+    for h in headers:
+        if h[1] != SHT_SYMTAB:
+            continue
+        strings_at = headers[h[6]][4]
+        for i in range(h[5] // sym.size):
+            fields = sym.unpack_from(elf, h[4] + i * sym.size)
+            if wide:
+                name_at, info, _, shndx, value, size = fields
+            else:
+                name_at, value, size, info, _, shndx = fields
+            name = c_string(strings_at + name_at)
+            if not name:
+                continue
+            symbols[name] = value
+            if info & 0xF == STT_OBJECT and shndx < len(names) and names[shndx] in DATA_SECTIONS:
+                objects.append((name, value, size, names[shndx]))
+
+    return sections, objects, symbols
+
+
+def read_stack_usage(paths):
+    ''' Returns {function: (bytes, qualifier)} from .su files or directories of them '''
+    frames = {}
+    for path in paths:
+        files = glob.glob(os.path.join(path, "*.su")) if os.path.isdir(path) else [path]
+        for name in files:
+            with open(name) as f:
+                for line in f:
+                    # file.c:line:column:function<TAB>bytes<TAB>qualifier
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) != 3:
+                        continue
+                    function = fields[0].rsplit(":", 1)[-1]
+                    size = int(fields[1])
+                    # A static function may share its name with one elsewhere, keep the larger
+                    if function not in frames or frames[function][0] < size:
+                        frames[function] = (size, fields[2])
+    return frames
+
+
+FUNCTION_LINE = re.compile(r"^[0-9a-f]+ <([^>]+)>:$")
+BRANCH_LINE = re.compile(r"\t(r?call|r?jmp|callq?|jmpq?)\s.*<([^>+]+)(\+0x[0-9a-f]+)?>")
+INDIRECT_LINE = re.compile(r"\t(e?icall|e?ijmp|callq?\s+\*|jmpq?\s+\*)")
+
+
+def read_call_graph(elf, objdump):
+    ''' Returns ({function: set(callees)}, set(functions that can't be bounded)) from the disassembly '''
+    text = subprocess.run([objdump, "-d", elf], stdout=subprocess.PIPE, check=True,
+                          universal_newlines=True).stdout
+    calls = {}
+    indirect = set()
+    recursive = set()
+    current = None
+    for line in text.splitlines():
+        m = FUNCTION_LINE.match(line)
+        if m:
+            current = m.group(1)
+            calls.setdefault(current, set())
+            continue
+        if current is None:
+            continue
+        if INDIRECT_LINE.search(line):
+            indirect.add(current)
+            continue
+        m = BRANCH_LINE.search(line)
+        if m:
+            op, target, offset = m.groups()
+            # A call to its own start is recursion
+            if target == current and not offset and "call" in op:
+                recursive.add(current)
+                continue
+            # Branches inside the function, and jumps into the middle of
+            # another (the -mcall-prologues helpers), are not calls
+            if target == current or (offset and "jmp" in op):
+                continue
+            calls[current].add(target)
+    return calls, indirect | recursive
+
+
+class Depth:
+    ''' Deepest stack use of each function and its callees '''
+
+    def __init__(self, frames, calls, unbounded):
+        self.frames = frames
+        self.calls = calls
+        self.unbounded = set(unbounded)
+        self.depth = {}
+        self.path = {}
+        self.unknown = set()
+
+    def of(self, function, active=()):
+        if function in self.depth:
+            return self.depth[function]
+        if function in active:
+            self.unbounded.add(function)
+            return 0
+
+        if function in self.frames:
+            frame = self.frames[function][0]
+        else:
+            frame = 0
+            self.unknown.add(function)
+
+        deepest, via = 0, None
+        for callee in sorted(self.calls.get(function, ())):
+            d = self.of(callee, active + (function,))
+            if d > deepest:
+                deepest, via = d, callee
+
+        self.depth[function] = frame + deepest
+        self.path[function] = via
+        return frame + deepest
+
+    def chain(self, function):
+        chain = []
+        while function is not None and function not in chain:
+            chain.append(function)
+            function = self.path.get(function)
+        return chain
+
+
+def read_robot(port):
+    ''' Returns the robot's 'm' reply (static_ram, stack_size, stack_peak, stack_now) '''
+    import serial
+    from trace_decode import read_messages
+
+    conn = serial.Serial(port, 115200, timeout=1)
+    try:
+        conn.reset_input_buffer()
+        conn.write(b"m")
+        for fmt, cmd, data in read_messages(conn.read):
+            if cmd == "m" and len(data) == 8:
+                return struct.unpack("<HHHH", data)
+    finally:
+        conn.close()
+    sys.exit("no reply to 'm' from %s" % port)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Static RAM and worst case stack report")
+    parser.add_argument("elf", help="linked firmware, Application/BIN/Main.elf")
+    parser.add_argument("su", nargs="*", help=".su files or directories of them (default: the ELF's directory)")
+    parser.add_argument("--objdump", default="avr-objdump", help="disassembler for the call graph (default avr-objdump)")
+    parser.add_argument("--top", type=int, default=15, help="variables and functions to list (default 15)")
+    parser.add_argument("--port", help="serial port of the robot, to read its measured high-water mark")
+    args = parser.parse_args()
+
+    sections, objects, symbols = read_elf(args.elf)
+
+    print("Static RAM")
+    static_ram = 0
+    for name in DATA_SECTIONS:
+        if name in sections:
+            print("  %-10s %6d" % (name, sections[name][1]))
+            static_ram += sections[name][1]
+    print("  %-10s %6d" % ("total", static_ram))
+
+    # On AVR the linker script marks the top of RAM, the stack gets what the statics leave
+    ram_size = None
+    if "__stack" in symbols and ".data" in sections:
+        ram_size = symbols["__stack"] - sections[".data"][0] + 1
+        print("  %-10s %6d" % ("RAM", ram_size))
+        print("  %-10s %6d" % ("for stack", ram_size - static_ram))
+
+    print("\nLargest variables")
+    for name, _, size, section in sorted(objects, key=lambda o: -o[2])[:args.top]:
+        print("  %-32s %-8s %6d" % (name, section, size))
+
+    frames = read_stack_usage(args.su or [os.path.dirname(os.path.abspath(args.elf))])
+    if not frames:
+        sys.exit("\nno .su files found, build with -fstack-usage ('make ram' does)")
+
+    depth = None
+    if shutil.which(args.objdump):
+        calls, unbounded = read_call_graph(args.elf, args.objdump)
+        depth = Depth(frames, calls, unbounded)
+        for function in calls:
+            depth.of(function)
+    else:
+        print("\n%s not found, frames only (no call graph)" % args.objdump)
+
+    print("\nLargest stack frames%s" % ("" if depth is None else ", with their deepest call path"))
+    for function, (size, qualifier) in sorted(frames.items(), key=lambda f: -f[1][0])[:args.top]:
+        line = "  %-32s %6d" % (function, size)
+        if depth is not None and function in depth.depth:
+            line += " %6d" % depth.depth[function]
+        if qualifier != "static":
+            line += "  (%s)" % qualifier
+        print(line)
+
+    if depth is not None and "main" in depth.depth:
+        handlers = sorted((f for f in depth.depth if f.startswith("__vector_")), key=lambda f: -depth.depth[f])
+        main_depth = depth.depth["main"]
+        isr_depth = depth.depth[handlers[0]] if handlers else 0
+
+        print("\nWorst case stack")
+        print("  main %d: %s" % (main_depth, " > ".join(depth.chain("main"))))
+        for handler in handlers:
+            print("  %s %d: %s" % (handler, depth.depth[handler], " > ".join(depth.chain(handler))))
+        print("  %-10s %6d  (main + deepest handler)" % ("total", main_depth + isr_depth))
+        if ram_size is not None:
+            print("  %-10s %6d" % ("headroom", ram_size - static_ram - main_depth - isr_depth))
+
+        if depth.unbounded:
+            print("\nNot bounded (recursion or indirect calls): " + ", ".join(sorted(depth.unbounded)))
+        unknown = sorted(depth.unknown & set().union(*[set(depth.chain(f)) for f in ["main"] + handlers]))
+        if unknown:
+            print("No .su data on the worst paths (library code, counted as 0): " + ", ".join(unknown))
+
+    if args.port:
+        static, size, peak, now = read_robot(args.port)
+        print("\nMeasured on the robot ('m')")
+        print("  static %d, stack %d of %d, peak %d, headroom %d" % (static, now, size, peak, size - peak))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,394 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    recorder.py streams what serial_monitor_lib's callbacks get straight to
+    disk, so a recording is bounded only by the disk and stopping it costs
+    nothing. Rows are grouped into streams by message (the leading command
+    character and the type of every field, since a 'Y' frame's fields depend
+    on its channels). Each stream is buffered as typed columns, one array per
+    field plus the host time, and written out every CHUNK_ROWS rows.
+
+    File layout, little-endian throughout:
+
+        MAGIC
+        chunk*          [kind 1s][stream H][payload length I][payload]
+            'S'         a new stream: column types (d float, q int, U text) \0 command
+            'D'         rows I, then per column the array (text: byte length I, \0 joined UTF-8)
+            'I'         the index: streams H, then ([stream H][length H][the 'S' payload]) per
+                        stream and (stream H, chunk offset Q, rows I, first time d, last time d) per 'D'
+        trailer         [index offset Q][INDEX_MAGIC]
+
+    The index and trailer are written by close(), and let a reader find any
+    stream's chunks without touching the rest. A file cut short by a crash
+    is still readable: the reader then walks the chunks and keeps every
+    complete one.
+
+        python recorder.py info run.zrec
+        python recorder.py export run.zrec run.csv          # time, values ... like the old saveData
+        python recorder.py export run.zrec run.csv --split  # run_<stream>.csv per message, with headers
+        python recorder.py --bench                          # rows per second on this machine
+'''
+
+import argparse
+import array
+import heapq
+import itertools
+import os
+import struct
+import sys
+import time
+
+MAGIC = b"ZREC\x01\n"
+INDEX_MAGIC = b"ZIDX"
+CHUNK = struct.Struct("<1sHI")
+ROWS = struct.Struct("<I")
+INDEX_ENTRY = struct.Struct("<HQIdd")
+STREAM_ENTRY = struct.Struct("<HH")
+TRAILER = struct.Struct("<Q4s")
+
+CHUNK_ROWS = 4096           # rows a stream buffers before it is written
+MAX_BUFFERED_ROWS = 32768   # all streams together, beyond this everything is written
+
+TYPE_CODES = {float: 'd', int: 'q', bool: 'q'}
+
+
+def _type_code(value):
+    return TYPE_CODES.get(type(value), 'U')
+
+
+def _pack_column(code, values):
+    if code == 'U':
+        text = "\0".join(values).encode()
+        return ROWS.pack(len(text)) + text
+    column = array.array(code, values)
+    if sys.byteorder == "big":
+        column.byteswap()
+    return column.tobytes()
+
+
+class _Stream:
+
+    def __init__(self, number, types, command):
+        self.number = number
+        self.types = types
+        self.command = command
+        self.columns = [[] for _ in range(len(types) + 1)]
+
+    def rows(self):
+        return len(self.columns[0])
+
+    def schema(self):
+        return self.types.encode() + b"\0" + self.command.encode()
+
+
+class Recorder:
+    ''' Writes rows to path as they arrive. add() may be called from the serial thread, close() from
+        another once add() has stopped being called. '''
+
+    def __init__(self, path):
+        self.path = path
+        self.file = open(path, "wb")
+        self.file.write(MAGIC)
+        self.streams = {}
+        self.index = []
+        self.buffered = 0
+        self.rows = 0
+
+    def add(self, values, now=None):
+        if now is None:
+            now = time.perf_counter()
+        types = "".join(_type_code(v) for v in values)
+        command = values[0] if values and types[0] == 'U' else ""
+        key = (types, command)
+
+        stream = self.streams.get(key)
+        if stream is None:
+            stream = self.streams[key] = _Stream(len(self.streams), types, command)
+            payload = stream.schema()
+            self.file.write(CHUNK.pack(b'S', stream.number, len(payload)) + payload)
+
+        columns = stream.columns
+        columns[0].append(now)
+        for i, (code, value) in enumerate(zip(types, values), 1):
+            columns[i].append(value if code != 'U' else str(value))
+
+        self.rows += 1
+        self.buffered += 1
+        if stream.rows() >= CHUNK_ROWS:
+            self._write(stream)
+        elif self.buffered >= MAX_BUFFERED_ROWS:
+            self.flush()
+
+    def _write(self, stream):
+        rows = stream.rows()
+        if rows == 0:
+            return
+        parts = [ROWS.pack(rows), _pack_column('d', stream.columns[0])]
+        for code, column in zip(stream.types, stream.columns[1:]):
+            parts.append(_pack_column(code, column))
+        payload = b"".join(parts)
+
+        offset = self.file.tell()
+        self.file.write(CHUNK.pack(b'D', stream.number, len(payload)) + payload)
+        self.index.append((stream.number, offset, rows, stream.columns[0][0], stream.columns[0][-1]))
+        self.buffered -= rows
+        stream.columns = [[] for _ in stream.columns]
+
+    def flush(self):
+        ''' Writes every buffered row and pushes the file to the disk '''
+        for stream in self.streams.values():
+            self._write(stream)
+        self.file.flush()
+
+    def close(self):
+        if self.file is None:
+            return
+        self.flush()
+        parts = [struct.pack("<H", len(self.streams))]
+        for stream in self.streams.values():
+            schema = stream.schema()
+            parts.append(STREAM_ENTRY.pack(stream.number, len(schema)) + schema)
+        parts.extend(INDEX_ENTRY.pack(*entry) for entry in self.index)
+        payload = b"".join(parts)
+        offset = self.file.tell()
+        self.file.write(CHUNK.pack(b'I', 0, len(payload)) + payload)
+        self.file.write(TRAILER.pack(offset, INDEX_MAGIC))
+        self.file.close()
+        self.file = None
+
+
+class Recording:
+    ''' Reads a recording chunk by chunk. streams maps number -> (types, command), index lists the
+        data chunks as written. '''
+
+    def __init__(self, path):
+        self.path = path
+        self.file = open(path, "rb")
+        if self.file.read(len(MAGIC)) != MAGIC:
+            raise ValueError("%s is not a recording" % path)
+        self.streams = {}
+        self.index = []
+        self.complete = False
+        self._scan()
+
+    def _add_stream(self, number, schema):
+        types, _, command = schema.partition(b"\0")
+        self.streams[number] = (types.decode(), command.decode())
+
+    def _load_index(self):
+        f = self.file
+        size = os.fstat(f.fileno()).st_size
+        if size < len(MAGIC) + TRAILER.size:
+            return False
+        f.seek(size - TRAILER.size)
+        offset, magic = TRAILER.unpack(f.read(TRAILER.size))
+        if magic != INDEX_MAGIC or offset > size - TRAILER.size - CHUNK.size:
+            return False
+        f.seek(offset)
+        kind, _, length = CHUNK.unpack(f.read(CHUNK.size))
+        payload = f.read(length)
+        if kind != b'I' or len(payload) != length:
+            return False
+
+        count = struct.unpack_from("<H", payload)[0]
+        i = 2
+        for _ in range(count):
+            number, schema_length = STREAM_ENTRY.unpack_from(payload, i)
+            i += STREAM_ENTRY.size
+            self._add_stream(number, payload[i:i + schema_length])
+            i += schema_length
+        self.index = [entry for entry in INDEX_ENTRY.iter_unpack(payload[i:])]
+        return True
+
+    def _scan(self):
+        if self._load_index():
+            self.complete = True
+            return
+
+        # Not closed: walk the chunks, keeping each that was written out in full
+        f = self.file
+        size = os.fstat(f.fileno()).st_size
+        offset = len(MAGIC)
+        while offset + CHUNK.size <= size:
+            f.seek(offset)
+            kind, number, length = CHUNK.unpack(f.read(CHUNK.size))
+            if offset + CHUNK.size + length > size:
+                break
+            if kind == b'S':
+                self._add_stream(number, f.read(length))
+            elif kind == b'D':
+                rows = ROWS.unpack(f.read(ROWS.size))[0]
+                first = struct.unpack("<d", f.read(8))[0]
+                f.seek(offset + CHUNK.size + ROWS.size + 8 * (rows - 1))
+                last = struct.unpack("<d", f.read(8))[0]
+                self.index.append((number, offset, rows, first, last))
+            else:
+                break
+            offset += CHUNK.size + length
+
+    def close(self):
+        self.file.close()
+
+    def rows(self, number=None):
+        return sum(entry[2] for entry in self.index if number is None or entry[0] == number)
+
+    def read_chunk(self, offset):
+        ''' (stream number, [time column, field columns ...]) for the 'D' chunk at offset '''
+        self.file.seek(offset)
+        _, number, length = CHUNK.unpack(self.file.read(CHUNK.size))
+        payload = self.file.read(length)
+        rows = ROWS.unpack_from(payload)[0]
+        i = ROWS.size
+
+        columns = []
+        for code in 'd' + self.streams[number][0]:
+            if code == 'U':
+                size = ROWS.unpack_from(payload, i)[0]
+                i += ROWS.size
+                columns.append(payload[i:i + size].decode().split("\0"))
+                i += size
+            else:
+                column = array.array(code)
+                column.frombytes(payload[i:i + rows * column.itemsize])
+                if sys.byteorder == "big":
+                    column.byteswap()
+                columns.append(column)
+                i += rows * column.itemsize
+        return number, columns
+
+    def columns(self, number):
+        ''' All of one stream's columns, joined across its chunks '''
+        joined = None
+        for entry in self.index:
+            if entry[0] != number:
+                continue
+            _, columns = self.read_chunk(entry[1])
+            if joined is None:
+                joined = columns
+            else:
+                for all_values, values in zip(joined, columns):
+                    all_values.extend(values)
+        return joined or [[] for _ in range(len(self.streams[number][0]) + 1)]
+
+    def stream_rows(self, number):
+        ''' Yields (time, values) for one stream, a chunk in memory at a time '''
+        for entry in self.index:
+            if entry[0] == number:
+                _, columns = self.read_chunk(entry[1])
+                for row in zip(*columns):
+                    yield row[0], row[1:]
+
+    def all_rows(self):
+        ''' Yields (time, values) for every stream in time order, a chunk per stream in memory at a time '''
+        return heapq.merge(*(self.stream_rows(n) for n in self.streams), key=lambda row: row[0])
+
+
+def export_csv(recording, path):
+    ''' One file like the old saveData: time, then the row's values '''
+    with open(path, "w") as out:
+        for now, values in recording.all_rows():
+            out.write(", ".join(itertools.chain((str(now),), map(str, values))) + "\n")
+
+
+def export_split(recording, path):
+    ''' One file per stream, with a header, named <path>_<stream>.csv. Returns the names. '''
+    base = os.path.splitext(path)[0]
+    names = []
+    for number, (types, command) in sorted(recording.streams.items()):
+        name = "%s_%d%s.csv" % (base, number, "_" + command if command.isalnum() else "")
+        with open(name, "w") as out:
+            out.write(", ".join(["time"] + ["field%d" % i for i in range(len(types))]) + "\n")
+            for now, values in recording.stream_rows(number):
+                out.write(", ".join(itertools.chain((str(now),), map(str, values))) + "\n")
+        names.append(name)
+    return names
+
+
+def _bench(path):
+    rows = 200000
+    frame = ['Y', 63, 1234, 10, -20, 7.4, 100, -100, 0.1, 0.2, 0.3, 512, 'L', 0.25, 0.5]
+    start = time.perf_counter()
+    recorder = Recorder(path)
+    for i in range(rows):
+        frame[2] = i
+        recorder.add(frame, i * 0.01)
+    recorder.close()
+    elapsed = time.perf_counter() - start
+    size = os.path.getsize(path)
+    print("%d rows in %.3f s: %.0f rows/s, %.1f bytes/row" % (rows, elapsed, rows / elapsed, size / rows))
+
+    start = time.perf_counter()
+    recording = Recording(path)
+    count = sum(1 for _ in recording.all_rows())
+    recording.close()
+    elapsed = time.perf_counter() - start
+    print("%d rows read back in %.3f s: %.0f rows/s" % (count, elapsed, count / elapsed))
+    os.remove(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Inspect and export recordings")
+    parser.add_argument("--bench", action="store_true", help="time recording and reading back")
+    commands = parser.add_subparsers(dest="command")
+
+    p = commands.add_parser("info", help="list the streams of a recording")
+    p.add_argument("recording")
+
+    p = commands.add_parser("export", help="write a recording as CSV")
+    p.add_argument("recording")
+    p.add_argument("csv")
+    p.add_argument("--split", action="store_true", help="one CSV per stream, with headers")
+
+    args = parser.parse_args()
+    if args.bench:
+        _bench("recorder_bench.zrec")
+        return 0
+    if args.command is None:
+        parser.error("give a command")
+
+    recording = Recording(args.recording)
+    try:
+        if args.command == "info":
+            print("%s: %d rows in %d chunks%s" % (args.recording, recording.rows(), len(recording.index),
+                  "" if recording.complete else " (not closed, read up to the last complete chunk)"))
+            for number, (types, command) in sorted(recording.streams.items()):
+                times = [e[3] for e in recording.index if e[0] == number] + \
+                        [e[4] for e in recording.index if e[0] == number]
+                print("  stream %d %-4s %-24s %8d rows  %s" % (number, command, types, recording.rows(number),
+                      "%.3f .. %.3f s" % (min(times), max(times)) if times else ""))
+        elif args.command == "export":
+            if args.split:
+                for name in export_split(recording, args.csv):
+                    print(name)
+            else:
+                export_csv(recording, args.csv)
+    finally:
+        recording.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,470 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    robot_hub.py runs many robots from one headless process. Every serial
+    link, and every client, is served by one selector loop in one thread.
+    Frames are split with frame_parser and delta telemetry is decoded with
+    telemetry.Decoder, as in serial_monitor_lib, then kept in a per-robot
+    queue and passed on to the clients that subscribed.
+
+        python robot_hub.py serve r1=/dev/ttyACM0 r2=/dev/ttyACM1
+        python robot_hub.py serve --sim 20          # 20 Host/BIN/Link_Sim robots on ptys
+        python robot_hub.py serve --sim 20 --sim-args "--latency 5 --loss 0.01"
+
+    Clients talk to the hub over a Unix socket (--socket, default
+    /tmp/zumo_hub.sock), one JSON object per line each way:
+
+        {"op": "list"}
+            -> {"robots": [{"name", "port", "connected", "frames", "resyncs", "queued"}]}
+        {"op": "send", "robot": "r1", "format": "cf", "values": ["B", 0.5]}
+            -> {"ok": true}; the command is packed as serial_monitor_lib.write does
+        {"op": "read", "robot": "r1", "max": 100}
+            -> {"frames": [...]}, taken from the robot's queue
+        {"op": "subscribe", "robots": ["r1"], "cmds": "EY"}
+            -> {"ok": true}, then {"frame": ...} lines as they arrive. Leave out
+               robots or cmds for all of them; "unsubscribe" stops.
+
+    A frame is {"robot", "time" (host, s), "cmd", "data"} with data the list
+    serial_monitor_lib's callbacks get. The same commands from the shell:
+
+        python robot_hub.py list
+        python robot_hub.py send r1 cf B 0.5
+        python robot_hub.py watch r1 r2 --cmds Y
+
+    A client that falls behind has frames dropped (counted in "dropped")
+    rather than holding up the robots. A robot whose port goes away is
+    reopened every RECONNECT_S.
+'''
+
+import argparse
+import collections
+import errno
+import json
+import os
+import selectors
+import shlex
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import termios
+import time
+import tty
+
+import frame_parser
+import telemetry
+
+SOCKET_PATH = "/tmp/zumo_hub.sock"
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+QUEUE_LEN = 1000            # frames kept per robot for "read"
+CLIENT_BUFFER = 1 << 20     # bytes a subscriber may have pending before frames are dropped
+RECONNECT_S = 2.0
+READ_SIZE = 4096
+
+
+def pack_command(fmt, values):
+    ''' Packs a command like serial_monitor_lib.SerialData.write: 'c' fields from strings, 'f' as floats, the
+        rest as integers '''
+    fields = []
+    for code, value in zip(fmt, values):
+        if code == 'c':
+            fields.append(str(value).encode())
+        elif code == 'f':
+            fields.append(float(value))
+        else:
+            fields.append(int(value))
+    return struct.pack("<" + fmt, *fields)
+
+
+class Robot:
+
+    def __init__(self, hub, name, port):
+        self.hub = hub
+        self.name = name
+        self.port = port
+        self.fd = None
+        self.out = bytearray()
+        self.parser = frame_parser.FrameParser()
+        self.decoder = telemetry.Decoder()
+        self.queue = collections.deque(maxlen=QUEUE_LEN)
+        self.frames = 0
+        self.retry_at = 0
+
+    def open(self):
+        try:
+            fd = os.open(self.port, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+        except OSError as e:
+            self.retry_at = time.monotonic() + RECONNECT_S
+            print("%s: %s" % (self.name, e), file=sys.stderr)
+            return
+        try:
+            tty.setraw(fd)
+            termios.tcflush(fd, termios.TCIFLUSH)
+        except termios.error:
+            pass
+        self.fd = fd
+        self.parser = frame_parser.FrameParser()
+        self.decoder = telemetry.Decoder()
+        self.hub.selector.register(fd, selectors.EVENT_READ, self)
+
+    def close(self):
+        if self.fd is None:
+            return
+        self.hub.selector.unregister(self.fd)
+        os.close(self.fd)
+        self.fd = None
+        self.out.clear()
+        self.retry_at = time.monotonic() + RECONNECT_S
+        print("%s: disconnected" % self.name, file=sys.stderr)
+
+    def send(self, data):
+        if self.fd is None:
+            return False
+        if not self.out:
+            self.hub.selector.modify(self.fd, selectors.EVENT_READ | selectors.EVENT_WRITE, self)
+        self.out += data
+        return True
+
+    def on_read(self):
+        try:
+            chunk = os.read(self.fd, READ_SIZE)
+        except OSError as e:
+            if e.errno == errno.EAGAIN:
+                return
+            chunk = b""
+        if not chunk:
+            self.close()
+            return
+
+        now = time.time()
+        self.parser.feed(chunk)
+        for fmt, values in self.parser.frames():
+            cmd = values[0].decode('ascii', 'replace') if isinstance(values[0], bytes) else "?"
+            if cmd == 'Y' and fmt.endswith('s'):
+                decoded = self.decoder.decode_delta(bytes(values[1]))
+                if decoded is None:
+                    continue
+                data = telemetry.flatten(*decoded)
+            else:
+                data = frame_parser.to_list(fmt, values)
+            frame = {"robot": self.name, "time": now, "cmd": cmd, "data": data}
+            self.frames += 1
+            self.queue.append(frame)
+            self.hub.publish(frame)
+
+    def on_write(self):
+        try:
+            n = os.write(self.fd, self.out)
+        except OSError as e:
+            if e.errno == errno.EAGAIN:
+                return
+            self.close()
+            return
+        del self.out[:n]
+        if not self.out:
+            self.hub.selector.modify(self.fd, selectors.EVENT_READ, self)
+
+
+class Client:
+
+    def __init__(self, hub, sock):
+        self.hub = hub
+        self.sock = sock
+        self.inbox = bytearray()
+        self.out = bytearray()
+        self.robots = None      # subscribed robot names, None for all
+        self.cmds = None        # subscribed commands, None for all
+        self.subscribed = False
+        self.dropped = 0
+        hub.selector.register(sock, selectors.EVENT_READ, self)
+
+    def close(self):
+        self.hub.selector.unregister(self.sock)
+        self.sock.close()
+        self.hub.clients.discard(self)
+
+    def reply(self, obj):
+        if len(self.out) > CLIENT_BUFFER:
+            self.dropped += 1
+            return
+        if not self.out:
+            self.hub.selector.modify(self.sock, selectors.EVENT_READ | selectors.EVENT_WRITE, self)
+        self.out += json.dumps(obj).encode() + b"\n"
+
+    def on_read(self):
+        try:
+            chunk = self.sock.recv(READ_SIZE)
+        except (BlockingIOError, InterruptedError):
+            return
+        except OSError:
+            chunk = b""
+        if not chunk:
+            self.close()
+            return
+        self.inbox += chunk
+        while b"\n" in self.inbox:
+            line, _, rest = bytes(self.inbox).partition(b"\n")
+            self.inbox = bytearray(rest)
+            try:
+                request = json.loads(line)
+                self.reply(self.hub.handle(self, request))
+            except (ValueError, KeyError, TypeError, struct.error) as e:
+                self.reply({"error": str(e)})
+
+    def on_write(self):
+        try:
+            n = self.sock.send(self.out)
+        except (BlockingIOError, InterruptedError):
+            return
+        except OSError:
+            self.close()
+            return
+        del self.out[:n]
+        if not self.out:
+            self.hub.selector.modify(self.sock, selectors.EVENT_READ, self)
+
+
+class Hub:
+
+    def __init__(self, socket_path):
+        self.selector = selectors.DefaultSelector()
+        self.robots = collections.OrderedDict()
+        self.clients = set()
+
+        if os.path.exists(socket_path):
+            os.unlink(socket_path)
+        self.listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.listener.bind(socket_path)
+        self.listener.listen(16)
+        self.listener.setblocking(False)
+        self.selector.register(self.listener, selectors.EVENT_READ, self)
+
+    def add_robot(self, name, port):
+        robot = Robot(self, name, port)
+        self.robots[name] = robot
+        robot.open()
+
+    def on_read(self):
+        sock, _ = self.listener.accept()
+        sock.setblocking(False)
+        self.clients.add(Client(self, sock))
+
+    def publish(self, frame):
+        for client in self.clients:
+            if not client.subscribed:
+                continue
+            if client.robots is not None and frame["robot"] not in client.robots:
+                continue
+            if client.cmds is not None and frame["cmd"] not in client.cmds:
+                continue
+            client.reply({"frame": frame})
+
+    def handle(self, client, request):
+        op = request["op"]
+        if op == "list":
+            return {"robots": [{"name": r.name, "port": r.port, "connected": r.fd is not None,
+                                "frames": r.frames, "resyncs": r.parser.resyncs, "queued": len(r.queue)}
+                               for r in self.robots.values()]}
+        if op == "send":
+            robot = self.robots[request["robot"]]
+            if not robot.send(pack_command(request["format"], request["values"])):
+                return {"error": "%s is not connected" % robot.name}
+            return {"ok": True}
+        if op == "read":
+            robot = self.robots[request["robot"]]
+            frames = []
+            for _ in range(min(int(request.get("max", QUEUE_LEN)), len(robot.queue))):
+                frames.append(robot.queue.popleft())
+            return {"frames": frames}
+        if op == "subscribe":
+            robots = request.get("robots")
+            for name in robots or []:
+                self.robots[name]
+            client.robots = set(robots) if robots else None
+            client.cmds = request.get("cmds") or None
+            client.subscribed = True
+            return {"ok": True}
+        if op == "unsubscribe":
+            client.subscribed = False
+            return {"ok": True, "dropped": client.dropped}
+        return {"error": "unknown op %r" % op}
+
+    def run(self):
+        while True:
+            for key, events in self.selector.select(timeout=RECONNECT_S):
+                handler = key.data
+                if events & selectors.EVENT_READ:
+                    handler.on_read()
+                # Skip the write if the read closed it
+                if events & selectors.EVENT_WRITE and key.fd in self.selector.get_map():
+                    handler.on_write()
+
+            now = time.monotonic()
+            for robot in self.robots.values():
+                if robot.fd is None and now >= robot.retry_at:
+                    robot.open()
+
+
+class HubClient:
+    ''' Blocking client for scripts: HubClient().send("r1", "cf", "B", 0.5) '''
+
+    def __init__(self, socket_path=SOCKET_PATH):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(socket_path)
+        self.lines = self.sock.makefile("r")
+
+    def request(self, op, **fields):
+        fields["op"] = op
+        self.sock.sendall(json.dumps(fields).encode() + b"\n")
+        # Frames for an earlier subscribe may arrive before the reply
+        while True:
+            reply = json.loads(self.lines.readline())
+            if "frame" not in reply:
+                return reply
+
+    def list(self):
+        return self.request("list")["robots"]
+
+    def send(self, robot, fmt, *values):
+        return self.request("send", robot=robot, format=fmt, values=list(values))
+
+    def read(self, robot, max=QUEUE_LEN):
+        return self.request("read", robot=robot, max=max)["frames"]
+
+    def subscribe(self, robots=None, cmds=None):
+        return self.request("subscribe", robots=robots, cmds=cmds)
+
+    def frames(self):
+        ''' Yields frames after subscribe '''
+        for line in self.lines:
+            reply = json.loads(line)
+            if "frame" in reply:
+                yield reply["frame"]
+
+    def close(self):
+        self.lines.close()
+        self.sock.close()
+
+
+def serve(args, parser):
+    ports = []
+    for spec in args.robots:
+        name, sep, port = spec.partition("=")
+        if not sep:
+            parser.error("give robots as name=port, not %r" % spec)
+        ports.append((name, port))
+
+    sims = []
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        for i in range(args.sim):
+            # Each robot its own seed, so their losses differ
+            cmd = [SIM_PATH, "--seed", str(i + 1)] + shlex.split(args.sim_args)
+            sim = subprocess.Popen(cmd, stdout=subprocess.PIPE, universal_newlines=True)
+            sims.append(sim)
+            ports.append(("sim%d" % (i + 1), sim.stdout.readline().strip()))
+    if not ports:
+        parser.error("give at least one name=port or --sim")
+
+    # Stopped by a service manager as by Ctrl-C, so the simulators go too
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+
+    hub = Hub(args.socket)
+    try:
+        for name, port in ports:
+            hub.add_robot(name, port)
+            print("%s: %s" % (name, port), file=sys.stderr)
+        print("listening on %s" % args.socket, file=sys.stderr)
+        hub.run()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.unlink(args.socket)
+        for sim in sims:
+            sim.terminate()
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve many robots from one process over a local socket")
+    parser.add_argument("--socket", default=SOCKET_PATH, help="hub socket (default %s)" % SOCKET_PATH)
+    commands = parser.add_subparsers(dest="command")
+
+    p = commands.add_parser("serve", help="run the hub")
+    p.add_argument("robots", nargs="*", metavar="name=port", help="robots to open, e.g. r1=/dev/ttyACM0")
+    p.add_argument("--sim", type=int, default=0, metavar="N", help="also start N Host/BIN/Link_Sim robots")
+    p.add_argument("--sim-args", default="", metavar="ARGS",
+                   help="options for the simulated robots, e.g. \"--latency 5 --loss 0.01\"")
+
+    commands.add_parser("list", help="list the robots and their link counters")
+
+    p = commands.add_parser("send", help="send one command to a robot")
+    p.add_argument("robot")
+    p.add_argument("format", help="struct format of the command, e.g. cf")
+    p.add_argument("values", nargs="*", help="command character then its fields")
+
+    p = commands.add_parser("watch", help="print frames as they arrive")
+    p.add_argument("robots", nargs="*", help="robots to watch (default all)")
+    p.add_argument("--cmds", help="only these reply commands, e.g. Y")
+
+    args = parser.parse_args()
+    if args.command == "serve":
+        return serve(args, parser)
+    if args.command is None:
+        parser.error("give a command")
+
+    client = HubClient(args.socket)
+    try:
+        if args.command == "list":
+            for robot in client.list():
+                print("%-10s %-20s %-5s %8d frames %6d resyncs %6d queued" % (
+                    robot["name"], robot["port"], "up" if robot["connected"] else "down",
+                    robot["frames"], robot["resyncs"], robot["queued"]))
+        elif args.command == "send":
+            reply = client.send(args.robot, args.format, *args.values)
+            if "error" in reply:
+                print(reply["error"], file=sys.stderr)
+                return 1
+        elif args.command == "watch":
+            reply = client.subscribe(args.robots or None, args.cmds)
+            if "error" in reply:
+                print(reply["error"], file=sys.stderr)
+                return 1
+            for frame in client.frames():
+                print("%s %.3f %s" % (frame["robot"], frame["time"], frame["data"]), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
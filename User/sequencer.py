@@ -0,0 +1,395 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    sequencer.py sends a script of commands on a fixed timeline. Every
+    command is packed before the first one goes out. Sends are scheduled
+    against time.perf_counter from the start of the run, so a late send
+    doesn't push the rest back. The script can wait for the robot's reply
+    or for a telemetry value between commands:
+
+        python sequencer.py sweep.csv /dev/ttyACM0 --period 0.01 --log sweep_log.csv
+        python sequencer.py sweep.csv --sim             # no robot, uses Host/BIN/Link_Sim
+        python sequencer.py sweep.csv --dry-run         # print the timeline only
+
+    The script is the monitor's command CSV, one command a row as format
+    then values, any number of fields (sys_id_template.csv):
+
+        cf, Q, 0.002
+        chhf, P, 50, 50, 0.5
+
+    plus rows starting with '@' that control timing, and '#' comments:
+
+        @period, s                          default spacing between commands (--period until set)
+        @wait, s                            s more before the next command
+        @at, s                              the next command at s from the start
+        @ack, cmd[, timeout]                wait for a reply with this command character
+        @until, cmd, index, op, value[, timeout]
+                                            wait for a reply with data[index] op value, op one of
+                                            < <= > >= == !=, data as serial_monitor_lib's callbacks
+                                            get it (so 'Y' frames decoded, index 0 the command)
+
+    After an @ack or @until the timeline restarts from the reply. A timeout
+    (default --timeout) ends the run. A '?' reply to a command that was sent
+    counts as a rejection, and a rejection while waiting for an @ack or
+    @until ends the run.
+
+    The Sequencer class also runs inside serial_monitor.py ("Send CSV
+    Commands"), fed by the monitor's serial callbacks.
+'''
+
+import argparse
+import collections
+import csv
+import operator
+import os
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+import frame_parser
+import telemetry
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+SPIN_S = 0.002      # the last stretch before a send is spun rather than slept
+FRAMES_KEPT = 1000
+SWITCH_INTERVAL_S = 0.0002
+
+OPERATORS = {'<': operator.lt, '<=': operator.le, '>': operator.gt, '>=': operator.ge,
+             '==': operator.eq, '!=': operator.ne}
+
+
+class ScriptError(Exception):
+    pass
+
+
+Step = collections.namedtuple("Step", "line kind fmt values data arg")
+
+
+def pack_command(fmt, values):
+    ''' Packs values as serial_monitor_lib.SerialData.write does: 'c' from text, 'f' as float, the rest as int '''
+    fields = []
+    for code, value in zip(fmt, values):
+        if code == 'c':
+            fields.append(value.encode())
+        elif code == 'f':
+            fields.append(float(value))
+        else:
+            fields.append(int(value))
+    return struct.pack("<" + fmt, *fields)
+
+
+def parse_rows(rows, source="script"):
+    ''' Steps for rows of text fields. Raises ScriptError naming the line of the first bad row. '''
+    steps = []
+    for line, row in enumerate(rows, 1):
+        # Whitespace inside a field is dropped, as the monitor always has
+        row = ["".join(field.split()) for field in row]
+        while row and row[-1] == '':
+            row.pop()
+        if not row or row[0].startswith('#'):
+            continue
+        where = "%s:%d: " % (source, line)
+        try:
+            if row[0].startswith('@'):
+                steps.append(_parse_directive(line, row))
+                continue
+            fmt, values = row[0], row[1:]
+            if len(fmt) != len(values):
+                raise ScriptError("%d fields in format %r but %d values" % (len(fmt), fmt, len(values)))
+            if fmt[0] != 'c':
+                raise ScriptError("format %r doesn't start with the command character" % fmt)
+            steps.append(Step(line, "send", fmt, values, pack_command(fmt, values), None))
+        except ScriptError as e:
+            raise ScriptError(where + str(e))
+        except (ValueError, struct.error, IndexError) as e:
+            raise ScriptError(where + "%s in %s" % (e, ",".join(row)))
+    return steps
+
+
+def _parse_directive(line, row):
+    kind = row[0][1:].lower()
+    args = row[1:]
+    if kind in ("period", "wait", "at"):
+        if len(args) != 1 or float(args[0]) < 0:
+            raise ScriptError("@%s takes one time >= 0" % kind)
+        return Step(line, kind, None, None, None, float(args[0]))
+    if kind == "ack":
+        if len(args) not in (1, 2) or len(args[0]) != 1:
+            raise ScriptError("@ack takes a command character and an optional timeout")
+        return Step(line, kind, None, None, None, (args[0], None, None, None, _timeout(args, 1)))
+    if kind == "until":
+        if len(args) not in (4, 5) or len(args[0]) != 1 or args[2] not in OPERATORS:
+            raise ScriptError("@until takes cmd, index, op (%s), value and an optional timeout"
+                              % " ".join(OPERATORS))
+        return Step(line, kind, None, None, None,
+                    (args[0], int(args[1]), OPERATORS[args[2]], float(args[3]), _timeout(args, 4)))
+    raise ScriptError("unknown directive %s" % row[0])
+
+
+def _timeout(args, i):
+    return float(args[i]) if len(args) > i else None
+
+
+def load(path):
+    with open(path, newline='') as f:
+        return parse_rows(csv.reader(f), path)
+
+
+class Sequencer:
+    ''' Runs steps, writing packed commands with write(bytes) and taking replies through onFrame(data) from
+        whatever reads the port. run() blocks until the script ends, stop() is called or a wait times out. '''
+
+    def __init__(self, steps, write, period=0.0, timeout=1.0):
+        self.steps = steps
+        self.write = write
+        self.period = period
+        self.timeout = timeout
+        self.frames = collections.deque(maxlen=FRAMES_KEPT)  # (number, arrival, data)
+        self.frame_count = 0
+        self.sent_commands = set()
+        self.rejected = 0
+        self.condition = threading.Condition()
+        self.stopped = False
+        self.rejected_before = 0
+        self.sends = []         # (line, scheduled, sent) [s from the start]
+        self.error = None
+
+    def onFrame(self, data):
+        now = time.perf_counter()
+        with self.condition:
+            self.frame_count += 1
+            self.frames.append((self.frame_count, now, data))
+            if len(data) > 1 and data[1] == '?' and data[0] in self.sent_commands:
+                self.rejected += 1
+            self.condition.notify_all()
+
+    def stop(self):
+        with self.condition:
+            self.stopped = True
+            self.condition.notify_all()
+
+    def _sleep_until(self, deadline):
+        ''' False if stopped first '''
+        with self.condition:
+            while not self.stopped:
+                remaining = deadline - time.perf_counter()
+                if remaining <= SPIN_S:
+                    break
+                self.condition.wait(remaining - SPIN_S)
+            if self.stopped:
+                return False
+        while time.perf_counter() < deadline:
+            pass
+        return True
+
+    def _wait_for(self, step, after):
+        ''' Waits for a frame newer than frame number after that matches step. Returns its arrival time. '''
+        cmd, index, test, value, timeout = step.arg
+        deadline = time.perf_counter() + (self.timeout if timeout is None else timeout)
+        with self.condition:
+            while True:
+                if self.rejected > self.rejected_before:
+                    raise ScriptError("line %d: the robot rejected a command" % step.line)
+                for number, arrival, data in self.frames:
+                    if number <= after:
+                        continue
+                    after = number
+                    if not data or data[0] != cmd:
+                        continue
+                    if index is None:
+                        return arrival
+                    try:
+                        if index < len(data) and test(float(data[index]), value):
+                            return arrival
+                    except (TypeError, ValueError):
+                        pass
+                remaining = deadline - time.perf_counter()
+                if self.stopped:
+                    return None
+                if remaining <= 0:
+                    raise ScriptError("line %d: no matching '%s' reply in time" % (step.line, cmd))
+                self.condition.wait(remaining)
+
+    def run(self):
+        ''' Returns True if the script ran to the end '''
+        start = time.perf_counter()
+        cursor = 0.0            # schedule [s from start] for the next command
+        period = self.period
+        last_send = 0           # frame count when the last command went out
+        try:
+            for step in self.steps:
+                if step.kind == "send":
+                    if not self._sleep_until(start + cursor):
+                        return False
+                    with self.condition:
+                        last_send = self.frame_count
+                        self.rejected_before = self.rejected
+                        self.sent_commands.add(step.values[0])
+                    sent = time.perf_counter()
+                    self.write(step.data)
+                    self.sends.append((step.line, cursor, sent - start))
+                    cursor += period
+                elif step.kind == "period":
+                    period = step.arg
+                elif step.kind == "wait":
+                    cursor += step.arg
+                elif step.kind == "at":
+                    cursor = step.arg
+                else:
+                    arrival = self._wait_for(step, last_send)
+                    if arrival is None:
+                        return False
+                    cursor = arrival - start
+            return True
+        except ScriptError as e:
+            self.error = str(e)
+            return False
+
+    def report(self):
+        late = sorted((sent - scheduled) * 1e6 for _, scheduled, sent in self.sends)
+        if not late:
+            return "nothing sent" + (", " + self.error if self.error else "")
+        text = "%d commands, late by mean %.0f us, p99 %.0f us, max %.0f us" % (
+            len(late), sum(late) / len(late), late[min(len(late) - 1, int(len(late) * 0.99))], late[-1])
+        if self.rejected:
+            text += ", %d rejected" % self.rejected
+        if self.error:
+            text += "\n" + self.error
+        return text
+
+    def writeLog(self, path):
+        commands = {step.line: step for step in self.steps if step.kind == "send"}
+        with open(path, "w", newline='') as f:
+            out = csv.writer(f)
+            out.writerow(["line", "scheduled [s]", "sent [s]", "late [us]", "format", "values"])
+            for line, scheduled, sent in self.sends:
+                step = commands[line]
+                out.writerow([line, "%.6f" % scheduled, "%.6f" % sent, "%.0f" % ((sent - scheduled) * 1e6),
+                              step.fmt] + step.values)
+
+
+def _reader(conn, sequencer, done):
+    parser = frame_parser.FrameParser()
+    decoder = telemetry.Decoder()
+    while not done.is_set():
+        try:
+            chunk = conn.read(conn.in_waiting or 1)
+        except Exception:
+            sequencer.stop()
+            return
+        if not chunk:
+            continue
+        parser.feed(chunk)
+        for fmt, values in parser.frames():
+            if values[0] == b'Y' and fmt.endswith('s'):
+                decoded = decoder.decode_delta(bytes(values[1]))
+                if decoded is not None:
+                    sequencer.onFrame(telemetry.flatten(*decoded))
+            else:
+                sequencer.onFrame(frame_parser.to_list(fmt, values))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send a command script on a fixed timeline")
+    parser.add_argument("script", help="command CSV, see the top of sequencer.py")
+    parser.add_argument("port", nargs="?", help="serial port of the robot")
+    parser.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+    parser.add_argument("--period", type=float, default=0.0, help="default spacing between commands [s]")
+    parser.add_argument("--timeout", type=float, default=1.0, help="default @ack/@until timeout [s]")
+    parser.add_argument("--log", help="write when each command was scheduled and sent to this CSV")
+    parser.add_argument("--dry-run", action="store_true", help="check the script and print the timeline")
+    args = parser.parse_args()
+
+    try:
+        steps = load(args.script)
+    except (ScriptError, OSError) as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    if args.dry_run:
+        cursor = 0.0
+        period = args.period
+        for step in steps:
+            if step.kind == "send":
+                print("%10.4f  line %-4d %s %s" % (cursor, step.line, step.fmt, " ".join(step.values)))
+                cursor += period
+            elif step.kind == "period":
+                period = step.arg
+            elif step.kind == "wait":
+                cursor += step.arg
+            elif step.kind == "at":
+                cursor = step.arg
+            else:
+                print("     reply  line %-4d @%s %s, timeline restarts from the reply" % (step.line, step.kind,
+                      step.arg[0]))
+                cursor = 0.0
+        return 0
+
+    sim = None
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+        port = sim.stdout.readline().strip()
+    elif args.port:
+        port = args.port
+    else:
+        parser.error("give a serial port or --sim")
+
+    # The reader thread holds the interpreter for up to the switch interval (5 ms by default) at a time
+    sys.setswitchinterval(SWITCH_INTERVAL_S)
+
+    import serial
+    conn = serial.Serial(port, 115200, timeout=0.05)
+    sequencer = Sequencer(steps, conn.write, args.period, args.timeout)
+    done = threading.Event()
+    reader = threading.Thread(target=_reader, args=(conn, sequencer, done), daemon=True)
+    try:
+        conn.reset_input_buffer()
+        reader.start()
+        ok = sequencer.run()
+    except KeyboardInterrupt:
+        sequencer.stop()
+        ok = False
+    finally:
+        done.set()
+        reader.join()
+        conn.close()
+        if sim is not None:
+            sim.terminate()
+
+    print(sequencer.report())
+    if args.log:
+        sequencer.writeLog(args.log)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -33,10 +33,11 @@ import itertools # interating through multiple lists
 # GUI IMPORTS
 from tkinter import *      # for gui general
 from tkinter.ttk import *  # for combobox
-from threading import Lock
+from threading import Lock, Thread
 
 # BACKGROUND MEGN540 FUNCTIONS
 import serial_monitor_lib
+import sequencer
 
 # IMPORT FOR DEQUEUE
 import collections
@@ -181,8 +182,9 @@ class GuiSetup:
         xLoc += 95
         yLoc += 3
         self.plot_select_values = [0]
-        self.plot_select = Combobox(self.gui, values = self.plot_select_values, width=3 )
+        self.plot_select = Combobox(self.gui, values = self.plot_select_values, width=8 )
         self.plot_select.bind("<<ComboboxSelected>>", self.plot_selection_changed)
+        self.plot_select.bind("<Return>", self.plot_selection_changed)
         self.plot_select.place(x=xLoc, y=yLoc)
         self.plot_select.current(0)
         self.plot_select.config(state='disabled')
@@ -198,8 +200,12 @@ class GuiSetup:
         self.update_gui()
         
     def plot_selection_changed(self,unused=None):
-        selection = self.plot_select.current()
-        if self.plotObject is not None:
+        # One index from the list, or several typed in and Enter, e.g. "3,4,5"
+        try:
+            selection = [int(i) for i in self.plot_select.get().split(',') if i.strip()]
+        except ValueError:
+            return
+        if self.plotObject is not None and selection:
             self.plotObject.changePlotIndex(selection)
             
             
@@ -341,7 +347,7 @@ class GuiSetup:
         threads as necessary  etc. """
         
         if self.auto_send_job is not None:
-            self.gui.after_cancel(self.auto_send_job)
+            self.auto_send_job.stop()
             self.auto_send_job = None
         
         if self.serial_object:
@@ -387,7 +393,7 @@ class GuiSetup:
                 
     def plotWindowOpenClose(self):
         if self.plotObject is None and self.serial_object.isConnected():
-            self.plotObject = serial_monitor_lib.RealTimePlot()
+            self.plotObject = serial_monitor_lib.RealTimePlot(timeSource=self.serial_object.sampleTime)
             self.serial_object.registerCallback(self.plotObject.addValue)
             self.plotObject.Start(self.gui)
             self.plot_select.config(state='enabled')
@@ -405,7 +411,7 @@ class GuiSetup:
 
     def dataRecordingStartStop(self):
         if self.recordObject is None and self.serial_object.isConnected():
-            self.recordObject = serial_monitor_lib.RecordData()
+            self.recordObject = serial_monitor_lib.RecordData(self.serial_object.sampleTime)
             self.serial_object.registerCallback(self.recordObject.addData)
             self.recordObject.startRecording()
             self.recording.configure(text="Stop Recording")
@@ -423,50 +429,38 @@ class GuiSetup:
         if not filename:
             return # none was selected
         
-        csvfile = open(filename,newline='\n')
-        csv_reader = csv.reader(csvfile, delimiter=',')
-        
-        command_list = collections.deque()
-        for row in csv_reader:
-            if len(row) is not 0:
-                command_list.append(row)
-        
-        csvfile.close()
-            
-        for row in command_list:
-            try:
-                size = struct.calcsize(row[0])
-                if len(row[0]) is not len(row)-1:
-                    print("Missmatch Encoding Number and Entries for Command String: " + row )
-                    return
-            except:
-                print(row[0])
-                print("Invalid Command Type: " + row[0] )
-                return
+        # Every row is checked and packed up front, see sequencer.py for the @ timing rows
+        try:
+            steps = sequencer.load(filename)
+        except (sequencer.ScriptError, OSError) as e:
+            print(e)
+            return
         
         delay_time = simpledialog.askfloat("Input", "Milliseconds Between Commands?",
                                parent=self.gui,
                                minvalue=0, maxvalue=10000)
+        if delay_time is None:
+            return
         
-        self.sendCSV_Commands(command_list, delay_time)
+        self.sendCSV_Commands(steps, delay_time)
      
-    def sendCSV_Commands(self, cmd_list, delay_time):
-        cmd = cmd_list.popleft();
-        fmt = cmd.pop(0)
-        
-        #load into boxes
-        for (f,c,box,entry) in itertools.zip_longest(fmt,cmd,self.combobox_out, self.data_entry,fillvalue=-1):
-            entry.delete(0,'end')
-            if f is not -1 and c is not -1:
-                box.current(self.out_selection.index(f))
-                entry.insert(END,"".join(c.split())) # .join(c.split()) removes any whitespace that might have been in the csv file
-                
-        self.send()
+    def sendCSV_Commands(self, steps, delay_time):
+        # Sent from a thread on a monotonic clock rather than by Tk, replies reach it through the serial callbacks
+        if self.auto_send_job is not None:
+            self.auto_send_job.stop()
         
-        if len(cmd_list) > 0:
-            self.auto_send_job = self.gui.after(int(delay_time), lambda:self.sendCSV_Commands(cmd_list,delay_time))
-        else:
-            self.auto_send_job = None
+        job = sequencer.Sequencer(steps, self.serial_object.writeBytes, delay_time / 1000.0)
+        self.serial_object.registerCallback(job.onFrame)
+        
+        def run():
+            try:
+                job.run()
+            finally:
+                self.serial_object.removeCallback(job.onFrame)
+            print(job.report())
+        
+        self.auto_send_job = job
+        Thread(target=run, daemon=True).start()
 
     def Callback(self, function):
         self.callbackfunction.append(function)
@@ -42,12 +42,17 @@ import collections  # FOR DEQUEUE USED IN DATA STORAGE AND CALLBACK QUEUES
 import serial # FOR SERIAL INTERFACE
 import struct # FOR BINARY DATA INTERFACING
 import time   # FOR TIME STAMPING DATA
+import os, shutil # FOR MOVING RECORDINGS
+
+import frame_parser # FOR SPLITTING THE STREAM INTO MESSAGES
+import telemetry # FOR DELTA ENCODED TELEMETRY FRAMES
+import clock_sync # FOR STAMPING DATA WITH THE ROBOT'S CLOCK
+import recorder # FOR STREAMING RECORDINGS TO DISK
 
 
 
 # FOR REALTIME PLOT
 import matplotlib.pyplot as plt 
-import matplotlib.animation as animation
 from matplotlib.backends.backend_tkagg import(FigureCanvasTkAgg,NavigationToolbar2Tk)
 
 
@@ -67,7 +72,9 @@ class SerialData:
         self.defined_data_mode = True
         self.dataNumBytes = -1
         self.dataFormat = "<"
-        self.rawData = None
+        self.telemetry = telemetry.Decoder()
+        self.clock = clock_sync.ClockSync()
+        self.frame_time = None
 
     def openPort (self, serialPort='COM5', serialBaud=9600):
         
@@ -97,54 +104,38 @@ class SerialData:
             self.isRun = True
             self.thread.start()
 
-    def parseData(self):
-        try:
-            value = struct.unpack(self.dataFormat, self.rawData)
-        except:
+    def parseData(self, fmt, values, arrival=None):
+        # Clock sync replies are for the monitor, not the callbacks
+        if values[0] == b'c' and fmt == "cBI" and not self.defined_data_mode:
+            self.clock.reply(values[1], values[2], arrival)
             return
-        
-        data = [];
-        
-        '''for i in range(len(value)):         
-            if self.dataFormat[i+1-rep_ind] == 'c':
-                data.append(value[i].decode('ascii'))
-            elif self.dataFormat[i+1-rep_ind] == 'b' or self.dataFormat[i] == 'h':
-                data.append(int(value[i]))
-            else:
-                data.append(value[i])'''
-        rep = 1
-        ind = 0
-        for fmt in self.dataFormat:
-            if fmt is '<':
-                continue
-            
-            if rep == 1:
-                try:
-                    rep = int(str(fmt))
-                    continue
-                except:
-                    rep = 1
-
-            for i in range(rep):
-                if fmt == 'c':
-                    if rep == 1 or i == 0:
-                        data.append(value[ind].decode('ascii'))
-                    else:
-                        data[-1] += value[ind].decode('ascii')
-                        
-                elif fmt == 's':
-                    data.append(value[ind].decode('ascii'))
-                    ind += 1
-                    break
-                elif fmt == 'b' or fmt == 'h':
-                    data.append(int(value[ind]))
-                else:
-                    data.append(value[ind])
-                    
-                ind += 1
-            rep = 1
 
-                
+        # Telemetry is stamped by the robot, everything else by its arrival mapped onto the robot's clock
+        if values[0] == b'Y' and fmt.endswith('s'):
+            # Delta telemetry frames ('y' 1) are handed on like plain 'Y' frames
+            decoded = self.telemetry.decode_delta(bytes(values[1]))
+            if decoded is None:
+                return
+            self.frame_time = self.clock.unwrap(decoded[0])
+            self.runCallbacks(telemetry.flatten(*decoded))
+            return
+
+        if values[0] == b'Y' and fmt.startswith("cBI") and not self.defined_data_mode:
+            self.frame_time = self.clock.unwrap(values[2])
+        elif arrival is not None and self.clock.synced():
+            self.frame_time = self.clock.to_robot(arrival)
+        else:
+            self.frame_time = arrival
+        self.runCallbacks(frame_parser.to_list(fmt, values))
+
+    def sampleTime(self):
+        ''' Robot time [s] of the data being handed to the callbacks, for them to stamp it with. Until the first
+            clock sync reply only telemetry has robot time, the rest is host time (time.perf_counter). '''
+        if self.frame_time is None:
+            return time.perf_counter()
+        return self.frame_time
+
+    def runCallbacks(self, data):
         self.callback_list_mutex.acquire()
         try:
             for function in self.callbackfunction:
@@ -158,7 +149,6 @@ class SerialData:
                 self.defined_data_mode = True
                 self.dataFormat = "<"+new_format
                 self.dataNumBytes = struct.calcsize(self.dataFormat)
-                self.rawData = bytearray(self.dataNumBytes)
             except:
                 print("Invalid Format: " + new_format)
                 return False
@@ -166,75 +156,51 @@ class SerialData:
             self.defined_data_mode = False
             self.dataFormat = "<"
             self.dataNumBytes = -1
-            self.rawData = None
         
         return True
 
     def backgroundThread(self):  # retrieve data
         self.serialConnection.reset_input_buffer()
+        # Wake at least this often to notice close()
+        self.serialConnection.timeout = 0.1
         print('Serial Monitoring Thread Started\n')
-        
-        self.rawData = bytearray(0)
-        
+
+        parser = frame_parser.FrameParser()
+        fixed = bytearray()
+        self.clock = clock_sync.ClockSync()
+
         while self.isRun:
             try:
-                if self.defined_data_mode and self.serialConnection.in_waiting >= self.dataNumBytes and self.dataNumBytes > 0:
-                    self.rawData = bytearray(self.dataNumBytes)
-                    self.serial_read_write_mutex.acquire()
-                    try:
-                        self.serialConnection.readinto(self.rawData)
-                    finally:
-                        self.serial_read_write_mutex.release()
-                    self.parseData()
-                
-                elif (not self.defined_data_mode) and self.serialConnection.in_waiting and  self.dataNumBytes == -1:
-                    self.dataNumBytes = struct.unpack('b',self.serialConnection.read(1))[0]
-                
-                elif (not self.defined_data_mode) and self.serialConnection.in_waiting >= self.dataNumBytes and self.dataNumBytes > 0 :
+                # Clock sync pings only in dynamic mode, a fixed format has no room for their replies
+                if not self.defined_data_mode and self.clock.due(time.perf_counter()):
                     self.serial_read_write_mutex.acquire()
                     try:
-                        tmp = self.serialConnection.read(1)
+                        self.serialConnection.write(self.clock.ping(time.perf_counter()))
                     finally:
                         self.serial_read_write_mutex.release()
-                    
-                    self.dataNumBytes -= 1
-                    tmp_uchar = struct.unpack('b',tmp)[0]
-                    
-                    if tmp_uchar is not 0:
-                        self.dataFormat = self.dataFormat + struct.unpack('c',tmp)[0].decode('ascii')
-                        try:
-                            try:
-                                i = int(self.dataFormat[-1])
-                            except:
-                                i = None
-                                
-                            if i is None:
-                                struct.calcsize(self.dataFormat) # check if its a valid format skip ones that end in a number
-                        except:
-                            print("num bytes: " + str(self.dataNumBytes) + " attempt fmt: " + self.dataFormat)
-                            self.dataNumBytes = -1
-                            self.dataFormat = "<"
-                    else:
-                        if struct.calcsize(self.dataFormat) == self.dataNumBytes:
-                            # all is as expected
-                            self.rawData = bytearray(self.dataNumBytes)
-                            self.serial_read_write_mutex.acquire()
-                            try:
-                                self.serialConnection.readinto(self.rawData)
-                            finally:
-                                self.serial_read_write_mutex.release()
-                            self.parseData()
-                        self.dataNumBytes = -1
-                        self.dataFormat = "<"
-                
-                elif self.dataNumBytes == 0:
-                    self.dataNumBytes = -1
-                
+
+                # Everything waiting in one read, or block for the next byte. pyserial reads and writes
+                # from different threads fine, so the write mutex isn't held while waiting.
+                chunk = self.serialConnection.read(self.serialConnection.in_waiting or 1)
+                arrival = time.perf_counter()
+                if not chunk:
+                    continue
+
+                if self.defined_data_mode:
+                    if self.dataNumBytes <= 0:
+                        continue
+                    fixed += chunk
+                    layout = parser.layout(self.dataFormat[1:])
+                    n = layout.size
+                    for i in range(0, len(fixed) - n + 1, n):
+                        self.parseData(self.dataFormat[1:], layout.unpack_from(fixed, i), arrival)
+                    del fixed[:len(fixed) - len(fixed) % n]
                 else:
-                    time.sleep(0.001) # recheck serial every 5ms
-                    
-                        
-            
+                    fixed.clear()
+                    parser.feed(chunk)
+                    for fmt, values in parser.frames():
+                        self.parseData(fmt, values, arrival)
+
             except:
                 self.isRun = False
                 self.thread = None
@@ -262,16 +228,8 @@ class SerialData:
 
 
         try:
-            if len(data) == 1:
-                msg = struct.pack("<"+data_format_str,data[0])
-            elif len(data) == 2:
-                msg = struct.pack("<"+data_format_str,data[0],data[1])
-            elif len(data) == 3:
-                msg = struct.pack("<"+data_format_str,data[0],data[1],data[2])
-            elif len(data) == 4:
-                msg = struct.pack("<"+data_format_str,data[0],data[1],data[2],data[3])
-            else:
-                return (False, "Data Length Unsupported")
+            # Any number of fields, e.g. 'W' trajectory segments use five
+            msg = struct.pack("<"+data_format_str, *data)
         except:
             return (False, "Format/Entry Mismatch" )
             
@@ -288,6 +246,17 @@ class SerialData:
         else:
             return (False, 'Not Connected')
 
+    def writeBytes(self, msg):
+        ''' Sends an already packed message, e.g. from sequencer.Sequencer '''
+        if not self.isConnected() or not self.serialConnection:
+            return False
+        self.serial_read_write_mutex.acquire()
+        try:
+            self.serialConnection.write(msg)
+        finally:
+            self.serial_read_write_mutex.release()
+        return True
+
     def close(self, on_shutdown=False):
         if self.isConnected():
             self.isRun = False
@@ -315,174 +284,301 @@ class SerialData:
 
 
 class RecordData:
-    def __init__(self):
-        self.csvData = collections.deque(maxlen=100000)
-        self.csvTime = collections.deque(maxlen=100000)
+    ''' Streams every callback row to a recording (see recorder.py) from the moment recording starts, so
+        nothing is dropped however long it runs. saveData then moves it, or exports it as CSV. Rows are
+        stamped by timeSource, e.g. SerialData.sampleTime for the robot's clock, or time.perf_counter. '''
+    def __init__(self, timeSource=time.perf_counter):
+        self.timeSource = timeSource
+        self.recorder = None
+        self.recorder_mutex = Lock()
         self.is_recording = False
 
     def startRecording(self):
+        base = time.strftime("recording_%Y%m%d_%H%M%S")
+        path = base + ".zrec"
+        suffix = 2
+        while os.path.exists(path):
+            path = "%s-%d.zrec" % (base, suffix)
+            suffix += 1
+        self.recorder = recorder.Recorder(path)
         self.is_recording = True
-        print("start recording")
+        print("start recording to " + path)
 
     def addData(self, value):
         if self.is_recording is True:
-            currentTimer = time.perf_counter()
-            self.csvData.append(value)
-            self.csvTime.append(currentTimer)
+            currentTimer = self.timeSource()
+            self.recorder_mutex.acquire()
+            try:
+                if self.is_recording:
+                    self.recorder.add(value, currentTimer)
+            finally:
+                self.recorder_mutex.release()
 
     def stopRecording(self):
         if self.is_recording:
-            self.is_recording = False
-            print("Stop recording")
+            self.recorder_mutex.acquire()
+            try:
+                self.is_recording = False
+                self.recorder.close()
+            finally:
+                self.recorder_mutex.release()
+            print("Stop recording, %d rows" % self.recorder.rows)
     
     def isRecording(self):
         return self.is_recording
 
     def saveData(self):
-        if self.csvData:
-            filename = filedialog.asksaveasfilename(title="test", filetypes=(("csv files", "*.csv"), ("all files", "*.*")))
-            if filename:
-                file = open(filename,'w');
-                time_ind = 0;
-                for val in self.csvData:
-                    file.write(str(self.csvTime[time_ind]))
-                    time_ind += 1
-                    for e in val:
-                        file.write(", " + str(e) )
-                    
-                    file.write('\n')
-                
-                file.close()
+        if self.recorder is None or self.is_recording:
+            return
+        path = self.recorder.path
+        if self.recorder.rows == 0:
+            os.remove(path)
+            return
+
+        filename = filedialog.asksaveasfilename(title="test", filetypes=(("csv files", "*.csv"), ("recordings", "*.zrec"), ("all files", "*.*")))
+        if not filename:
+            print("Recording kept in " + path)
+            return
+        if filename.endswith(".zrec"):
+            shutil.move(path, filename)
+            return
+
+        recording = recorder.Recording(path)
+        try:
+            recorder.export_csv(recording, filename)
+        finally:
+            recording.close()
+        os.remove(path)
+
+
+class DecimatedTrace:
+    ''' One channel of RealTimePlot. Samples fall into bins binWidth seconds wide and each bin keeps its lowest and
+        highest sample, so every sample counts but a window of any length draws as at most two points a bin. '''
+    def __init__(self, binWidth, bins):
+        self.binWidth = binWidth
+        self.bins = collections.deque(maxlen=bins + 1) # [bin, t at min, min, t at max, max]
+        self.latest = None
+
+    def add(self, t, value):
+        b = int(t // self.binWidth)
+        current = self.bins[-1] if self.bins else None
+        # A stamp that steps back (the clock sync moving) goes in the current bin
+        if current is None or b > current[0]:
+            self.bins.append([b, t, value, t, value])
+        elif value < current[2]:
+            current[1] = t
+            current[2] = value
+        elif value > current[4]:
+            current[3] = t
+            current[4] = value
+        self.latest = value
+
+    def points(self, start):
+        ''' Times and values from start on, min and max of each bin in the order they happened '''
+        times = []
+        values = []
+        for b, t_min, v_min, t_max, v_max in self.bins:
+            if t_min < start and t_max < start:
+                continue
+            if t_min == t_max:
+                times.append(t_min)
+                values.append(v_min)
+            elif t_min < t_max:
+                times += (t_min, t_max)
+                values += (v_min, v_max)
+            else:
+                times += (t_max, t_min)
+                values += (v_max, v_min)
+        return times, values
 
 
 class RealTimePlot():
-    def __init__(self, plotLength=500, refreshTime=10):
+    ''' Plots the selected indices of the callback lists against time, the last plotWindow seconds. Every sample
+        goes into a DecimatedTrace and only the lines are redrawn each refresh (blitting); the axes are redrawn
+        when the y range has to change. The x axis is time before the latest sample, so it never scrolls. '''
+    PLOT_COLORS = ['tab:blue', 'tab:orange', 'tab:green', 'tab:red', 'tab:purple', 'tab:brown', 'tab:pink', 'tab:gray']
+
+    def __init__(self, plotWindow=10.0, refreshTime=50, timeSource=None, bins=1000):
                
+        # Samples are stamped by timeSource (e.g. SerialData.sampleTime), or by arrival since the plot opened
+        self.timeSource = timeSource
         self.gui_main = None       
         self.window = None
-        self.plotMaxLength = plotLength
+        self.plotWindow = plotWindow
+        self.bins = bins
         
-        self.data  = collections.deque( maxlen=plotLength)
-        self.times = collections.deque( maxlen=plotLength)
-        self.plotTimer = 0
-        self.previousTimer = 0
-        self.valueLast = None
-        self.p = None
         self.fig = None
+        self.ax = None
+        self.canvas = None
+        self.lines = []
+        self.background = None
+        self.job = None
         
         self.t_start = time.perf_counter()
-        self.values_queue = collections.deque(maxlen=plotLength)
-        self.times_queue  = collections.deque(maxlen=plotLength)
+        self.channels = [0]
+        self.traces = {}
+        self.command = None
+        self.latest_time = None
+        self.samples = 0
         
-        self.plotTimer = 0
         self.previousTimer = 0
+        self.previousSamples = 0
         self.timeText = None
-        
-        self.input_index = 0;
+        self.lineValueText = None
         
         self.pltInterval = refreshTime  # Refresh period [ms]
         
         self.data_mutex = Lock()
+        self.resetTraces()
 
-    def updatePlotData(self,args=None): #, frame, lines, lineValueText, lineLabel, timeText):
-#        while self.isRunning:
-        
-        if len(self.times_queue):
-            currentTimer = time.perf_counter()
-            self.plotTimer = int((currentTimer - self.previousTimer) * 1000)
-            if self.plotTimer > 1:
-                self.previousTimer = currentTimer
-                self.timeText.set_text('Plot Interval = ' + str(self.plotTimer) + 'ms')
+    def resetTraces(self):
+        self.data_mutex.acquire()
+        try:
+            self.traces = {i: DecimatedTrace(self.plotWindow / self.bins, self.bins) for i in self.channels}
+            # Plot one message type: the first one to arrive after the selection
+            self.command = None
+            self.latest_time = None
+        finally:
+            self.data_mutex.release()
+
+    def addValue(self, value):
+        if self.timeSource is not None:
+            t = self.timeSource()
         else:
-            return
-       
-        valueLast = []
+            t = time.perf_counter()-self.t_start
 
         self.data_mutex.acquire()
-
-        while len(self.times_queue):
-            try:
-                valueLast = self.values_queue[-1][self.input_index]
-                time_val = self.times_queue[-1]
-                valueLast = float(valueLast) # make sure its a number
-                self.data.append(valueLast)  # latest data point and append it to array
-                self.times.append(time_val)
-                self.values_queue.clear()
-                self.times_queue.clear()
-            except:
-                break
+        try:
+            if self.command is None:
+                self.command = value[0] if len(value) and isinstance(value[0], str) else ''
+            elif self.command and (not len(value) or value[0] != self.command):
+                return
+            for i, trace in self.traces.items():
+                if i < len(value):
+                    try:
+                        trace.add(t, float(value[i]))
+                    except (TypeError, ValueError):
+                        pass
+            self.latest_time = t
+            self.samples += 1
+        finally:
+            self.data_mutex.release()
         
+    def changePlotIndex(self, index):
+        self.channels = list(index) if isinstance(index, (list, tuple)) else [index]
+        self.resetTraces()
+        if self.ax is not None:
+            self.setupLines()
+
+    def setupLines(self):
+        for line in self.lines:
+            line.remove()
+        self.lines = []
+        for n, i in enumerate(self.channels):
+            self.lines.append(self.ax.plot([], [], label="IND: " + str(i), animated=True,
+                                           color=self.PLOT_COLORS[n % len(self.PLOT_COLORS)])[0])
+        self.ax.legend(loc='upper left')
+        self.canvas.draw()
 
-        self.data_mutex.release()
-        
-        self.lines.set_data(self.times, self.data)
-        if len(self.data):
-            self.lineValueText.set_text('[' + self.lineLabel + " IND: " +str(self.input_index) + '] = ' + str(round(self.data[-1],3)))
-        
-        if len(self.times) > 5:
-            #self.fig.canvas.restore_region(self.background)
-            self.ax.set_xlim(self.times[0],self.times[-1])
-            
-            min_ylim = min(self.data)
-            max_ylim = max(self.data)
-            
-            if min_ylim == max_ylim:
-                if min_ylim == 0:
-                    min_ylim = -1
-                    max_ylim = 1
-                else:
-                    min_ylim = min_ylim*.2
-                    max_ylim = max_ylim*1.2
-            
-            
-            self.ax.set_ylim(min_ylim - (max_ylim-min_ylim)/10, max_ylim + (max_ylim-min_ylim)/10)
+    def onDraw(self, event=None):
+        # A full draw leaves the animated artists out, so this is the background to blit them on
+        self.background = self.canvas.copy_from_bbox(self.ax.bbox)
+        self.drawArtists()
+
+    def drawArtists(self):
+        for line in self.lines:
+            self.ax.draw_artist(line)
+        self.ax.draw_artist(self.timeText)
+        self.ax.draw_artist(self.lineValueText)
+
+    def updateLimits(self, low, high):
+        ''' Grows the y range at once, shrinks it only when the data uses under half of it. Returns True if
+            it changed. '''
+        current_low, current_high = self.ax.get_ylim()
+        if low >= current_low and high <= current_high and (high - low) * 2 > current_high - current_low:
+            return False
+        if low == high:
+            if low == 0:
+                low, high = -1, 1
+            else:
+                low, high = low - abs(low) * .2, high + abs(high) * .2
+        margin = (high - low) / 10
+        self.ax.set_ylim(low - margin, high + margin)
+        return True
+
+    def updatePlotData(self):
+        if self.job is None:
+            return
+        self.job = self.window.after(self.pltInterval, self.updatePlotData)
 
-    def addValue(self, value):
         self.data_mutex.acquire()
-        self.values_queue.append(value)
-        self.times_queue.append(time.perf_counter()-self.t_start)
-        self.data_mutex.release()
-        
-    def changePlotIndex(self, index):
-        self.input_index = index
-        self.times.clear()
-        self.data.clear()
+        try:
+            latest = self.latest_time
+            if latest is None:
+                return
+            start = latest - self.plotWindow
+            points = [self.traces[i].points(start) if i in self.traces else ([], []) for i in self.channels]
+            values = [self.traces[i].latest if i in self.traces else None for i in self.channels]
+            samples = self.samples
+        finally:
+            self.data_mutex.release()
+
+        low = None
+        high = None
+        for line, (times, data) in zip(self.lines, points):
+            line.set_data([t - latest for t in times], data)
+            if data:
+                low = min(data) if low is None else min(low, min(data))
+                high = max(data) if high is None else max(high, max(data))
+
+        currentTimer = time.perf_counter()
+        if currentTimer - self.previousTimer >= 1:
+            rate = (samples - self.previousSamples) / (currentTimer - self.previousTimer)
+            self.timeText.set_text('Plot Interval = ' + str(self.pltInterval) + 'ms, ' + str(int(rate)) + ' samples/s')
+            self.previousTimer = currentTimer
+            self.previousSamples = samples
+        self.lineValueText.set_text('[' + str(self.command or '') + '] ' + '  '.join(
+            'IND ' + str(i) + ' = ' + ('-' if v is None else str(round(v, 3))) for i, v in zip(self.channels, values)))
+
+        if low is not None and self.updateLimits(low, high):
+            self.canvas.draw()
+        elif self.background is not None:
+            self.canvas.restore_region(self.background)
+            self.drawArtists()
+            self.canvas.blit(self.ax.bbox)
 
     def setupPlot(self):  # retrieve data
-        xmin = 0
-        xmax = self.plotMaxLength
-        ymin = -1
-        ymax = 1050
         self.fig = plt.figure()
-        self.ax = plt.axes( autoscale_on=True)#xlim=(xmin, xmax), ylim=(float(ymin - (ymax - ymin) / 10), float(ymax + (ymax - ymin) / 10)))
-        self.ax.set_title('Arduino Analog Read')
-        self.ax.set_xlabel("time")
-        self.ax.set_ylabel("AnalogRead Value")
+        self.ax = plt.axes()
+        self.ax.set_title('Real Time Plot')
+        self.ax.set_xlabel("time before the latest sample [s]")
+        self.ax.set_ylabel("value")
+        self.ax.set_xlim(-self.plotWindow, 0)
+        self.ax.set_ylim(-1, 1)
         
         self.canvas = FigureCanvasTkAgg(self.fig, master=self.window)
-        self.canvas.draw()
         self.canvas.get_tk_widget().pack(side=tkinter.TOP, fill=tkinter.BOTH, expand=1)
         
         toolbar = NavigationToolbar2Tk(self.canvas,self.window)
         toolbar.update()
         self.canvas.get_tk_widget().pack(side=tkinter.TOP, fill=tkinter.BOTH, expand=1)
 
-        self.lineLabel = 'Sensor Value'
-        self.timeText = self.ax.text(0.50, 0.95, '', transform=self.ax.transAxes)
-        self.lines = self.ax.plot([], [], label=self.lineLabel)[0]
-        self.lineValueText = self.ax.text(0.50, 0.90, '', transform=self.ax.transAxes)
+        self.timeText = self.ax.text(0.50, 0.95, '', transform=self.ax.transAxes, animated=True)
+        self.lineValueText = self.ax.text(0.50, 0.90, '', transform=self.ax.transAxes, animated=True)
+        self.canvas.mpl_connect('draw_event', self.onDraw)
+        self.setupLines()
   
-        # START THE PLOT ANIMATION
-        self.anim = animation.FuncAnimation(self.fig, self.updatePlotData, interval=self.pltInterval)
+        # START THE PLOT UPDATES
+        self.job = self.window.after(self.pltInterval, self.updatePlotData)
         
     
     def isOk(self):
-        return self.anim is not None
+        return self.job is not None
 
     def close(self):
-        if self.anim is not None:
-            self.anim.event_source.stop()
-        self.anim = None
+        if self.job is not None:
+            self.window.after_cancel(self.job)
+        self.job = None
  
         self.window.withdraw()
         
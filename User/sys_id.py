@@ -0,0 +1,460 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+'''
+    sys_id.py fits a discrete motor model to each wheel from recorded PWM
+    steps and designs the wheel speed controllers (Controller_Init in
+    Main.c) for a target bandwidth, in place of the hand fit in
+    Application/Controller_Coeffs.h:
+
+        python sys_id.py record /dev/ttyACM0 run.zrec      # drive the steps, record the 'Q' stream
+        python sys_id.py record --sim run.zrec             # the same on Host/BIN/Link_Sim
+        python sys_id.py fit run.zrec --bandwidth 4 --header ../Application/Controller_Coeffs.h
+        python sys_id.py fit run.zrec --params tuned.params  # for params.py apply, no reflash
+
+    fit takes any number of recordings of the 'Q' stream: .zrec files from
+    record or from the monitor's Record button, or their CSV export
+    (recorder.py export). A recording is split into runs where the stream
+    stops. sys_id_template.csv is a one step script for the monitor or
+    sequencer.py.
+
+    Each wheel's speed is resampled to the control period and fit by least
+    squares, first order (--order 1) or second order:
+
+        v[k+1] = a1 v[k] (+ a2 v[k-1]) + b1 d[k] (+ b2 d[k-1]) + c on[k]
+
+    v is the wheel speed in m/s, d the duty cycle in %, on is 1 while the
+    duty is above zero. The robot reports the duty without its sign and the
+    controller works on speed magnitudes, so speeds are magnitudes too.
+
+    The controller's output goes through Velocity_to_DutyCycle, so it is
+    designed for the model seen from there (FEEDFORWARD, copied from
+    Driver/MotorPWM.c). The design is an integrator plus pole placement:
+    the closed loop gets one pole at the bandwidth, keeps the model's
+    stable real poles and puts the rest at the origin. The fitted steady
+    state speed shows whether the feedforward still matches the robot.
+    Main.c closes the loop when CNTRL_SYS is 1.
+
+    --params writes the controllers as parameter settings instead, so
+    params.py can set them on running robots. The order can't be above the
+    firmware's CONTROLLER_ORDER (Application/Controller_Coeffs.h), the
+    robot rejects coefficients past it; write --header and reflash to
+    change the order.
+'''
+
+import argparse
+import csv
+import datetime
+import os
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+import protocol
+import recorder
+from frame_parser import FrameParser, to_list
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+COEFFS_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Application", "Controller_Coeffs.h")
+
+# Controller_Init's update period [s]
+PERIOD = 0.01
+
+# Velocity_to_DutyCycle_Left/Right in Driver/MotorPWM.c: v = slope * d + offset
+FEEDFORWARD = {"left": (0.0033, 0.0133), "right": (0.0034, 0.0133)}
+WHEELS = ("left", "right")
+
+# ECount_to_Distance in Driver/MotorPWM.c
+METERS_PER_COUNT = 2 * np.pi * 0.0195 / (12 * 75.81)
+
+# Model poles the design keeps must be at least this fast
+MAX_KEPT_POLE = 0.98
+
+# A gap in the 'Q' stream this many sample periods long starts a new run
+GAP_SAMPLES = 5
+
+
+def load_runs(path):
+    ''' The 'Q' rows of a recording, as arrays of (robot time, pwm left, pwm right, enc left, enc right)
+        split where the stream stops '''
+    rows = []
+    if path.endswith(".zrec"):
+        recording = recorder.Recording(path)
+        try:
+            for number, (types, command) in sorted(recording.streams.items()):
+                if command in ("q", "Q") and types == "Udqqqq":
+                    rows.extend(zip(*recording.columns(number)[2:]))
+        finally:
+            recording.close()
+    else:
+        # recorder.py export: host time, Q, robot time, pwm left, pwm right, enc left, enc right
+        with open(path) as f:
+            for row in csv.reader(f, skipinitialspace=True):
+                if len(row) == 7 and row[1] in ("q", "Q"):
+                    rows.append([float(v) for v in row[2:]])
+    if len(rows) < 2:
+        raise ValueError("%s has no 'Q' stream" % path)
+
+    rows = np.array(sorted(rows), dtype=float)
+    steps = np.diff(rows[:, 0])
+    gaps = np.nonzero(steps > GAP_SAMPLES * np.median(steps))[0] + 1
+    return [run for run in np.split(rows, gaps) if len(run) > 1]
+
+
+def unwrap_counts(counts):
+    ''' The robot sends encoder counts as int16, undoes the wrap around '''
+    steps = (np.diff(counts) + 32768) % 65536 - 32768
+    return counts[0] + np.concatenate(([0], np.cumsum(steps)))
+
+
+def resample(run, period):
+    ''' Speed [m/s], duty [%] and on fraction of each wheel on a uniform grid, arrays (2, n), each the
+        mean over one period. The duty reported in each row is held until the next. '''
+    t = run[:, 0]
+    duty = np.abs(run[:, 1:3])
+    # Before its first command the robot reports the duty it was set up with, but the motors are off
+    changed = np.nonzero(np.any(duty != duty[0], axis=1))[0]
+    duty[:changed[0] if len(changed) else len(duty)] = 0
+
+    grid = np.arange(t[0], t[-1], period)
+    speed = np.empty((2, len(grid) - 1))
+    mean_duty = np.empty_like(speed)
+    on = np.empty_like(speed)
+    for wheel in range(2):
+        position = np.interp(grid, t, unwrap_counts(run[:, 3 + wheel]) * METERS_PER_COUNT)
+        speed[wheel] = np.abs(np.diff(position)) / period
+        mean_duty[wheel] = np.diff(np.interp(grid, t, held_integral(t, duty[:, wheel]))) / period
+        on[wheel] = np.diff(np.interp(grid, t, held_integral(t, duty[:, wheel] > 0))) / period
+    return speed, mean_duty, on
+
+
+def held_integral(t, values):
+    ''' The integral of values held from each time to the next, at each time '''
+    return np.concatenate(([0.0], np.cumsum(values[:-1] * np.diff(t))))
+
+
+def regressors(speed, duty, on, order):
+    ''' Least squares rows predicting v[k+1] from the last order speeds and duties and the on fraction '''
+    n = len(speed)
+    columns = [speed[order - 1 - i:n - 1 - i] for i in range(order)]
+    columns += [duty[order - 1 - i:n - 1 - i] for i in range(order)]
+    columns.append(on[order - 1:n - 1])
+    return np.column_stack(columns), speed[order:]
+
+
+def simulate(model, duty, on, start):
+    ''' Runs the model on a duty sequence from the measured first speeds '''
+    order = len(model["a"])
+    speed = np.zeros(len(duty))
+    speed[:order] = start
+    for k in range(order - 1, len(duty) - 1):
+        speed[k + 1] = (model["a"] @ speed[k - order + 1:k + 1][::-1] + model["b"] @ duty[k - order + 1:k + 1][::-1]
+                        + model["c"] * on[k])
+    return speed
+
+
+def fit(samples, wheel, order):
+    ''' Fits one wheel over every run, returns the model: a, b, c and the free run error nrmse '''
+    rows = [regressors(speed[wheel], duty[wheel], on[wheel], order) for speed, duty, on in samples
+            if speed.shape[1] > order]
+    phi = np.vstack([r[0] for r in rows])
+    target = np.concatenate([r[1] for r in rows])
+    if len(target) < 10 * phi.shape[1] or not phi[:, -1].any() or phi[:, -1].all():
+        raise ValueError("the recordings need steps with the motors on and off to fit order %d" % order)
+
+    params = np.linalg.lstsq(phi, target, rcond=None)[0]
+    model = {"a": params[:order], "b": params[order:2 * order], "c": params[-1]}
+
+    errors = np.concatenate([simulate(model, duty[wheel], on[wheel], speed[wheel][:order]) - speed[wheel]
+                             for speed, duty, on in samples])
+    measured = np.concatenate([speed[wheel] for speed, _, _ in samples])
+    model["nrmse"] = np.sqrt(np.mean(errors ** 2)) / max(np.ptp(measured), 1e-9)
+    return model
+
+
+def shifted(poly, shift, size):
+    ''' poly * z^shift as size coefficients, highest power first '''
+    return np.concatenate((np.zeros(size - len(poly) - shift), poly, np.zeros(shift)))
+
+
+def design(model, wheel, period, bandwidth):
+    ''' The controller for one wheel as Filter_Init's (numerator, denominator) in powers of z^-1 '''
+    order = len(model["a"])
+    slope = FEEDFORWARD[wheel][0]
+
+    # Model from the controller's output [m/s] to the speed: B(z) / A(z), A monic
+    plant_a = np.concatenate(([1.0], -model["a"]))
+    plant_b = model["b"] / slope
+
+    # Closed loop poles: the bandwidth, the model's stable real poles, the rest at the origin
+    kept = [p.real for p in np.roots(plant_a) if abs(p.imag) < 1e-9 and 0 < p.real < MAX_KEPT_POLE]
+    poles = [np.exp(-2 * np.pi * bandwidth * period)] + kept
+    closed = np.poly(poles + [0.0] * (2 * order - len(poles))).real
+
+    # Controller S(z) / R(z) with R = (z - 1) R', R' monic: solve A R + B S = closed for R' and S
+    size = 2 * order + 1
+    a_integrator = np.polymul(plant_a, [1.0, -1.0])
+    columns = [shifted(a_integrator, order - 1 - i, size) for i in range(1, order)]
+    columns += [shifted(plant_b, order - j, size) for j in range(order + 1)]
+    known = shifted(a_integrator, order - 1, size)
+    solution = np.linalg.solve(np.column_stack(columns)[1:], (closed - known)[1:])
+
+    numerator = solution[order - 1:]
+    denominator = np.polymul(np.concatenate(([1.0], solution[:order - 1])), [1.0, -1.0])
+    return numerator, denominator
+
+
+def step_response(model, wheel, numerator, denominator, speed_step, steps):
+    ''' The closed loop on the model for a speed step, as Main.c runs it: error in, controller out, through
+        Velocity_to_DutyCycle to a duty limited to 0..100 % '''
+    order = len(model["a"])
+    slope, offset = FEEDFORWARD[wheel]
+    pad = order
+    speed = np.zeros(steps + pad)
+    error = np.zeros(steps + pad)
+    output = np.zeros(steps + pad)
+    duty = np.zeros(steps + pad)
+    for k in range(pad, steps + pad - 1):
+        error[k] = speed_step - speed[k]
+        output[k] = numerator @ error[k - order:k + 1][::-1] - denominator[1:] @ output[k - order:k][::-1]
+        duty[k] = np.clip(int((output[k] - offset) / slope), 0, 100)
+        speed[k + 1] = (model["a"] @ speed[k - order + 1:k + 1][::-1] + model["b"] @ duty[k - order + 1:k + 1][::-1]
+                        + model["c"] * (duty[k] > 0))
+    return speed[pad:]
+
+
+def describe_step(speed, speed_step, period):
+    rise = np.nonzero(speed >= 0.9 * speed_step)[0]
+    settled = speed[-len(speed) // 4:]
+    return "rise %s, overshoot %.0f%%, final %.3f m/s" % (
+        "%.0f ms" % (rise[0] * period * 1000) if len(rise) else "never",
+        max(0.0, speed.max() / speed_step - 1) * 100, settled.mean())
+
+
+def write_header(path, controllers, period, source):
+    ''' Writes Application/Controller_Coeffs.h '''
+    order = len(controllers["left"][0]) - 1
+    lines = [
+        "/*",
+        " * Controller_Coeffs.h holds the wheel speed controllers Main.c passes to",
+        " * Controller_Init, numerator (b) and denominator (a) in powers of z^-1,",
+        " * as the defaults of the kp_, num_ and den_ runtime parameters (Params.h).",
+        " * Designed by User/sys_id.py from %s." % source,
+        " * To redesign for a robot:",
+        " *",
+        " *      python3 User/sys_id.py fit <recording> --header Application/Controller_Coeffs.h",
+        " */",
+        "#ifndef CONTROLLER_COEFFS_H",
+        "#define CONTROLLER_COEFFS_H",
+        "",
+        "#define CONTROLLER_ORDER\t%d" % order,
+        "#define CONTROLLER_PERIOD_MS\t%d\t\t// [ms]" % round(period * 1000),
+        "",
+    ]
+    for wheel in WHEELS:
+        numerator, denominator = controllers[wheel]
+        name = wheel.upper()
+        lines.append("#define KP_%s\t\t%.7f" % (name[0], numerator[0]))
+        lines.append("#define NUM_%s\t{ %s }" % (name, ", ".join("%.12f" % v for v in numerator)))
+        lines.append("#define DEN_%s\t{ %s }" % (name, ", ".join("%.12f" % v for v in denominator)))
+        lines.append("")
+    lines.append("#endif")
+    with open(path, "w") as out:
+        out.write("\n".join(lines) + "\n")
+
+
+def firmware_order():
+    ''' CONTROLLER_ORDER from Application/Controller_Coeffs.h, None if it can't be read '''
+    try:
+        with open(COEFFS_PATH) as header:
+            for line in header:
+                fields = line.split()
+                if fields[:2] == ["#define", "CONTROLLER_ORDER"]:
+                    return int(fields[2])
+    except (OSError, IndexError, ValueError):
+        pass
+    return None
+
+
+def write_params(path, controllers, source):
+    ''' Writes the controllers as name=value lines for params.py apply '''
+    lines = ["# Wheel speed controllers from User/sys_id.py, %s" % source]
+    for wheel in WHEELS:
+        numerator, denominator = controllers[wheel]
+        lines.append("kp_%s=%.7g" % (wheel, numerator[0]))
+        for name, coeffs in (("num", numerator), ("den", denominator)):
+            size = protocol.PARAMS["%s_%s" % (name, wheel)].count
+            coeffs = list(coeffs) + [0.0] * (size - len(coeffs))
+            lines.append("%s_%s=%s" % (name, wheel, ",".join("%.9g" % v for v in coeffs)))
+    with open(path, "w") as out:
+        out.write("\n".join(lines) + "\n")
+
+
+def record(conn, path, duties, hold, rest, period):
+    ''' Steps both wheels through duties, each held for hold seconds then off for rest, and records the
+        'Q' stream to path as the monitor would '''
+    parser = FrameParser()
+    rec = recorder.Recorder(path)
+    schedule = []
+    when = rest
+    for duty in duties:
+        schedule.append((when, protocol.pack('P', duty, duty, hold)))
+        when += hold + rest
+
+    conn.write(protocol.pack('s'))
+    conn.write(protocol.pack('Q', period))
+    start = time.perf_counter()
+    rows = 0
+    try:
+        while True:
+            now = time.perf_counter() - start
+            while schedule and schedule[0][0] <= now:
+                conn.write(schedule.pop(0)[1])
+            if not schedule and now > when:
+                break
+            parser.feed(conn.read(conn.in_waiting or 1))
+            for fmt, values in parser.frames():
+                values = to_list(fmt, values)
+                if values[0] == 'Q':
+                    rec.add(values)
+                    rows += 1
+    finally:
+        conn.write(protocol.pack('Q', -1.0))
+        conn.write(protocol.pack('s'))
+        rec.close()
+    return rows
+
+
+def main_record(args, parser):
+    duties = [int(d) for d in args.duties.split(",")]
+    if not all(0 < d <= 100 for d in duties):
+        parser.error("--duties are 1 to 100 %")
+
+    sim = None
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+        port = sim.stdout.readline().strip()
+    elif args.port:
+        port = args.port
+    else:
+        parser.error("give a serial port or --sim")
+
+    import serial
+    conn = serial.Serial(port, 115200, timeout=0.01)
+    try:
+        conn.reset_input_buffer()
+        rows = record(conn, args.recording, duties, args.hold, args.rest, args.period)
+    finally:
+        conn.close()
+        if sim is not None:
+            sim.terminate()
+            sim.wait()
+    print("%d 'Q' rows in %s" % (rows, args.recording))
+    return 0 if rows else 1
+
+
+def main_fit(args, parser):
+    if args.order not in (1, 2):
+        parser.error("--order is 1 or 2")
+    # The robot only runs CONTROLLER_ORDER, a new header has to be flashed first
+    order = firmware_order()
+    if args.params and not args.header and order is not None and args.order > order:
+        parser.error("--params with --order %d, but the firmware runs order %d (CONTROLLER_ORDER in "
+                     "Application/Controller_Coeffs.h); write --header and reflash to change it" % (args.order, order))
+    samples = []
+    for path in args.recordings:
+        samples.extend(resample(run, args.period) for run in load_runs(path))
+
+    controllers = {}
+    for wheel_index, wheel in enumerate(WHEELS):
+        model = fit(samples, wheel_index, args.order)
+        slope, offset = FEEDFORWARD[wheel]
+        gain = model["b"].sum() / (1 - model["a"].sum())
+        print("%s: a %s, b %s, c %.5f, free run error %.1f%%" % (
+            wheel, np.array2string(model["a"], precision=5), np.array2string(model["b"], precision=6),
+            model["c"], model["nrmse"] * 100))
+        poles = np.roots(np.concatenate(([1.0], -model["a"])))
+        slow = max(abs(poles))
+        if 0 < slow < 1:
+            print("    time constant %.1f ms" % (-args.period / np.log(slow) * 1000))
+        print("    steady state v = %.5f d + %.4f (feedforward %.4f d + %.4f)" % (
+            gain, model["c"] / (1 - model["a"].sum()), slope, offset))
+
+        numerator, denominator = design(model, wheel, args.period, args.bandwidth)
+        controllers[wheel] = (numerator, denominator)
+        print("    controller b %s, a %s" % (np.array2string(numerator, precision=6),
+                                             np.array2string(denominator, precision=6)))
+        steps = int(round(1.0 / args.period))
+        speed = step_response(model, wheel, numerator, denominator, args.step, steps)
+        print("    %.2f m/s step on the model: %s" % (args.step, describe_step(speed, args.step, args.period)))
+
+    source = "%s, order %d, %g Hz, %s" % (", ".join(os.path.basename(p) for p in args.recordings),
+                                          args.order, args.bandwidth, datetime.date.today().isoformat())
+    if args.header:
+        write_header(args.header, controllers, args.period, source)
+        print("wrote %s" % args.header)
+    if args.params:
+        write_params(args.params, controllers, source)
+        print("wrote %s" % args.params)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fit the wheel motors and design their speed controllers")
+    commands = parser.add_subparsers(dest="command")
+
+    p = record_parser = commands.add_parser("record", help="drive PWM steps and record the 'Q' stream")
+    p.add_argument("port", nargs="?", help="serial port of the robot")
+    p.add_argument("recording", help="recording to write (.zrec)")
+    p.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+    p.add_argument("--duties", default="20,40,60,80", help="step duty cycles [%%] (default 20,40,60,80)")
+    p.add_argument("--hold", type=float, default=0.5, help="time at each duty [s] (default 0.5)")
+    p.add_argument("--rest", type=float, default=0.5, help="time off after each step [s] (default 0.5)")
+    p.add_argument("--period", type=float, default=0.005, help="'Q' period [s] (default 0.005)")
+
+    p = fit_parser = commands.add_parser("fit", help="fit the motor models and design the controllers")
+    p.add_argument("recordings", nargs="+", help="recordings of the 'Q' stream (.zrec or exported .csv)")
+    p.add_argument("--order", type=int, default=1, help="model order, 1 or 2 (default 1)")
+    p.add_argument("--bandwidth", type=float, default=4.0, help="closed loop bandwidth [Hz] (default 4)")
+    p.add_argument("--period", type=float, default=PERIOD, help="control period [s] (default %g)" % PERIOD)
+    p.add_argument("--step", type=float, default=0.2, help="speed step for the report [m/s] (default 0.2)")
+    p.add_argument("--header", help="write the controllers to this Controller_Coeffs.h")
+    p.add_argument("--params", help="write the controllers to this file of parameter settings (params.py apply)")
+
+    args = parser.parse_args()
+    if args.command == "record":
+        return main_record(args, record_parser)
+    if args.command == "fit":
+        return main_fit(args, fit_parser)
+    parser.print_help()
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
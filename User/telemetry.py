@@ -0,0 +1,278 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+'''
+    telemetry.py subscribes to the robot's telemetry channels ('Y') and
+    prints the batched frames, one line per frame with the channels that
+    were due in it.
+
+        python telemetry.py /dev/ttyACM0 encoders=0.01 battery=1 pose=0.05
+        python telemetry.py /dev/ttyACM0 encoders=0.01 --delta     # compressed frames
+        python telemetry.py --sim all=0.1 --seconds 2   # no robot, uses Host/BIN/Link_Sim
+
+    Each argument is channel=period [s]. A plain frame is "cBI" + the
+    fields of the channels in its bitmap, in channel order. The "I" is the
+    robot's time in microseconds (see clock_sync.py). With --delta
+    the robot sends zigzag varint deltas with a keyframe every --keyframe
+    frames instead. See Application/Telemetry.h for both. The totals at
+    the end show the bytes per frame either way.
+
+    subscribe(), set_encoding() and Decoder can be imported by other
+    scripts; serial_monitor_lib.py uses Decoder for delta frames.
+'''
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import time
+
+import protocol
+from trace_decode import read_messages
+
+SIM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host", "BIN", "Link_Sim")
+
+ALL = 0xFF
+
+# (name, struct fields, field names) in bit order, see eTelemChannel. Delta
+# frames carry integers, SCALES turn them back into the plain units. Both
+# come from Application/protocol.def.
+CHANNELS = [(c.name, c.fmt, c.fields) for c in protocol.CHANNELS]
+SCALES = [c.scales for c in protocol.CHANNELS]
+
+KEYFRAME = 0x80
+
+SUBSCRIBE = protocol.COMMANDS["Y"].codec
+ENCODING = protocol.COMMANDS["y"].codec
+HEADER = struct.Struct("<BI")
+
+_layouts = {}
+
+
+def channel_number(name):
+    ''' Returns the channel's bit number, or ALL for "all" '''
+    if name == "all":
+        return ALL
+    for i, channel in enumerate(CHANNELS):
+        if channel[0] == name:
+            return i
+    raise ValueError("unknown channel %r, one of: all, %s" % (name, ", ".join(c[0] for c in CHANNELS)))
+
+
+def subscribe(conn, name, period):
+    ''' Sets a channel's period [s] on the robot, 0 unsubscribes '''
+    conn.write(SUBSCRIBE.pack(b'Y', channel_number(name), period))
+
+
+def set_encoding(conn, delta, keyframe=0):
+    ''' Switches the robot to delta frames (or back), keyframe 0 uses the robot's default interval '''
+    conn.write(ENCODING.pack(b'y', 1 if delta else 0, keyframe))
+
+
+def read_varint(data, i):
+    ''' Returns (value, next index) for the zigzag varint at data[i] '''
+    zigzag = 0
+    shift = 0
+    while True:
+        byte = data[i]
+        i += 1
+        zigzag |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return (zigzag >> 1) ^ -(zigzag & 1), i
+
+
+def wrap32(value):
+    ''' Wraps to a signed 32 bit integer as the robot's arithmetic does '''
+    return (value + 0x80000000) % 0x100000000 - 0x80000000
+
+
+class Decoder:
+    ''' Decodes 'Y' frames of either encoding. Delta frames need the values of the frames before them, so
+        one Decoder per robot, fed every frame in order. '''
+
+    def __init__(self):
+        self.previous = [[0] * len(c[2]) for c in CHANNELS]
+        self.time = 0
+        self.sequence = None
+        self.lost = 0
+
+    def decode(self, fmt, data):
+        ''' Returns (robot time [us], {channel: {field: value}}), or None while waiting for a keyframe '''
+        if fmt.endswith("s"):
+            return self.decode_delta(data)
+        return decode_frame(data)
+
+    def decode_delta(self, data):
+        flags, sequence = data[0], data[1]
+        key = flags & KEYFRAME
+
+        # A gap in the sequence means a lost frame, the deltas after it are useless until the next keyframe
+        if not key and (self.sequence is None or sequence != (self.sequence + 1) & 0xFF):
+            if self.sequence is not None:
+                self.lost += 1
+                self.sequence = None
+            return None
+        self.sequence = sequence
+
+        delta, i = read_varint(data, 2)
+        self.time = (delta if key else self.time + delta) & 0xFFFFFFFF
+
+        frame = {}
+        for c, (name, _, fields) in enumerate(CHANNELS):
+            if not flags & (1 << c):
+                continue
+            previous = self.previous[c]
+            for f in range(len(fields)):
+                delta, i = read_varint(data, i)
+                previous[f] = delta if key else wrap32(previous[f] + delta)
+            values = []
+            for value, scale in zip(previous, SCALES[c]):
+                values.append(b'LR'[value:value + 1] if scale is None else value * scale)
+            frame[name] = dict(zip(fields, values))
+        return self.time, frame
+
+
+def flatten(now, frame):
+    ''' The frame as the list serial_monitor_lib hands its callbacks for a plain frame '''
+    bitmap = 0
+    values = []
+    for c, (name, _, _) in enumerate(CHANNELS):
+        if name in frame:
+            bitmap |= 1 << c
+            values.extend(v.decode() if isinstance(v, bytes) else v for v in frame[name].values())
+    return ['Y', bitmap, now] + values
+
+
+def decode_frame(data):
+    ''' Returns (robot time [us], {channel: {field: value}}) for the data of a 'Y' frame '''
+    channels, now = HEADER.unpack_from(data)
+
+    # One struct per bitmap, they repeat every tick
+    layout = _layouts.get(channels)
+    if layout is None:
+        present = [c for i, c in enumerate(CHANNELS) if channels & (1 << i)]
+        layout = (struct.Struct("<" + "".join(c[1] for c in present)), present)
+        _layouts[channels] = layout
+
+    values = layout[0].unpack_from(data, HEADER.size)
+    frame = {}
+    i = 0
+    for name, _, fields in layout[1]:
+        frame[name] = dict(zip(fields, values[i:i + len(fields)]))
+        i += len(fields)
+    return now, frame
+
+
+def format_frame(now, frame):
+    parts = ["%12.6f" % (now / 1e6)]
+    for name, fields in frame.items():
+        parts.append("%s %s" % (name, " ".join(
+            ("%.4g" % v if isinstance(v, float) else v.decode() if isinstance(v, bytes) else str(v))
+            for v in fields.values())))
+    return "  ".join(parts)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Subscribe to robot telemetry channels and print the frames")
+    parser.add_argument("port", nargs="?", help="serial port of the robot")
+    parser.add_argument("subscriptions", nargs="*", metavar="channel=period",
+                        help="channel (%s or all) and period [s]" % ", ".join(c[0] for c in CHANNELS))
+    parser.add_argument("--sim", action="store_true", help="start Host/BIN/Link_Sim and use it instead")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after this long (default: until Ctrl-C)")
+    parser.add_argument("--delta", action="store_true", help="ask for delta (varint) frames")
+    parser.add_argument("--keyframe", type=int, default=0,
+                        help="delta frames per keyframe, 1 to 255 (default: the robot's, 50)")
+    args = parser.parse_args()
+
+    # With --sim the first positional is a subscription
+    if args.sim and args.port is not None:
+        args.subscriptions.insert(0, args.port)
+        args.port = None
+
+    subscriptions = []
+    for item in args.subscriptions:
+        name, _, period = item.partition("=")
+        try:
+            channel_number(name)
+            subscriptions.append((name, float(period)))
+        except ValueError as e:
+            parser.error(str(e))
+    if not subscriptions:
+        parser.error("give at least one channel=period")
+    if not 0 <= args.keyframe <= 255:
+        parser.error("--keyframe must be between 1 and 255")
+
+    sim = None
+    if args.sim:
+        if not os.path.exists(SIM_PATH):
+            print("%s not found, run make in Host/ first" % SIM_PATH, file=sys.stderr)
+            return 1
+        sim = subprocess.Popen([SIM_PATH], stdout=subprocess.PIPE, universal_newlines=True)
+        port = sim.stdout.readline().strip()
+    elif args.port:
+        port = args.port
+    else:
+        parser.error("give a serial port or --sim")
+
+    import serial
+    conn = serial.Serial(port, 115200, timeout=0.5)
+    try:
+        conn.reset_input_buffer()
+        set_encoding(conn, args.delta, args.keyframe)
+        for name, period in subscriptions:
+            subscribe(conn, name, period)
+
+        decoder = Decoder()
+        frames = 0
+        wire_bytes = 0
+        end = time.time() + args.seconds if args.seconds > 0 else None
+        for fmt, cmd, data in read_messages(conn.read):
+            if cmd in "Yy" and fmt == "cc":
+                print("robot rejected a subscription", file=sys.stderr)
+            elif cmd == 'Y':
+                frames += 1
+                # Length byte, format, command and data
+                wire_bytes += 1 + len(fmt) + 1 + 1 + len(data)
+                decoded = decoder.decode(fmt, data)
+                if decoded is not None:
+                    print(format_frame(*decoded))
+            if end is not None and time.time() > end:
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        subscribe(conn, "all", 0)
+        set_encoding(conn, False)
+        conn.close()
+        if frames:
+            print("%d frames, %d bytes, %.1f bytes/frame%s" % (frames, wire_bytes, wire_bytes / frames,
+                  ", %d lost" % decoder.lost if decoder.lost else ""), file=sys.stderr)
+        if sim is not None:
+            sim.terminate()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
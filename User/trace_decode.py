@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+
+'''
+    Copyright (c) 2021 Jonathan Diller at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+'''
+
+'''
+    trace_decode.py reads the robot's flight recorder (the 'l' command) and
+    prints it as a timeline.
+
+        python trace_decode.py /dev/ttyACM0             # trace in SRAM
+        python trace_decode.py /dev/ttyACM0 --snapshot  # copy saved in EEPROM
+        python trace_decode.py /dev/ttyACM0 --save trace.bin
+        python trace_decode.py --file trace.bin         # decode a saved dump
+
+    A dump is TRACE_LEN/TRACE_CHUNK framed messages, format "cBBBI64s":
+    source, chunk, record count, time [ms], then 4-byte records
+    (uint16 time [ms], event char, argument). See Driver/Trace.h.
+'''
+
+import argparse
+import struct
+import sys
+
+TRACE_LEN = 64
+TRACE_CHUNK = 16
+
+HEADER = struct.Struct("<BBBI")
+RECORD = struct.Struct("<HcB")
+
+OA_STATES = ["INIT", "DRIVE_STRAIGHT", "TURN_LEFT", "TURN_RIGHT", "HOLDING"]
+
+
+def read_messages(read):
+    ''' Yields (format, cmd, data) for each framed message, read(n) returns bytes '''
+    while True:
+        length = read(1)
+        if not length:
+            return
+        body = read(length[0])
+        if len(body) < length[0]:
+            return
+        end = body.find(b'\0')
+        if end < 0 or end + 1 >= len(body):
+            continue
+        yield body[:end].decode('ascii', 'replace'), chr(body[end + 1]), body[end + 2:]
+
+
+def collect_chunks(messages):
+    ''' Gathers the 'l' dump chunks, returns (source, count, time, records) '''
+    chunks = {}
+    header = None
+    for fmt, cmd, data in messages:
+        if cmd != 'l':
+            continue
+        if fmt == "cc":
+            raise RuntimeError("robot rejected the dump (no valid snapshot?)")
+        source, chunk, count, now = HEADER.unpack_from(data)
+        header = (source, count, now)
+        chunks[chunk] = data[HEADER.size:]
+        if len(chunks) == TRACE_LEN // TRACE_CHUNK:
+            break
+
+    if header is None:
+        raise RuntimeError("no trace received")
+
+    raw = b"".join(chunks[i] for i in sorted(chunks))
+    records = [RECORD.unpack_from(raw, i * RECORD.size) for i in range(min(header[1], len(raw) // RECORD.size))]
+    return header[0], header[1], header[2], records
+
+
+def unwrap_times(records, now_ms):
+    ''' Expands the 16-bit record times, walking back from the dump time '''
+    times = []
+    later = now_ms
+    for t16, _, _ in reversed(records):
+        later -= ((later & 0xFFFF) - t16) & 0xFFFF
+        times.append(later)
+    return list(reversed(times))
+
+
+def describe(event, arg):
+    if event == 'P':
+        return "power up"
+    if event == 'C':
+        return "command '%s'" % chr(arg)
+    if event == 'O':
+        return "obstacle avoidance -> %s" % (OA_STATES[arg] if arg < len(OA_STATES) else arg)
+    if event in ('L', 'R'):
+        pwm = arg - 256 if arg > 127 else arg
+        return "PWM %s %+d%%" % ("left" if event == 'L' else "right", pwm)
+    if event == 'B':
+        return "low battery %.2f V" % (arg / 20.0)
+    if event == 'X':
+        return "USB RX overflow"
+    return "unknown event %r (%d)" % (event, arg)
+
+
+def print_trace(source, count, now_ms, records):
+    print("%s trace, %d records, taken at %.3f s" % ("EEPROM" if source else "SRAM", count, now_ms / 1000.0))
+    for t, (_, event, arg) in zip(unwrap_times(records, now_ms), records):
+        print("%10.3f s  %s" % (t / 1000.0, describe(event.decode('ascii', 'replace'), arg)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Read and decode the robot flight recorder")
+    parser.add_argument("port", nargs="?", help="serial port of the robot")
+    parser.add_argument("--snapshot", action="store_true", help="read the EEPROM snapshot instead of SRAM")
+    parser.add_argument("--save", help="also write the raw dump to this file")
+    parser.add_argument("--file", help="decode a raw dump saved with --save")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            raw = f.read()
+        pos = [0]
+
+        def read(n):
+            data = raw[pos[0]:pos[0] + n]
+            pos[0] += n
+            return data
+    elif args.port:
+        import serial
+        conn = serial.Serial(args.port, 115200, timeout=2)
+        conn.reset_input_buffer()
+        conn.write(struct.pack("<cB", b'l', 1 if args.snapshot else 0))
+        saved = bytearray()
+
+        def read(n):
+            data = conn.read(n)
+            saved.extend(data)
+            return data
+    else:
+        parser.error("give a serial port or --file")
+
+    try:
+        source, count, now_ms, records = collect_chunks(read_messages(read))
+    except RuntimeError as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    if args.port and args.save:
+        with open(args.save, "wb") as f:
+            f.write(saved)
+
+    print_trace(source, count, now_ms, records)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
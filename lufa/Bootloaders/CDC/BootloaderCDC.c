@@ -212,7 +212,7 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 
 	Endpoint_ConfigureEndpoint(CDC_TX_EPADDR, EP_TYPE_BULK, CDC_TXRX_EPSIZE, 1);
 
-	Endpoint_ConfigureEndpoint(CDC_RX_EPADDR, EP_TYPE_BULK, CDC_TXRX_EPSIZE, 1);
+	Endpoint_ConfigureEndpoint(CDC_RX_EPADDR, EP_TYPE_BULK, CDC_TXRX_EPSIZE, CDC_RX_EPBANKS);
 }
 
 /** Event handler for the USB_ControlRequest event. This is used to catch and process control requests sent to
@@ -374,6 +374,161 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 }
 #endif
 
+#if !defined(NO_PAGE_CRC_SUPPORT)
+/** Computes the CRC16 (as \c _crc16_update(), starting from 0xFFFF) of a page of FLASH memory. The RWW section must
+ *  be readable, i.e. no page erase or write may be in progress.
+ *
+ *  \param[in] PageAddress  Byte address of the start of the page
+ *
+ *  \return CRC16 of the page's contents
+ */
+static uint16_t ReadFlashPageCRC(const uint32_t PageAddress)
+{
+	uint16_t CRC = 0xFFFF;
+
+	for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte++)
+	{
+		#if (FLASHEND > 0xFFFF)
+		CRC = _crc16_update(CRC, pgm_read_byte_far(PageAddress + CurrByte));
+		#else
+		CRC = _crc16_update(CRC, pgm_read_byte(PageAddress + CurrByte));
+		#endif
+	}
+
+	return CRC;
+}
+
+/** Waits for a page write started by \ref StreamFlashPages() to complete, re-enables the RWW section and checks
+ *  the page now in FLASH against the CRC the host sent for it.
+ *
+ *  \param[in] PageAddress  Byte address of the page that was written
+ *  \param[in] PageCRC      CRC16 of the page's intended contents
+ *
+ *  \return Boolean \c true if the page reads back correctly, \c false otherwise
+ */
+static bool FinishPageWrite(const uint32_t PageAddress, const uint16_t PageCRC)
+{
+	boot_spm_busy_wait();
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		boot_rww_enable();
+	}
+
+	return (ReadFlashPageCRC(PageAddress) == PageCRC);
+}
+
+/** Writes a stream of FLASH pages sent by the host in one command, so that only the pages which differ from the
+ *  host's image need to be sent and no round trip is needed per page. The command is followed by a big endian page
+ *  count, then for each page its big endian page index, \c SPM_PAGESIZE data bytes and the big endian CRC16 of the
+ *  data. Each page is received into RAM while the previous one is being written, then the previous page is checked
+ *  against its CRC as it reads back from FLASH before the next page is erased and written. After the first error no
+ *  further pages are written, but the rest of the stream is still consumed. A single \ref StreamPages_Status byte
+ *  followed by the big endian index of the failing page (zero on success) is sent back once the stream ends.
+ */
+static void StreamFlashPages(void)
+{
+	uint8_t  PageData[SPM_PAGESIZE];
+	uint16_t PageCount;
+
+	uint8_t  Status      = STREAM_STATUS_OK;
+	uint16_t FailedPage  = 0;
+
+	bool     WritePending    = false;
+	uint32_t PendingAddress  = 0;
+	uint16_t PendingCRC      = 0;
+	uint16_t PendingPage     = 0;
+
+	PageCount  = (FetchNextCommandByte() << 8);
+	PageCount |=  FetchNextCommandByte();
+
+	while (PageCount--)
+	{
+		uint16_t PageIndex;
+		uint16_t ExpectedCRC;
+		uint16_t CRC = 0xFFFF;
+
+		PageIndex  = (FetchNextCommandByte() << 8);
+		PageIndex |=  FetchNextCommandByte();
+
+		/* Receive the page into RAM, the previous page is still being written meanwhile */
+		for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte++)
+		{
+			PageData[CurrByte] = FetchNextCommandByte();
+			CRC = _crc16_update(CRC, PageData[CurrByte]);
+		}
+
+		ExpectedCRC  = (FetchNextCommandByte() << 8);
+		ExpectedCRC |=  FetchNextCommandByte();
+
+		/* Verify the previous page now that its write has had the transfer time to complete */
+		if (WritePending)
+		{
+			WritePending = false;
+
+			if (!(FinishPageWrite(PendingAddress, PendingCRC)))
+			{
+				Status     = STREAM_STATUS_VerifyCRC;
+				FailedPage = PendingPage;
+			}
+		}
+
+		/* Once a page has failed, keep reading the stream to stay in step with the host but write nothing */
+		if (Status != STREAM_STATUS_OK)
+		  continue;
+
+		uint32_t PageAddress = ((uint32_t)PageIndex * SPM_PAGESIZE);
+
+		if (PageAddress >= (uint32_t)BOOT_START_ADDR)
+		{
+			Status     = STREAM_STATUS_BadPage;
+			FailedPage = PageIndex;
+			continue;
+		}
+
+		if (CRC != ExpectedCRC)
+		{
+			Status     = STREAM_STATUS_TransferCRC;
+			FailedPage = PageIndex;
+			continue;
+		}
+
+		/* Fill the page buffer then erase the page, the buffer is kept across the erase */
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte += 2)
+			  boot_page_fill_safe(PageAddress + CurrByte, (PageData[CurrByte + 1] << 8) | PageData[CurrByte]);
+
+			boot_page_erase_safe(PageAddress);
+		}
+
+		boot_spm_busy_wait();
+
+		/* Start the write and go back to receiving the next page while it completes */
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			boot_page_write_safe(PageAddress);
+		}
+
+		WritePending   = true;
+		PendingAddress = PageAddress;
+		PendingCRC     = CRC;
+		PendingPage    = PageIndex;
+	}
+
+	if (WritePending && !(FinishPageWrite(PendingAddress, PendingCRC)))
+	{
+		Status     = STREAM_STATUS_VerifyCRC;
+		FailedPage = PendingPage;
+	}
+
+	/* Send the result back to the host */
+	WriteNextResponseByte(Status);
+	WriteNextResponseByte(FailedPage >> 8);
+	WriteNextResponseByte(FailedPage & 0xFF);
+}
+#endif
+
 /** Retrieves the next byte from the host in the CDC data OUT endpoint, and clears the endpoint bank if needed
  *  to allow reception of the next data packet from the host.
  *
@@ -553,6 +708,40 @@ static void CDC_Task(void)
 		ReadWriteMemoryBlock(Command);
 	}
 	#endif
+	#if !defined(NO_PAGE_CRC_SUPPORT)
+	else if (Command == AVR109_COMMAND_GetPageCRCSupport)
+	{
+		WriteNextResponseByte('Y');
+
+		/* Send the page size and the number of application pages to the host */
+		WriteNextResponseByte(SPM_PAGESIZE >> 8);
+		WriteNextResponseByte(SPM_PAGESIZE & 0xFF);
+		WriteNextResponseByte(((uint32_t)BOOT_START_ADDR / SPM_PAGESIZE) >> 8);
+		WriteNextResponseByte(((uint32_t)BOOT_START_ADDR / SPM_PAGESIZE) & 0xFF);
+	}
+	else if (Command == AVR109_COMMAND_ReadPageCRCs)
+	{
+		uint16_t PageCount;
+
+		PageCount  = (FetchNextCommandByte() << 8);
+		PageCount |=  FetchNextCommandByte();
+
+		/* Send the CRC of each page from the current (page aligned) address on, advancing the address */
+		while (PageCount--)
+		{
+			uint16_t CRC = ReadFlashPageCRC(CurrAddress);
+
+			WriteNextResponseByte(CRC >> 8);
+			WriteNextResponseByte(CRC & 0xFF);
+
+			CurrAddress += SPM_PAGESIZE;
+		}
+	}
+	else if (Command == AVR109_COMMAND_StreamPages)
+	{
+		StreamFlashPages();
+	}
+	#endif
 	#if !defined(NO_FLASH_BYTE_SUPPORT)
 	else if (Command == AVR109_COMMAND_FillFlashPageWordHigh)
 	{
@@ -44,6 +44,7 @@
 		#include <avr/power.h>
 		#include <avr/interrupt.h>
 		#include <util/delay.h>
+		#include <util/crc16.h>
 		#include <stdbool.h>
 
 		#include "Descriptors.h"
@@ -119,6 +120,18 @@
 			AVR109_COMMAND_SetLED                   = 'x',
 			AVR109_COMMAND_ClearLED                 = 'y',
 			AVR109_COMMAND_ExitBootloader           = 'E',
+			AVR109_COMMAND_GetPageCRCSupport        = 'h',  /**< Extension: page CRC and streamed writes supported */
+			AVR109_COMMAND_ReadPageCRCs             = 'H',  /**< Extension: CRC16 of each flash page */
+			AVR109_COMMAND_StreamPages              = 'W',  /**< Extension: write a stream of flash pages */
+		};
+
+		/** Status replies to \ref AVR109_COMMAND_StreamPages, each followed by the index of the failing page. */
+		enum StreamPages_Status
+		{
+			STREAM_STATUS_OK                        = '\r', /**< All pages written and verified */
+			STREAM_STATUS_BadPage                   = '?',  /**< Page outside the application section */
+			STREAM_STATUS_TransferCRC               = 'C',  /**< Page data didn't match the CRC sent with it */
+			STREAM_STATUS_VerifyCRC                 = 'V',  /**< Page read back from flash didn't match its CRC */
 		};
 
 	/* Type Defines: */
@@ -137,6 +150,11 @@
 			#if !defined(NO_BLOCK_SUPPORT)
 			static void    ReadWriteMemoryBlock(const uint8_t Command);
 			#endif
+			#if !defined(NO_PAGE_CRC_SUPPORT)
+			static uint16_t ReadFlashPageCRC(const uint32_t PageAddress);
+			static bool     FinishPageWrite(const uint32_t PageAddress, const uint16_t PageCRC);
+			static void     StreamFlashPages(void);
+			#endif
 			static uint8_t FetchNextCommandByte(void);
 			static void    WriteNextResponseByte(const uint8_t Response);
 		#endif
@@ -46,5 +46,6 @@
 //	#define NO_EEPROM_BYTE_SUPPORT
 //	#define NO_FLASH_BYTE_SUPPORT
 //	#define NO_LOCK_BYTE_WRITE_SUPPORT
+	#define NO_PAGE_CRC_SUPPORT
 
 #endif
@@ -99,8 +99,17 @@
 		/** Endpoint address for the CDC data interface RX (data OUT) endpoint. */
 		#define CDC_RX_EPADDR                  (ENDPOINT_DIR_OUT | 4)
 
-		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. */
-		#define CDC_TXRX_EPSIZE                16
+		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. Full size banks, with the RX
+		 *  endpoint double banked, keep streamed page writes moving while a page is being written; the USB
+		 *  series 2 AVRs don't have the endpoint memory for them.
+		 */
+		#if defined(USB_SERIES_2_AVR) || defined(NO_PAGE_CRC_SUPPORT)
+			#define CDC_TXRX_EPSIZE            16
+			#define CDC_RX_EPBANKS             1
+		#else
+			#define CDC_TXRX_EPSIZE            64
+			#define CDC_RX_EPBANKS             2
+		#endif
 
 		/** Size of the CDC control interface notification endpoint bank, in bytes. */
 		#define CDC_NOTIFICATION_EPSIZE        8